@@ -0,0 +1,161 @@
+#include "Autosave.h"
+#include <chrono>
+
+namespace
+{
+	double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+Autosave::Autosave(RegionStore& store, EditJournal* journal)
+	: mStore(store), mJournal(journal)
+{
+	mThread = std::thread(&Autosave::SaveLoop, this);
+}
+
+Autosave::~Autosave()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_one();
+	mThread.join();
+}
+
+bool Autosave::BeginSave(const World& world)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (IsSaving())
+		return false;
+
+	ClearSavedChunks(world);
+
+	std::vector<ChunkSnapshot> snapshots;
+	world.ForEachChunk([&](const Chunk& chunk)
+	{
+		if (chunk.IsDirty())
+			snapshots.push_back(chunk.Snapshot());
+	});
+	// Edits are applied before they are appended, so this covers every one
+	// the snapshots hold.
+	std::uint64_t sequence = mJournal != nullptr ? mJournal->GetLastSequence() : 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStats.LastChunkCount = snapshots.size();
+		mStats.LastPauseMs = ElapsedMs(start);
+		if (mStats.LastPauseMs > mStats.MaxPauseMs)
+			mStats.MaxPauseMs = mStats.LastPauseMs;
+
+		if (snapshots.empty())
+			return true;
+
+		mPending.swap(snapshots);
+		mPendingSequence = sequence;
+		mCopiedBytesAtStart = Chunk::GetCopyOnWriteCounters().CopiedBytes;
+		mSaving = true;
+	}
+
+	mWake.notify_one();
+	return true;
+}
+
+void Autosave::ClearSavedChunks(const World& world)
+{
+	std::vector<std::pair<ChunkCoord, std::uint32_t>> saved;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mSaving)
+			return;
+		saved.swap(mSaved);
+	}
+
+	for (auto& s : saved)
+	{
+		const Chunk* chunk = world.GetChunk(s.first);
+		if (chunk != nullptr && chunk->GetEditGeneration() == s.second)
+			chunk->ClearDirty();
+	}
+}
+
+bool Autosave::IsSaving()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mSaving;
+}
+
+void Autosave::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return !mSaving; });
+}
+
+AutosaveStats Autosave::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+void Autosave::SaveLoop()
+{
+	for (;;)
+	{
+		std::vector<ChunkSnapshot> snapshots;
+		std::uint64_t sequence;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this] { return mSaving || mStop; });
+			if (!mSaving)
+				return;
+
+			snapshots.swap(mPending);
+			sequence = mPendingSequence;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		// The log goes first.  If it can't get there nothing is written and
+		// the chunks stay dirty.
+		bool logged = mJournal == nullptr || mJournal->WaitDurable(sequence);
+
+		std::size_t snapshotBytes = 0;
+		std::size_t failed = 0;
+		std::vector<std::pair<ChunkCoord, std::uint32_t>> saved;
+		for (const ChunkSnapshot& snapshot : snapshots)
+		{
+			snapshotBytes += snapshot.GetMemoryUsage();
+			if (logged && mStore.SaveChunk(snapshot))
+				saved.emplace_back(snapshot.GetCoord(), snapshot.GetEditGeneration());
+			else
+				failed++;
+		}
+
+		// Nothing counts as saved until it is on disk.
+		if (!mStore.Flush())
+		{
+			failed += saved.size();
+			saved.clear();
+		}
+
+		// Let go of the shared storage before reporting the save as done.
+		snapshots.clear();
+		double saveMs = ElapsedMs(start);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStats.Saves++;
+			mStats.FailedChunks += failed;
+			mStats.JournalFailures += logged ? 0 : 1;
+			mStats.LastSaveMs = saveMs;
+			mStats.LastSnapshotBytes = snapshotBytes;
+			mStats.LastCopiedBytes = Chunk::GetCopyOnWriteCounters().CopiedBytes - mCopiedBytesAtStart;
+			mSaved.swap(saved);
+			mSaving = false;
+		}
+		mDone.notify_all();
+	}
+}
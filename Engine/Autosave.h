@@ -0,0 +1,85 @@
+#pragma once
+
+#include "EditJournal.h"
+#include "RegionFile.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct AutosaveStats
+{
+	std::uint64_t Saves = 0;
+	std::size_t LastChunkCount = 0;
+	std::size_t FailedChunks = 0;
+	// Saves dropped because the journal couldn't make their edits durable.
+	std::uint64_t JournalFailures = 0;
+	// Time BeginSave() held up the calling thread.
+	double LastPauseMs = 0.0;
+	double MaxPauseMs = 0.0;
+	// Background time to encode, write and flush the last save.
+	double LastSaveMs = 0.0;
+	// Storage the snapshots of the last save kept alive, and how much of it
+	// the world had to copy because it was edited while the save ran.
+	std::size_t LastSnapshotBytes = 0;
+	std::uint64_t LastCopiedBytes = 0;
+};
+
+// Saves dirty chunks on a background thread without stalling the frame loop.
+//
+// BeginSave() runs at a tick boundary on the thread that edits the world.  It
+// takes a ChunkSnapshot of every dirty chunk, which only bumps reference
+// counts, and hands them to the save thread.  Chunks edited while the save is
+// running copy their storage first, so the save sees a consistent view.
+//
+// With a journal, BeginSave() also notes the last edit it has appended, and
+// the save thread waits until the journal has that edit on disk before
+// writing any chunk.  A region never gets ahead of the log, or replaying the
+// log after a crash would roll some blocks back to older edits.
+//
+// Chunks stay dirty while they are being saved.  The next BeginSave() clears
+// the flag of each chunk whose save succeeded and that hasn't been edited
+// since its snapshot; failed chunks are simply saved again.
+class Autosave
+{
+public:
+	// journal may be null if edits aren't logged.
+	explicit Autosave(RegionStore& store, EditJournal* journal = nullptr);
+	Autosave(const Autosave& rhs) = delete;
+	Autosave& operator=(const Autosave& rhs) = delete;
+	~Autosave();
+
+	// Returns false if the previous save hasn't finished yet.
+	bool BeginSave(const World& world);
+	// Clears the dirty flags of the chunks the last save wrote.  BeginSave()
+	// does this first; call it directly to settle a finished save early.
+	void ClearSavedChunks(const World& world);
+	bool IsSaving()const;
+	void Wait();
+
+	AutosaveStats GetStats()const;
+
+private:
+	void SaveLoop();
+
+private:
+	RegionStore& mStore;
+	EditJournal* mJournal;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	std::vector<ChunkSnapshot> mPending;
+	// Last journal sequence the pending snapshots can hold.
+	std::uint64_t mPendingSequence = 0;
+	// Chunks the last save wrote and their edit generation at the snapshot.
+	std::vector<std::pair<ChunkCoord, std::uint32_t>> mSaved;
+	bool mSaving = false;
+	bool mStop = false;
+	std::uint64_t mCopiedBytesAtStart = 0;
+	AutosaveStats mStats;
+
+	std::thread mThread;
+};
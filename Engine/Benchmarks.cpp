@@ -0,0 +1,2472 @@
+#include "Benchmarks.h"
+#include "Autosave.h"
+#include "BlockInstances.h"
+#include "ChunkLod.h"
+#include "ChunkMesher.h"
+#include "Common/GeometryGenerator.h"
+#include "DrawQueue.h"
+#include "EditJournal.h"
+#include "FaceCulling.h"
+#include "IndirectDraws.h"
+#include "MeshOptimizer.h"
+#include "MeshWorkerPool.h"
+#include "PalettedStorage.h"
+#include "ParallelRecorder.h"
+#include "RegionFile.h"
+#include "RemeshQueue.h"
+#include "TranslucentSort.h"
+#include "VoxelOctree.h"
+#include "WorldGenerator.h"
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	double ElapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Keeps the optimizer from discarding benchmark loops.
+	volatile unsigned int gSink = 0;
+
+	void BenchmarkWorldGeneration(std::ostream& out)
+	{
+		World world;
+		WorldGenStats stats = GenerateDefaultMap(world, 1);
+
+		out << "World generation (100x100 map)\n";
+		out << "  blocks: " << stats.BlockCount << "  chunks: " << stats.ChunkCount << "\n";
+		out << "  bytes/block: " << (double)stats.MemoryBytes / stats.BlockCount << "\n";
+		out << "  generation ms: " << stats.GenerationMs << "\n\n";
+	}
+
+	void BenchmarkChunkStorage(std::ostream& out)
+	{
+		World world;
+		GenerateDefaultMap(world, 1);
+
+		// Memory per chunk against a dense one-byte-per-block array.
+		int bitsHistogram[9] = {};
+		std::size_t palettedBytes = 0;
+		std::vector<const Chunk*> chunks;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			bitsHistogram[chunk.GetBitsPerBlock()]++;
+			palettedBytes += chunk.GetMemoryUsage();
+			chunks.push_back(&chunk);
+		});
+
+		out << "Chunk storage (" << chunks.size() << " chunks)\n";
+		out << "  bits/block histogram: 0:" << bitsHistogram[0] << " 1:" << bitsHistogram[1] <<
+			" 2:" << bitsHistogram[2] << " 4:" << bitsHistogram[4] << " 8:" << bitsHistogram[8] << "\n";
+		out << "  bytes/chunk paletted: " << (double)palettedBytes / chunks.size() <<
+			"  dense: " << ChunkVolume << "\n";
+
+		// Work on copies so the paletted and dense versions hold the same data.
+		std::vector<BlockId> dense(chunks.size() * ChunkVolume);
+		std::vector<std::unique_ptr<Chunk>> copies;
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			chunks[i]->CopyBlocks(&dense[i * ChunkVolume]);
+			copies.push_back(std::make_unique<Chunk>(chunks[i]->GetCoord()));
+			copies.back()->AssignBlocks(&dense[i * ChunkVolume]);
+		}
+
+		const int numOps = 4000000;
+		std::mt19937 rng(7);
+		std::vector<std::uint32_t> ops(numOps);
+		for (auto& op : ops)
+			op = rng();
+
+		// Sequential iteration over every block.
+		auto start = Clock::now();
+		unsigned int sum = 0;
+		for (auto& chunk : copies)
+			for (int y = 0; y < ChunkSize; y++)
+				for (int z = 0; z < ChunkSize; z++)
+					for (int x = 0; x < ChunkSize; x++)
+						sum += (unsigned int)chunk->GetBlock(x, y, z);
+		double palettedIterMs = ElapsedMs(start);
+
+		start = Clock::now();
+		for (auto id : dense)
+			sum += (unsigned int)id;
+		double denseIterMs = ElapsedMs(start);
+		gSink = sum;
+
+		// Random reads.
+		start = Clock::now();
+		sum = 0;
+		for (auto op : ops)
+		{
+			const Chunk& chunk = *copies[(op >> 12) % copies.size()];
+			int i = op & (ChunkVolume - 1);
+			sum += (unsigned int)chunk.GetBlock(i & ChunkMask, i >> (2 * ChunkShift), (i >> ChunkShift) & ChunkMask);
+		}
+		double palettedGetMs = ElapsedMs(start);
+
+		start = Clock::now();
+		for (auto op : ops)
+			sum += (unsigned int)dense[((op >> 12) % copies.size()) * ChunkVolume + (op & (ChunkVolume - 1))];
+		double denseGetMs = ElapsedMs(start);
+		gSink = sum;
+
+		// Random writes drawn from the types the generator actually uses underground.
+		const BlockId setIds[] = { BlockId::Air, BlockId::Stone, BlockId::Dirt, BlockId::Gravel };
+		start = Clock::now();
+		for (auto op : ops)
+		{
+			Chunk& chunk = *copies[(op >> 12) % copies.size()];
+			int i = op & (ChunkVolume - 1);
+			chunk.SetBlock(i & ChunkMask, i >> (2 * ChunkShift), (i >> ChunkShift) & ChunkMask, setIds[op >> 30]);
+		}
+		double palettedSetMs = ElapsedMs(start);
+
+		start = Clock::now();
+		for (auto op : ops)
+			dense[((op >> 12) % copies.size()) * ChunkVolume + (op & (ChunkVolume - 1))] = setIds[op >> 30];
+		double denseSetMs = ElapsedMs(start);
+
+		const double nsPerOp = 1.0e6 / numOps;
+		out << "  sequential ns/block paletted: " << palettedIterMs * 1.0e6 / dense.size() <<
+			"  dense: " << denseIterMs * 1.0e6 / dense.size() << "\n";
+		out << "  random get ns paletted: " << palettedGetMs * nsPerOp << "  dense: " << denseGetMs * nsPerOp << "\n";
+		out << "  random set ns paletted: " << palettedSetMs * nsPerOp << "  dense: " << denseSetMs * nsPerOp << "\n";
+
+		// Placing and removing one block of a third type at the 1/2 bit
+		// boundary shouldn't repack the indices each time.
+		PalettedStorage storage(ChunkVolume, BlockId::Stone);
+		for (int i = 0; i < ChunkVolume; i += 2)
+			storage.Set(i, BlockId::Dirt);
+		const int toggles = 100000;
+		bool widthsOk = storage.GetBitsPerBlock() == 1;
+		start = Clock::now();
+		for (int t = 0; t < toggles; t++)
+		{
+			storage.Set(1, BlockId::Gravel);
+			widthsOk = widthsOk && storage.GetBitsPerBlock() == 2;
+			storage.Set(1, BlockId::Stone);
+			widthsOk = widthsOk && storage.GetBitsPerBlock() == 2;
+		}
+		double toggleMs = ElapsedMs(start);
+
+		// Down to one type is two widths below 2 bits, so it compacts to uniform.
+		for (int i = 0; i < ChunkVolume; i += 2)
+			storage.Set(i, BlockId::Stone);
+		widthsOk = widthsOk && storage.IsUniform();
+
+		// A 1-bit chunk dug back out to all air goes uniform too.
+		PalettedStorage dugOut(ChunkVolume, BlockId::Air);
+		for (int i = 0; i < ChunkVolume; i += 3)
+			dugOut.Set(i, BlockId::Stone);
+		widthsOk = widthsOk && dugOut.GetBitsPerBlock() == 1;
+		for (int i = 0; i < ChunkVolume; i += 3)
+			dugOut.Set(i, BlockId::Air);
+		widthsOk = widthsOk && dugOut.GetBitsPerBlock() == 0;
+		out << "  type boundary toggle ns: " << toggleMs * 1.0e6 / (2 * toggles) <<
+			"  widths " << (widthsOk ? "ok" : "WRONG") << "\n\n";
+	}
+
+	void BenchmarkOctree(std::ostream& out, int mapSize)
+	{
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+
+		WorldOctree octree;
+		auto start = Clock::now();
+		octree.Build(world);
+		double buildMs = ElapsedMs(start);
+
+		// Incremental path: rebuild a single chunk after an edit.
+		world.SetBlock(5, 12, 5, BlockId::Stone);
+		start = Clock::now();
+		octree.UpdateChunk(world, World::ToChunkCoord(5, 12, 5));
+		double updateMs = ElapsedMs(start);
+
+		// Count how many blocks each LOD level gets wrong against the full data.
+		std::size_t lodMismatches[OctreeMaxLod + 1] = {};
+		std::size_t samples = 0;
+		for (int z = 0; z < mapSize; z++)
+		{
+			for (int x = 0; x < mapSize; x++)
+			{
+				for (int y = 0; y < ChunkSize; y++)
+				{
+					BlockId actual = world.GetBlock(x, y, z);
+					for (int lod = 0; lod <= OctreeMaxLod; lod++)
+						if (octree.GetBlock(x, y, z, lod) != actual)
+							lodMismatches[lod]++;
+					samples++;
+				}
+			}
+		}
+
+		// Rays from above the map pointing down and across it.
+		const int numRays = 100000;
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> pos(0.0f, (float)mapSize);
+		std::uniform_real_distribution<float> slope(-1.0f, 1.0f);
+		int hits = 0;
+		long long steps = 0;
+		start = Clock::now();
+		for (int i = 0; i < numRays; i++)
+		{
+			float origin[3] = { pos(rng), 40.0f, pos(rng) };
+			float dir[3] = { slope(rng), -1.0f, slope(rng) };
+			VoxelRayHit hit = octree.Raycast(origin, dir, 200.0f);
+			hits += hit.Hit ? 1 : 0;
+			steps += hit.Steps;
+		}
+		double rayMs = ElapsedMs(start);
+
+		// Far terrain at 4x4x4 cells past 128 blocks from the centre; near
+		// chunks must still match exactly.
+		const float farDistance = 128.0f;
+		const int farLod = 2;
+		WorldOctree farOctree;
+		farOctree.SetFarField(mapSize * 0.5f, mapSize * 0.5f, farDistance, farLod);
+		farOctree.Build(world);
+		std::size_t nearMismatches = 0;
+		std::size_t farMismatches = 0;
+		for (int z = 0; z < mapSize; z++)
+		{
+			for (int x = 0; x < mapSize; x++)
+			{
+				ChunkCoord coord = World::ToChunkCoord(x, 0, z);
+				float dx = coord.X * ChunkSize + ChunkSize * 0.5f - mapSize * 0.5f;
+				float dz = coord.Z * ChunkSize + ChunkSize * 0.5f - mapSize * 0.5f;
+				bool far = dx * dx + dz * dz > farDistance * farDistance;
+				for (int y = 0; y < ChunkSize; y++)
+				{
+					BlockId actual = world.GetBlock(x, y, z);
+					if (far)
+						farMismatches += farOctree.GetBlock(x, y, z) != octree.GetBlock(x, y, z, farLod) ? 1 : 0;
+					else
+						nearMismatches += farOctree.GetBlock(x, y, z) != actual ? 1 : 0;
+				}
+			}
+		}
+
+		// A dig as the app does it on a right click: pick, clear the block,
+		// rebuild its chunk's tree and pick again.
+		const float pickOrigin[3] = { 5.5f, 40.0f, 5.5f };
+		const float pickDir[3] = { 0.0f, -1.0f, 0.0f };
+		VoxelRayHit firstPick = octree.Raycast(pickOrigin, pickDir, 64.0f);
+		bool pickOk = firstPick.Hit && firstPick.NormalY == 1;
+		if (pickOk)
+		{
+			world.SetBlock(firstPick.X, firstPick.Y, firstPick.Z, BlockId::Air);
+			octree.UpdateChunk(world, World::ToChunkCoord(firstPick.X, firstPick.Y, firstPick.Z));
+			VoxelRayHit secondPick = octree.Raycast(pickOrigin, pickDir, 64.0f);
+			pickOk = !secondPick.Hit || secondPick.Y < firstPick.Y;
+		}
+
+		out << "Sparse voxel octree (" << mapSize << "x" << mapSize << " map)\n";
+		out << "  chunks: " << octree.GetChunkCount() << "  regions: " << octree.GetRegionCount() <<
+			"  nodes: " << octree.GetNodeCount() << "  bytes: " << octree.GetMemoryUsage() <<
+			"  (chunk storage: " << world.GetMemoryUsage() << ")\n";
+		out << "  far field past " << farDistance << " at lod " << farLod << ": nodes: " << farOctree.GetNodeCount() <<
+			"  bytes: " << farOctree.GetMemoryUsage() << "  near mismatches: " << nearMismatches <<
+			"  far mismatches vs lod " << farLod << ": " << farMismatches << "\n";
+		out << "  build ms: " << buildMs << "  single chunk update ms: " << updateMs << "\n";
+		out << "  mismatched samples by lod:";
+		for (int lod = 0; lod <= OctreeMaxLod; lod++)
+			out << " " << lod << ":" << (double)lodMismatches[lod] / samples;
+		out << "\n";
+		out << "  rays: " << numRays << "  hits: " << hits << "  leaves/ray: " << (double)steps / numRays <<
+			"  ns/ray: " << rayMs * 1.0e6 / numRays << "  pick and dig " << (pickOk ? "ok" : "WRONG") << "\n\n";
+	}
+	void BenchmarkColdTier(std::ostream& out)
+	{
+		World world;
+		GenerateDefaultMap(world, 1);
+		std::size_t hotBytes = world.GetMemoryUsage();
+
+		// Keep a dense copy to check the round trip.
+		std::vector<BlockId> before;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			BlockId blocks[ChunkVolume];
+			chunk.CopyBlocks(blocks);
+			before.insert(before.end(), blocks, blocks + ChunkVolume);
+		});
+
+		// Everything is idle after a zero delay.
+		world.SetColdTierDelay(0.0);
+		world.Update(1.0);
+		std::size_t coldBytes = world.GetMemoryUsage();
+
+		// Reads decode from the cold tier and leave the chunks frozen.
+		world.SetColdTierDelay(1000.0);
+		auto readAll = [&world, &before]()
+		{
+			std::size_t index = 0;
+			bool match = true;
+			world.ForEachChunk([&](const Chunk& chunk)
+			{
+				const ChunkCoord& c = chunk.GetCoord();
+				for (int i = 0; i < ChunkVolume; i++, index++)
+				{
+					int x = (c.X << ChunkShift) + (i & ChunkMask);
+					int y = (c.Y << ChunkShift) + (i >> (2 * ChunkShift));
+					int z = (c.Z << ChunkShift) + ((i >> ChunkShift) & ChunkMask);
+					match = match && world.GetBlock(x, y, z) == before[index];
+				}
+			});
+			return match;
+		};
+
+		auto start = Clock::now();
+		bool coldMatch = readAll();
+		double coldReadMs = ElapsedMs(start);
+		std::uint64_t thawsAfterReads = world.GetColdTierStats().Thaws;
+
+		// The next update thaws everything that was read.
+		world.Update(2.0);
+		start = Clock::now();
+		bool hotMatch = readAll();
+		double hotReadMs = ElapsedMs(start);
+
+		ColdTierStats stats = world.GetColdTierStats();
+		bool match = coldMatch && hotMatch && thawsAfterReads == 0 && stats.ColdChunks == 0;
+		out << "Cold tier (run-length encoded columns)\n";
+		out << "  bytes hot: " << hotBytes << "  cold: " << coldBytes << "\n";
+		out << "  ns/read cold: " << coldReadMs * 1.0e6 / before.size() << "  hot: " << hotReadMs * 1.0e6 / before.size() << "\n";
+		out << "  freezes: " << stats.Freezes << "  thaws: " << stats.Thaws << "  round trip " << (match ? "ok" : "MISMATCH") << "\n";
+		out << "  freeze MB/s: " << stats.FreezeMBPerSec << "  thaw MB/s: " << stats.ThawMBPerSec <<
+			"  max thaw us: " << stats.MaxThawMicroseconds << "\n\n";
+	}
+	void BenchmarkBlockLookup(std::ostream& out)
+	{
+		World world;
+		GenerateDefaultMap(world, 1);
+
+		std::vector<BlockId> blocks;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			BlockId dense[ChunkVolume];
+			chunk.CopyBlocks(dense);
+			for (BlockId id : dense)
+				if (id != BlockId::Air)
+					blocks.push_back(id);
+		});
+
+		// Stand-in for CrateApp::mMaterials, keyed the same way.
+		struct MaterialStandIn { int MatCBIndex; };
+		std::unordered_map<std::string, std::unique_ptr<MaterialStandIn>> materials;
+		for (int i = 1; i < gNumBlockTypes; i++)
+			materials[GetBlockInfo((BlockId)i).Name] = std::make_unique<MaterialStandIn>(MaterialStandIn{ GetBlockInfo((BlockId)i).MatCBIndex });
+
+		const int passes = 20;
+		auto start = Clock::now();
+		unsigned int sum = 0;
+		for (int pass = 0; pass < passes; pass++)
+			for (BlockId id : blocks)
+				sum += materials[GetBlockInfo(id).Name]->MatCBIndex;
+		double mapMs = ElapsedMs(start);
+
+		start = Clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (BlockId id : blocks)
+				sum += GetBlockInfo(id).MatCBIndex + (GetBlockInfo(id).Flags & BlockFlag_Opaque);
+		double tableMs = ElapsedMs(start);
+		gSink = sum;
+
+		const double lookups = (double)passes * blocks.size();
+		out << "Block lookup (" << blocks.size() << " blocks x " << passes << ")\n";
+		out << "  ns/block unordered_map<string>: " << mapMs * 1.0e6 / lookups <<
+			"  constexpr table: " << tableMs * 1.0e6 / lookups << "\n\n";
+	}
+
+	// Runs fn(threadIndex) on the given number of threads and returns the wall
+	// time in milliseconds.
+	template<typename Fn>
+	double RunThreads(int threadCount, Fn fn)
+	{
+		std::vector<std::thread> threads;
+		auto start = Clock::now();
+		for (int t = 0; t < threadCount; t++)
+			threads.emplace_back(fn, t);
+		for (auto& thread : threads)
+			thread.join();
+		return ElapsedMs(start);
+	}
+
+	void BenchmarkConcurrentMap(std::ostream& out)
+	{
+		struct Payload { std::uint64_t Key; };
+
+		// A view-distance sized set of chunk keys; writers churn a separate range.
+		const int radius = 16;
+		std::vector<std::uint64_t> keys;
+		for (int z = -radius; z < radius; z++)
+			for (int x = -radius; x < radius; x++)
+				for (int y = 0; y < 8; y++)
+					keys.push_back(PackChunkCoord({ x, y, z }));
+
+		ConcurrentMap<Payload> concurrent;
+		std::unordered_map<std::uint64_t, std::unique_ptr<Payload>> locked;
+		std::mutex lockedMutex;
+		for (std::uint64_t key : keys)
+		{
+			concurrent.Insert(key, std::make_unique<Payload>(Payload{ key }));
+			locked[key] = std::make_unique<Payload>(Payload{ key });
+		}
+
+		const int opsPerThread = 400000;
+		const int writePercents[] = { 0, 1, 10, 50 };
+		int maxThreads = std::max(4, (int)std::thread::hardware_concurrency());
+
+		out << "Concurrent chunk map (" << keys.size() << " chunks, " << opsPerThread << " ops/thread, M ops/sec)\n";
+		for (int writePercent : writePercents)
+		{
+			for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+			{
+				std::atomic<unsigned int> sum{ 0 };
+
+				double concurrentMs = RunThreads(threadCount, [&](int t)
+				{
+					std::mt19937 rng(t + 1);
+					unsigned int local = 0;
+					for (int i = 0; i < opsPerThread; i++)
+					{
+						std::uint64_t key = keys[rng() % keys.size()];
+						if ((int)(rng() % 100) < writePercent)
+						{
+							// Load or unload a chunk outside the resident set.
+							std::uint64_t churnKey = PackChunkCoord({ (int)(rng() % 64), 100 + t, 0 });
+							if (rng() & 1)
+								concurrent.Insert(churnKey, std::make_unique<Payload>(Payload{ churnKey }));
+							else
+								concurrent.Erase(churnKey);
+						}
+						else
+						{
+							EpochGuard guard;
+							Payload* p = concurrent.Find(key);
+							local += p != nullptr ? (unsigned int)p->Key : 0;
+						}
+					}
+					sum += local;
+				});
+
+				double lockedMs = RunThreads(threadCount, [&](int t)
+				{
+					std::mt19937 rng(t + 1);
+					unsigned int local = 0;
+					for (int i = 0; i < opsPerThread; i++)
+					{
+						std::uint64_t key = keys[rng() % keys.size()];
+						std::lock_guard<std::mutex> lock(lockedMutex);
+						if ((int)(rng() % 100) < writePercent)
+						{
+							std::uint64_t churnKey = PackChunkCoord({ (int)(rng() % 64), 100 + t, 0 });
+							if (rng() & 1)
+								locked.emplace(churnKey, std::make_unique<Payload>(Payload{ churnKey }));
+							else
+								locked.erase(churnKey);
+						}
+						else
+						{
+							auto it = locked.find(key);
+							local += it != locked.end() ? (unsigned int)it->second->Key : 0;
+						}
+					}
+					sum += local;
+				});
+				gSink = sum;
+
+				double ops = (double)threadCount * opsPerThread;
+				out << "  " << (100 - writePercent) << "/" << writePercent << " read/write, " << threadCount << " threads: " <<
+					"concurrent " << ops / (concurrentMs * 1000.0) << "  mutex+unordered_map " << ops / (lockedMs * 1000.0) << "\n";
+			}
+		}
+
+		EpochManager::Get().Collect();
+		out << "  retired objects still pending: " << EpochManager::Get().GetPendingCount() << "\n\n";
+	}
+
+	void BenchmarkRegionFiles(std::ostream& out)
+	{
+		const int mapSize = 800;
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+
+		ChunkCoord minChunk{ 0, 0, 0 };
+		ChunkCoord maxChunk{ (mapSize - 1) >> ChunkShift, RegionHeight - 1, (mapSize - 1) >> ChunkShift };
+		const std::string directory = "bench_regions";
+
+		RegionStore store(directory);
+		auto start = Clock::now();
+		std::size_t saved = store.SaveWorld(world);
+		double saveMs = ElapsedMs(start);
+
+		start = Clock::now();
+		store.Flush();
+		double flushMs = ElapsedMs(start);
+		RegionStoreStats saveStats = store.GetStats();
+
+		// Rewrites go to new sectors and free the old ones on flush, so the
+		// file settles at about twice the data instead of growing every save.
+		std::size_t rewriteBytes[2];
+		for (int i = 0; i < 2; i++)
+		{
+			store.SaveWorld(world);
+			store.Flush();
+			rewriteBytes[i] = store.GetStats().FileBytes;
+		}
+		store.Close();
+
+		// Pages are still cached from the save.
+		World warm;
+		start = Clock::now();
+		std::size_t warmLoaded = store.LoadArea(warm, minChunk, maxChunk);
+		double warmMs = ElapsedMs(start);
+		store.Close(true);
+
+		// The regions were evicted from the page cache on close.
+		World cold;
+		start = Clock::now();
+		std::size_t coldLoaded = store.LoadArea(cold, minChunk, maxChunk);
+		double coldMs = ElapsedMs(start);
+		RegionStoreStats loadStats = store.GetStats();
+		store.Close();
+
+		bool match = warmLoaded == saved && coldLoaded == saved;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			const Chunk* loaded = cold.GetChunk(chunk.GetCoord());
+			if (loaded == nullptr)
+			{
+				match = match && chunk.IsEmpty();
+				return;
+			}
+
+			BlockId a[ChunkVolume], b[ChunkVolume];
+			chunk.CopyBlocks(a);
+			loaded->CopyBlocks(b);
+			match = match && std::equal(a, a + ChunkVolume, b);
+		});
+
+		for (int rz = 0; rz <= (maxChunk.Z >> RegionShift); rz++)
+			for (int rx = 0; rx <= (maxChunk.X >> RegionShift); rx++)
+				std::remove(store.GetRegionPath(RegionCoord{ rx, 0, rz }).c_str());
+
+		// A new region whose header never reached the disk is all zeros; it
+		// has to open as an empty region rather than fail for good.
+		const std::string zeroedPath = store.GetRegionPath(RegionCoord{ 99, 0, 99 });
+		bool zeroedOk;
+		{
+			RegionFile region;
+			zeroedOk = region.Open(zeroedPath, true);
+			std::size_t headerBytes = region.GetFileSize();
+			region.Close();
+			std::vector<char> zeros(headerBytes, 0);
+			std::ofstream(zeroedPath, std::ios::binary | std::ios::trunc).write(zeros.data(), zeros.size());
+
+			zeroedOk = zeroedOk && region.Open(zeroedPath, true) && region.GetChunkCount() == 0;
+			region.Close();
+			zeroedOk = zeroedOk && region.Open(zeroedPath, false);
+			region.Close();
+		}
+		std::remove(zeroedPath.c_str());
+
+		out << "Region files (" << mapSize << "x" << mapSize << " map, " << saved << " chunks, " << saveStats.OpenRegions << " regions)\n";
+		out << "  file bytes: " << saveStats.FileBytes << "  bytes/chunk: " << (double)saveStats.FileBytes / saved << "\n";
+		out << "  save chunks/sec: " << saved * 1000.0 / saveMs << "  flush ms: " << flushMs << "\n";
+		out << "  file bytes after rewrites: " << rewriteBytes[0] << " " << rewriteBytes[1] << "\n";
+		out << "  load chunks/sec warm cache: " << warmLoaded * 1000.0 / warmMs << "  cold cache: " << coldLoaded * 1000.0 / coldMs << "\n";
+		out << "  corrupt chunks: " << loadStats.CorruptChunks << "  round trip " << (match ? "ok" : "MISMATCH") <<
+			"  zeroed header " << (zeroedOk ? "recovered" : "FAILED") << "\n\n";
+	}
+
+	// Reference for the heightmaps: walk down from the top of the world.
+	int ScanSurfaceHeight(const World& world, int x, int z, int topY, HeightmapType type)
+	{
+		for (int y = topY; y >= 0; y--)
+			if (MatchesHeightmap(type, world.GetBlock(x, y, z)))
+				return y;
+		return World::NoSurface;
+	}
+
+	void BenchmarkSurfaceQueries(std::ostream& out)
+	{
+		const int mapSize = 400;
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+
+		int topY = 0;
+		world.ForEachChunk([&](const Chunk& chunk) { topY = std::max(topY, chunk.GetCoord().Y * ChunkSize + ChunkSize - 1); });
+
+		const int passes = 10;
+		out << "Surface queries (" << mapSize << "x" << mapSize << " columns x " << passes << ", ns/query)\n";
+		const char* names[] = { "solid", "opaque", "non-fluid" };
+		for (int t = 0; t < gNumHeightmapTypes; t++)
+		{
+			HeightmapType type = (HeightmapType)t;
+			unsigned int sum = 0;
+
+			auto start = Clock::now();
+			for (int pass = 0; pass < passes; pass++)
+				for (int z = 0; z < mapSize; z++)
+					for (int x = 0; x < mapSize; x++)
+						sum += world.GetSurfaceHeight(x, z, type);
+			double heightmapMs = ElapsedMs(start);
+
+			start = Clock::now();
+			for (int pass = 0; pass < passes; pass++)
+				for (int z = 0; z < mapSize; z++)
+					for (int x = 0; x < mapSize; x++)
+						sum += ScanSurfaceHeight(world, x, z, topY, type);
+			double scanMs = ElapsedMs(start);
+			gSink = sum;
+
+			const double queries = (double)passes * mapSize * mapSize;
+			out << "  " << names[t] << " heightmap: " << heightmapMs * 1.0e6 / queries << "  scan: " << scanMs * 1.0e6 / queries << "\n";
+		}
+
+		// Dig out and pile up random columns, then check every surface against a scan.
+		std::mt19937 rng(7);
+		const int edits = 20000;
+		auto start = Clock::now();
+		for (int i = 0; i < edits; i++)
+		{
+			int x = (int)(rng() % mapSize);
+			int z = (int)(rng() % mapSize);
+			int y = world.GetSurfaceHeight(x, z);
+			if (rng() % 3 == 0)
+				world.SetBlock(x, y + 1, z, BlockId::Stone);
+			else if (y > 0)
+				world.SetBlock(x, y, z, BlockId::Air);
+		}
+		double editMs = ElapsedMs(start);
+
+		std::size_t mismatches = 0;
+		for (int t = 0; t < gNumHeightmapTypes; t++)
+			for (int z = 0; z < mapSize; z++)
+				for (int x = 0; x < mapSize; x++)
+					if (world.GetSurfaceHeight(x, z, (HeightmapType)t) != ScanSurfaceHeight(world, x, z, topY, (HeightmapType)t))
+						mismatches++;
+
+		out << "  ns/edit with heightmap upkeep: " << editMs * 1.0e6 / edits << "  mismatches after edits: " << mismatches << "\n\n";
+	}
+
+	// Digs or builds on top of a random column of the map and journals it.
+	void RandomSurfaceEdit(World& world, EditJournal& journal, std::mt19937& rng, int mapSize)
+	{
+		int x = (int)(rng() % mapSize);
+		int z = (int)(rng() % mapSize);
+		int y = world.GetSurfaceHeight(x, z);
+		BlockId id = BlockId::Stone;
+		if (rng() % 2 == 0 && y > 0)
+			id = BlockId::Air;
+		else
+			y++;
+
+		world.SetBlock(x, y, z, id);
+		journal.Append(x, y, z, id);
+	}
+
+	void BenchmarkEditJournal(std::ostream& out)
+	{
+		const int mapSize = 100;
+		const std::string directory = "bench_journal";
+		std::mt19937 rng(3);
+
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+		RegionStore store(directory);
+		store.SaveWorld(world);
+		store.Flush();
+
+		EditJournal journal(store);
+		journal.Open(world);
+
+		// Group commit: the flusher syncs whatever queued up meanwhile.
+		const int groupEdits = 200000;
+		auto start = Clock::now();
+		for (int i = 0; i < groupEdits; i++)
+			RandomSurfaceEdit(world, journal, rng, mapSize);
+		journal.Sync();
+		double groupMs = ElapsedMs(start);
+		JournalStats groupStats = journal.GetStats();
+
+		// One sync per edit, for comparison.
+		const int syncedEdits = 500;
+		start = Clock::now();
+		for (int i = 0; i < syncedEdits; i++)
+		{
+			RandomSurfaceEdit(world, journal, rng, mapSize);
+			journal.Sync();
+		}
+		double syncedMs = ElapsedMs(start);
+
+		start = Clock::now();
+		journal.BeginCompaction(world);
+		double rotateMs = ElapsedMs(start);
+		journal.WaitForCompaction();
+		double compactMs = ElapsedMs(start);
+		JournalStats compactStats = journal.GetStats();
+		bool oldLogGone = !std::ifstream(journal.GetOldLogPath());
+
+		// A million edits left in the log, plus a torn batch at the end as if
+		// the process died mid-write.
+		const int recoveryEdits = 1000000;
+		for (int i = 0; i < recoveryEdits; i++)
+			RandomSurfaceEdit(world, journal, rng, mapSize);
+		journal.Close();
+		{
+			std::ofstream torn(journal.GetLogPath(), std::ios::binary | std::ios::app);
+			torn.write("torn batch", 10);
+		}
+
+		store.Close(true);
+		World recovered;
+		ChunkCoord maxChunk{ (mapSize - 1) >> ChunkShift, RegionHeight - 1, (mapSize - 1) >> ChunkShift };
+		start = Clock::now();
+		store.LoadArea(recovered, ChunkCoord{ 0, 0, 0 }, maxChunk);
+		double loadMs = ElapsedMs(start);
+
+		EditJournal recoveredJournal(store);
+		start = Clock::now();
+		recoveredJournal.Open(recovered);
+		double recoverMs = ElapsedMs(start);
+		JournalStats recoverStats = recoveredJournal.GetStats();
+		recoveredJournal.Close();
+
+		bool match = true;
+		for (int z = 0; z < mapSize; z++)
+			for (int x = 0; x < mapSize; x++)
+				for (int y = 0; y < ChunkSize * 2; y++)
+					match = match && world.GetBlock(x, y, z) == recovered.GetBlock(x, y, z);
+
+		store.Close();
+		std::remove(store.GetRegionPath(RegionCoord{ 0, 0, 0 }).c_str());
+		std::remove(recoveredJournal.GetLogPath().c_str());
+
+		out << "Edit journal\n";
+		out << "  group commit edits/sec: " << groupEdits * 1000.0 / groupMs << "  syncs: " << groupStats.Batches <<
+			"  edits/sync: " << (double)groupStats.Appended / groupStats.Batches << "\n";
+		out << "  sync per edit edits/sec: " << syncedEdits * 1000.0 / syncedMs << "\n";
+		out << "  compaction rotate ms: " << rotateMs << "  total ms: " << compactMs << "  failed: " << compactStats.FailedCompactions <<
+			"  records left in log: " << compactStats.LogRecords << "  old log " << (oldLogGone ? "deleted" : "KEPT") << "\n";
+		out << "  recovery of " << recoverStats.Replayed << " edits: region load ms: " << loadMs << "  replay + checkpoint ms: " << recoverMs <<
+			"  torn batches: " << recoverStats.TornBatches << "  state " << (match ? "ok" : "MISMATCH") << "\n\n";
+	}
+
+	void BenchmarkAutosave(std::ostream& out)
+	{
+		const int mapSize = 400;
+		const std::string directory = "bench_autosave";
+		std::mt19937 rng(5);
+
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+		RegionStore store(directory);
+
+		// Everything is dirty after generation.
+		Autosave autosave(store);
+		autosave.BeginSave(world);
+		autosave.Wait();
+		AutosaveStats fullStats = autosave.GetStats();
+
+		// Frames that edit the world while the previous save is still running.
+		const int frames = 50;
+		const int editsPerFrame = 200;
+		int skipped = 0;
+		std::uint64_t copiedBytes = 0;
+		std::size_t snapshotBytes = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (int i = 0; i < editsPerFrame; i++)
+			{
+				int x = (int)(rng() % mapSize);
+				int z = (int)(rng() % mapSize);
+				world.SetBlock(x, world.GetSurfaceHeight(x, z) + 1, z, BlockId::Stone);
+			}
+
+			if (!autosave.BeginSave(world))
+				skipped++;
+
+			// The rest of the frame; the save thread gets the CPU meanwhile.
+			std::this_thread::sleep_for(std::chrono::milliseconds(4));
+
+			AutosaveStats stats = autosave.GetStats();
+			copiedBytes = std::max<std::uint64_t>(copiedBytes, stats.LastCopiedBytes);
+			snapshotBytes = std::max(snapshotBytes, stats.LastSnapshotBytes);
+		}
+		autosave.Wait();
+		AutosaveStats editStats = autosave.GetStats();
+		copiedBytes = std::max<std::uint64_t>(copiedBytes, editStats.LastCopiedBytes);
+
+		// Save whatever is left while one chunk is edited again: only that
+		// chunk stays dirty.
+		autosave.BeginSave(world);
+		world.SetBlock(5, world.GetSurfaceHeight(5, 5) + 1, 5, BlockId::Stone);
+		autosave.Wait();
+		autosave.ClearSavedChunks(world);
+		std::size_t dirtyChunks = 0;
+		world.ForEachChunk([&](const Chunk& chunk) { dirtyChunks += chunk.IsDirty() ? 1 : 0; });
+		bool dirtyOk = dirtyChunks == 1 && world.GetChunk(World::ToChunkCoord(5, 0, 5))->IsDirty();
+
+		// A journal that can't write holds the save back: no region may get
+		// ahead of the log.
+		RegionStore missingStore(directory + "/missing/journal");
+		EditJournal failedJournal(missingStore);
+		failedJournal.Open(world);
+		std::uint64_t journalFailures;
+		{
+			Autosave logged(store, &failedJournal);
+			int y = world.GetSurfaceHeight(7, 7) + 1;
+			world.SetBlock(7, y, 7, BlockId::Stone);
+			failedJournal.Append(7, y, 7, BlockId::Stone);
+			logged.BeginSave(world);
+			logged.Wait();
+			logged.ClearSavedChunks(world);
+			journalFailures = logged.GetStats().JournalFailures;
+		}
+		bool writeAheadOk = journalFailures == 1 && world.GetChunk(World::ToChunkCoord(7, 0, 7))->IsDirty();
+
+		// The alternative: stop the frame loop and write every chunk.
+		auto start = Clock::now();
+		store.SaveWorld(world);
+		store.Flush();
+		double blockingMs = ElapsedMs(start);
+
+		store.Close();
+		for (int rz = 0; rz <= ((mapSize - 1) >> (ChunkShift + RegionShift)); rz++)
+			for (int rx = 0; rx <= ((mapSize - 1) >> (ChunkShift + RegionShift)); rx++)
+				std::remove(store.GetRegionPath(RegionCoord{ rx, 0, rz }).c_str());
+
+		out << "Autosave (" << mapSize << "x" << mapSize << " map, " << world.GetChunkCount() << " chunks, world bytes " << world.GetMemoryUsage() << ")\n";
+		out << "  full save: pause ms " << fullStats.LastPauseMs << "  background ms " << fullStats.LastSaveMs << "\n";
+		out << "  " << frames << " frames x " << editsPerFrame << " edits: saves " << editStats.Saves - fullStats.Saves <<
+			"  frames skipped while saving " << skipped << "  max pause ms " << editStats.MaxPauseMs << "\n";
+		out << "  per save, at most: snapshot bytes " << snapshotBytes << "  copy-on-write bytes " << copiedBytes << "\n";
+		out << "  dirty after save with a concurrent edit: " << dirtyChunks << " chunks " << (dirtyOk ? "ok" : "WRONG") <<
+			"  save held back by a failed journal: " << (writeAheadOk ? "ok" : "WRONG") << "\n";
+		out << "  blocking SaveWorld ms: " << blockingMs << "\n\n";
+	}
+
+	void BenchmarkVertexFormat(std::ostream& out)
+	{
+		// Every field value round trips on its own and next to every other field at its extremes.
+		std::size_t checked = 0;
+		std::size_t mismatches = 0;
+		auto check = [&](int x, int y, int z, FaceDirection face, int corner, BlockId block)
+		{
+			int ao = (x + corner) & ChunkVertex::MaxAo;
+			ChunkVertex v = ChunkVertex::Encode(x, y, z, face, corner, block, ao);
+			if (v.GetX() != x || v.GetY() != y || v.GetZ() != z || v.GetFace() != face ||
+				v.GetCorner() != corner || v.GetBlock() != block || v.GetAo() != ao)
+				mismatches++;
+			checked++;
+		};
+
+		const int maxCoord = ChunkVertex::MaxCoord;
+		for (int x = 0; x <= maxCoord; x++)
+			for (int y = 0; y <= maxCoord; y++)
+				for (int z = 0; z <= maxCoord; z++)
+					check(x, y, z, (FaceDirection)((x + y + z) % gNumFaceDirections), (x ^ z) & 3, (BlockId)(y % gNumBlockTypes));
+
+		for (int f = 0; f < gNumFaceDirections; f++)
+			for (int corner = 0; corner < 4; corner++)
+				for (int b = 0; b < gNumBlockTypes; b++)
+				{
+					check(0, 0, 0, (FaceDirection)f, corner, (BlockId)b);
+					check(maxCoord, maxCoord, maxCoord, (FaceDirection)f, corner, (BlockId)b);
+				}
+
+		// Meshes only hold corners of whole blocks inside the chunk.
+		World world;
+		GenerateDefaultMap(world, 1);
+		ChunkMesher mesher;
+		std::size_t vertices = 0;
+		std::size_t outOfRange = 0;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			ChunkMesh mesh = mesher.Mesh(world, chunk.GetCoord());
+			for (const ChunkMeshPart& part : mesh.Parts)
+				for (const ChunkVertex& v : part.Vertices)
+				{
+					if (v.GetX() > ChunkSize || v.GetY() > ChunkSize || v.GetZ() > ChunkSize || v.GetBlock() != part.Block)
+						outOfRange++;
+					vertices++;
+				}
+		});
+
+		// Position, normal and texture coordinates as three, three and two floats.
+		const std::size_t floatVertexBytes = 32;
+
+		out << "Chunk vertex format\n";
+		out << "  encode/decode checks: " << checked << "  mismatches: " << mismatches << "\n";
+		out << "  map vertices: " << vertices << "  bad vertices: " << outOfRange << "\n";
+		out << "  bytes/vertex: " << sizeof(ChunkVertex) << " (float vertex: " << floatVertexBytes << ")" <<
+			"  map vertex bytes: " << vertices * sizeof(ChunkVertex) << " (float vertex: " << vertices * floatVertexBytes << ")\n\n";
+	}
+
+	void BenchmarkMeshing(std::ostream& out)
+	{
+		World world;
+		WorldGenStats stats = GenerateDefaultMap(world, 1);
+
+		std::vector<ChunkCoord> coords;
+		world.ForEachChunk([&](const Chunk& chunk) { coords.push_back(chunk.GetCoord()); });
+
+		ChunkMesher mesher;
+		std::vector<ChunkMesh> meshes(coords.size());
+		double maxChunkMs = 0.0;
+		auto start = Clock::now();
+		for (std::size_t i = 0; i < coords.size(); i++)
+		{
+			auto chunkStart = Clock::now();
+			meshes[i] = mesher.Mesh(world, coords[i]);
+			maxChunkMs = std::max(maxChunkMs, ElapsedMs(chunkStart));
+		}
+		double meshMs = ElapsedMs(start);
+
+		// Every exposed face, counted block by block, against what the quads cover.
+		std::size_t triangles = 0, vertices = 0, meshFaces = 0, quadArea = 0;
+		for (const ChunkMesh& mesh : meshes)
+		{
+			triangles += mesh.GetTriangleCount();
+			vertices += mesh.GetVertexCount();
+			meshFaces += mesh.FaceCount;
+			for (const ChunkMeshPart& part : mesh.Parts)
+			{
+				for (std::size_t q = 0; q < part.Vertices.size(); q += 4)
+				{
+					const ChunkVertex& v0 = part.Vertices[q];
+					const ChunkVertex& v1 = part.Vertices[q + 1];
+					const ChunkVertex& v3 = part.Vertices[q + 3];
+					int sideA = std::abs(v1.GetX() - v0.GetX()) + std::abs(v1.GetY() - v0.GetY()) + std::abs(v1.GetZ() - v0.GetZ());
+					int sideB = std::abs(v3.GetX() - v0.GetX()) + std::abs(v3.GetY() - v0.GetY()) + std::abs(v3.GetZ() - v0.GetZ());
+					quadArea += (std::size_t)(sideA * sideB);
+				}
+			}
+		}
+
+		std::size_t exposedFaces = 0;
+		const int offsets[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			const ChunkCoord& c = chunk.GetCoord();
+			for (int y = 0; y < ChunkSize; y++)
+				for (int z = 0; z < ChunkSize; z++)
+					for (int x = 0; x < ChunkSize; x++)
+					{
+						int wx = c.X * ChunkSize + x, wy = c.Y * ChunkSize + y, wz = c.Z * ChunkSize + z;
+						BlockId id = chunk.GetBlock(x, y, z);
+						for (const int* o : offsets)
+							if (ChunkMesher::IsFaceVisible(id, world.GetBlock(wx + o[0], wy + o[1], wz + o[2])))
+								exposedFaces++;
+					}
+		});
+
+		// CreateBox(1, 1, 1, 3) has 6 faces x 2 triangles x 4^3 after subdividing.
+		const std::size_t boxTriangles = 768;
+
+		out << "Chunk meshing (100x100 map, " << coords.size() << " chunks)\n";
+		out << "  triangles: " << triangles << "  vertices: " << vertices <<
+			"  (subdivided box per block: " << stats.BlockCount * boxTriangles << " triangles)\n";
+		out << "  exposed faces: " << exposedFaces << "  covered by quads: " << meshFaces << "  quad area: " << quadArea <<
+			"  faces/quad: " << (double)meshFaces / (vertices / 4) << "\n";
+		out << "  mesh ms: " << meshMs << "  ms/chunk: " << meshMs / coords.size() << "  max ms/chunk: " << maxChunkMs << "\n\n";
+	}
+
+	void BenchmarkFaceCulling(std::ostream& out)
+	{
+		World world;
+		GenerateDefaultMap(world, 1);
+
+		std::vector<BlockId> padded;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			padded.resize(padded.size() + MeshPadVolume);
+			ChunkMesher::GatherBlocks(world, chunk.GetCoord(), &padded[padded.size() - MeshPadVolume]);
+		});
+		const std::size_t chunkCount = padded.size() / MeshPadVolume;
+
+		// The per-block check every face would need without masks.
+		auto naive = [](const BlockId* blocks, ChunkFaceMasks& masks)
+		{
+			const int offsets[gNumFaceDirections][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+			for (int d = 0; d < gNumFaceDirections; d++)
+				for (int y = 0; y < ChunkSize; y++)
+					for (int z = 0; z < ChunkSize; z++)
+					{
+						std::uint16_t row = 0;
+						for (int x = 0; x < ChunkSize; x++)
+						{
+							BlockId block = blocks[ChunkMesher::PaddedIndex(x, y, z)];
+							BlockId neighbour = blocks[ChunkMesher::PaddedIndex(x + offsets[d][0], y + offsets[d][1], z + offsets[d][2])];
+							if (ChunkMesher::IsFaceVisible(block, neighbour))
+								row |= (std::uint16_t)(1 << x);
+						}
+						masks.Rows[d][(y << ChunkShift) | z] = row;
+					}
+		};
+
+		struct Kernel
+		{
+			const char* Name;
+			std::function<void(const BlockId*, ChunkFaceMasks&)> Run;
+		};
+		std::vector<Kernel> kernels = { { "naive", naive }, { "scalar", CullHiddenFacesScalar } };
+		if (IsAvx2Supported())
+			kernels.push_back({ "avx2", CullHiddenFacesAvx2 });
+
+		out << "Face culling (" << chunkCount << " chunks, avx2 " << (IsAvx2Supported() ? "available" : "unavailable") << ")\n";
+
+		std::vector<ChunkFaceMasks> reference(chunkCount);
+		for (std::size_t c = 0; c < chunkCount; c++)
+			naive(&padded[c * MeshPadVolume], reference[c]);
+
+		const int passes = 50;
+		for (const Kernel& kernel : kernels)
+		{
+			ChunkFaceMasks masks;
+			std::size_t mismatches = 0;
+			unsigned int sum = 0;
+			auto start = Clock::now();
+			for (int pass = 0; pass < passes; pass++)
+			{
+				for (std::size_t c = 0; c < chunkCount; c++)
+				{
+					kernel.Run(&padded[c * MeshPadVolume], masks);
+					sum += masks.Rows[pass % gNumFaceDirections][c & 0xFF];
+					if (pass == 0 && std::memcmp(&masks, &reference[c], sizeof(masks)) != 0)
+						mismatches++;
+				}
+			}
+			double ms = ElapsedMs(start);
+			gSink = sum;
+
+			// Each chunk decides every face of every block, air included.
+			const double chunks = (double)passes * chunkCount;
+			out << "  " << kernel.Name << " ns/chunk: " << ms * 1.0e6 / chunks <<
+				"  faces/sec: " << chunks * ChunkVolume * gNumFaceDirections / (ms / 1000.0) <<
+				"  mismatched chunks: " << mismatches << "\n";
+		}
+
+		std::size_t exposed = 0;
+		for (const ChunkFaceMasks& masks : reference)
+			exposed += masks.GetFaceCount();
+		out << "  exposed faces: " << exposed << " of " << chunkCount * ChunkVolume * gNumFaceDirections << "\n\n";
+	}
+
+	void BenchmarkMeshWorkers(std::ostream& out)
+	{
+		const int mapSize = 400;
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+
+		std::vector<ChunkCoord> coords;
+		world.ForEachChunk([&](const Chunk& chunk) { coords.push_back(chunk.GetCoord()); });
+
+		// Reference: everything meshed on this thread straight from the world.
+		ChunkMesher mesher;
+		std::size_t referenceTriangles = 0;
+		auto start = Clock::now();
+		for (const ChunkCoord& c : coords)
+			referenceTriangles += mesher.Mesh(world, c).GetTriangleCount();
+		double referenceMs = ElapsedMs(start);
+
+		const int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		out << "Mesh worker pool (" << mapSize << "x" << mapSize << " map, " << coords.size() << " chunks, " <<
+			hardwareThreads << " hardware threads)\n";
+		out << "  calling thread ms: " << referenceMs << "  chunks/sec: " << coords.size() / (referenceMs / 1000.0) << "\n";
+
+		double oneThreadMs = 0.0;
+		for (int threads = 1; threads <= std::max(4, hardwareThreads); threads *= 2)
+		{
+			MeshWorkerPool pool(threads);
+			std::size_t triangles = 0;
+			std::size_t popped = 0;
+			ChunkMesh mesh;
+
+			start = Clock::now();
+			for (const ChunkCoord& c : coords)
+				pool.Submit(world, c);
+			double submitMs = ElapsedMs(start);
+
+			while (pool.GetPendingCount() > 0)
+			{
+				if (pool.PopCompleted(mesh))
+				{
+					triangles += mesh.GetTriangleCount();
+					popped++;
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+			double ms = ElapsedMs(start);
+			if (threads == 1)
+				oneThreadMs = ms;
+
+			out << "  " << threads << " workers ms: " << ms << "  chunks/sec: " << coords.size() / (ms / 1000.0) <<
+				"  speedup: " << oneThreadMs / ms << "  submit us/chunk: " << submitMs * 1000.0 / coords.size() <<
+				"  worker ms: " << pool.GetStats().WorkerMs <<
+				"  meshes ok: " << (popped == coords.size() && triangles == referenceTriangles ? "yes" : "no") << "\n";
+		}
+
+		out << "\n";
+	}
+
+	void BenchmarkRemeshing(std::ostream& out)
+	{
+		const int mapSize = 100;
+		out << "Incremental remeshing (" << mapSize << "x" << mapSize << " map, random surface edits)\n";
+
+		const int storms[] = { 100, 1000, 10000 };
+		for (int edits : storms)
+		{
+			World world;
+			GenerateDefaultMap(world, 1, mapSize);
+
+			// Triangles of the mesh currently "on the GPU" for each chunk.
+			ChunkMesher mesher;
+			std::unordered_map<std::uint64_t, std::size_t> meshes;
+			world.ForEachChunk([&](const Chunk& chunk)
+			{
+				meshes[PackChunkCoord(chunk.GetCoord())] = mesher.Mesh(world, chunk.GetCoord()).GetTriangleCount();
+			});
+
+			// The whole storm lands in one frame.
+			RemeshQueue queue;
+			std::mt19937 rng(edits);
+			std::size_t boundaryEdits = 0;
+			for (int i = 0; i < edits; i++)
+			{
+				int x = (int)(rng() % mapSize);
+				int z = (int)(rng() % mapSize);
+				int y = world.GetSurfaceHeight(x, z);
+				if (rng() % 2 == 0 && y > 0)
+					world.SetBlock(x, y, z, BlockId::Air);
+				else
+					world.SetBlock(x, ++y, z, BlockId::Stone);
+
+				queue.MarkBlockChanged(x, y, z);
+				if ((x & ChunkMask) == 0 || (x & ChunkMask) == ChunkMask || (y & ChunkMask) == 0 ||
+					(y & ChunkMask) == ChunkMask || (z & ChunkMask) == 0 || (z & ChunkMask) == ChunkMask)
+					boundaryEdits++;
+			}
+
+			MeshWorkerPool pool(1);
+			auto start = Clock::now();
+			std::size_t remeshes = queue.Submit(world, pool);
+			ChunkMesh mesh;
+			while (pool.GetPendingCount() > 0)
+			{
+				if (!pool.PopCompleted(mesh))
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				queue.Completed(mesh.Coord);
+				meshes[PackChunkCoord(mesh.Coord)] = mesh.GetTriangleCount();
+			}
+			double ms = ElapsedMs(start);
+
+			// Every chunk must now match a fresh mesh, or an edit was missed.
+			std::size_t stale = 0;
+			world.ForEachChunk([&](const Chunk& chunk)
+			{
+				if (meshes[PackChunkCoord(chunk.GetCoord())] != mesher.Mesh(world, chunk.GetCoord()).GetTriangleCount())
+					stale++;
+			});
+
+			out << "  " << edits << " edits (" << boundaryEdits << " on a boundary): chunk marks: " << queue.GetStats().ChunksMarked <<
+				"  remeshes: " << remeshes << " of " << world.GetChunkCount() << " chunks" <<
+				"  mesh ms: " << ms << "  worker ms: " << pool.GetStats().WorkerMs << "  stale chunks: " << stale << "\n";
+		}
+
+		out << "\n";
+	}
+
+	void BenchmarkAmbientOcclusion(std::ostream& out)
+	{
+		// The lookup: (side1, side2, corner) -> level, with two sides always darkest.
+		const int expected[8] = { 3, 2, 2, 1, 2, 1, 0, 0 };
+		int tableMismatches = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			if (ChunkMesher::VertexAo((i & 4) != 0, (i & 2) != 0, (i & 1) != 0) != expected[i])
+				tableMismatches++;
+		}
+
+		World world;
+		GenerateDefaultMap(world, 1);
+		std::vector<ChunkCoord> coords;
+		world.ForEachChunk([&](const Chunk& chunk) { coords.push_back(chunk.GetCoord()); });
+
+		// Meshing time with and without occlusion, best of three passes.
+		ChunkMesher mesher;
+		std::vector<ChunkMesh> meshes(coords.size());
+		double meshMs[2] = { 1.0e30, 1.0e30 };
+		std::size_t triangles[2] = {};
+		for (int pass = 0; pass < 6; pass++)
+		{
+			int withAo = pass & 1;
+			mesher.SetAmbientOcclusion(withAo != 0);
+			triangles[withAo] = 0;
+			auto start = Clock::now();
+			for (std::size_t i = 0; i < coords.size(); i++)
+				meshes[i] = mesher.Mesh(world, coords[i]);
+			meshMs[withAo] = std::min(meshMs[withAo], ElapsedMs(start));
+			for (const ChunkMesh& mesh : meshes)
+				triangles[withAo] += mesh.GetTriangleCount();
+		}
+
+		// Every vertex of the occluded meshes against the blocks around its corner
+		// in the world, looked up one at a time.
+		std::size_t vertices = 0, shaded = 0, mismatches = 0, quads = 0, flipped = 0;
+		for (const ChunkMesh& mesh : meshes)
+		{
+			const int origin[3] = { mesh.Coord.X * ChunkSize, mesh.Coord.Y * ChunkSize, mesh.Coord.Z * ChunkSize };
+			for (const ChunkMeshPart& part : mesh.Parts)
+			{
+				for (std::size_t q = 0; q < part.Vertices.size(); q += 4)
+				{
+					const int face = (int)part.Vertices[q].GetFace();
+					const int axis = face / 2, sign = (face & 1) ? -1 : 1;
+					const int uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+
+					int pos[4][3];
+					int minU = ChunkVertex::MaxCoord, minV = ChunkVertex::MaxCoord;
+					for (int k = 0; k < 4; k++)
+					{
+						const ChunkVertex& v = part.Vertices[q + k];
+						pos[k][0] = v.GetX();
+						pos[k][1] = v.GetY();
+						pos[k][2] = v.GetZ();
+						minU = std::min(minU, pos[k][uAxis]);
+						minV = std::min(minV, pos[k][vAxis]);
+					}
+
+					for (int k = 0; k < 4; k++)
+					{
+						// The face of the quad that has this vertex as a corner.
+						int cu = pos[k][uAxis] > minU ? 1 : 0;
+						int cv = pos[k][vAxis] > minV ? 1 : 0;
+						int cell[3];
+						cell[axis] = pos[k][axis] - (sign > 0 ? 0 : 1);
+						cell[uAxis] = pos[k][uAxis] - cu;
+						cell[vAxis] = pos[k][vAxis] - cv;
+
+						auto opaque = [&](int du, int dv)
+						{
+							int p[3] = { cell[0], cell[1], cell[2] };
+							p[uAxis] += du;
+							p[vAxis] += dv;
+							return HasBlockFlag(world.GetBlock(origin[0] + p[0], origin[1] + p[1], origin[2] + p[2]), BlockFlag_Opaque);
+						};
+						int du = cu ? 1 : -1, dv = cv ? 1 : -1;
+						int ao = ChunkMesher::VertexAo(opaque(du, 0), opaque(0, dv), opaque(du, dv));
+
+						int actual = part.Vertices[q + k].GetAo();
+						if (actual != ao)
+							mismatches++;
+						if (actual < ChunkVertex::MaxAo)
+							shaded++;
+						vertices++;
+					}
+
+					// Flipped quads start at their second corner.
+					if (part.Vertices[q].GetCorner() != 0)
+						flipped++;
+					quads++;
+				}
+			}
+		}
+
+		out << "Ambient occlusion (100x100 map, " << coords.size() << " chunks)\n";
+		out << "  lookup table mismatches: " << tableMismatches << "\n";
+		out << "  vertices: " << vertices << "  shaded: " << shaded << "  mismatches against world: " << mismatches <<
+			"  quads flipped: " << flipped << "/" << quads << "\n";
+		out << "  triangles without/with: " << triangles[0] << "/" << triangles[1] << "\n";
+		out << "  mesh ms without/with: " << meshMs[0] << "/" << meshMs[1] <<
+			"  overhead: " << (meshMs[1] / meshMs[0] - 1.0) * 100.0 << "%\n\n";
+	}
+
+	void BenchmarkChunkLod(std::ostream& out)
+	{
+		const int mapSize = 400;
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+		std::vector<ChunkCoord> coords;
+		world.ForEachChunk([&](const Chunk& chunk) { coords.push_back(chunk.GetCoord()); });
+
+		// Every chunk at every level with both selections.
+		const LodSelection selections[2] = { LodSelection::Majority, LodSelection::Surface };
+		const char* selectionNames[2] = { "majority", "surface" };
+		std::vector<std::size_t> triangles[2][MaxChunkLod + 1];
+		std::size_t skirtTriangles[2][MaxChunkLod + 1] = {};
+		double meshMs[2][MaxChunkLod + 1] = {};
+		ChunkMesher mesher;
+		std::vector<BlockId> padded(MeshPadVolume), coarse(MeshPadVolume);
+
+		// The octree's representative types, sampled at each level, against the
+		// coarse blocks; holes are coarse surface cells the octree leaves empty.
+		WorldOctree octree;
+		octree.Build(world);
+		std::size_t octreeMismatches[2][MaxChunkLod + 1] = {};
+		std::size_t octreeHoles[MaxChunkLod + 1] = {};
+		ChunkMesh mesh;
+		for (int s = 0; s < 2; s++)
+		{
+			for (int lod = 0; lod <= MaxChunkLod; lod++)
+			{
+				const int size = ChunkSize >> lod;
+				for (const ChunkCoord& coord : coords)
+				{
+					ChunkMesher::GatherBlocks(world, coord, padded.data());
+					auto start = Clock::now();
+					MeshChunkLod(mesher, coord, padded.data(), lod, selections[s], coarse.data(), mesh);
+					meshMs[s][lod] += ElapsedMs(start);
+					triangles[s][lod].push_back(mesh.GetTriangleCount());
+
+					// Faces closing a coarse chunk on its boundary.
+					if (lod == 0)
+						continue;
+					for (int cy = 0; cy < size; cy++)
+					{
+						for (int cz = 0; cz < size; cz++)
+						{
+							for (int cx = 0; cx < size; cx++)
+							{
+								BlockId sampled = octree.GetBlock((coord.X << ChunkShift) + (cx << lod),
+									(coord.Y << ChunkShift) + (cy << lod), (coord.Z << ChunkShift) + (cz << lod), lod);
+								BlockId expected = coarse[ChunkMesher::PaddedIndex(cx, cy, cz)];
+								octreeMismatches[s][lod] += sampled != expected ? 1 : 0;
+								if (selections[s] == LodSelection::Surface)
+									octreeHoles[lod] += sampled == BlockId::Air && expected != BlockId::Air ? 1 : 0;
+							}
+						}
+					}
+					for (const ChunkMeshPart& part : mesh.Parts)
+					{
+						for (std::size_t q = 0; q < part.Vertices.size(); q += 4)
+						{
+							const ChunkVertex& v = part.Vertices[q];
+							int axis = (int)v.GetFace() / 2;
+							int p = axis == 0 ? v.GetX() : axis == 1 ? v.GetY() : v.GetZ();
+							if (p == 0 || p == size)
+								skirtTriangles[s][lod] += 2;
+						}
+					}
+				}
+			}
+		}
+
+		out << "Chunk LOD (" << mapSize << "x" << mapSize << " map, " << coords.size() << " chunks)\n";
+		for (int s = 0; s < 2; s++)
+		{
+			out << "  " << selectionNames[s] << ":";
+			for (int lod = 0; lod <= MaxChunkLod; lod++)
+			{
+				std::size_t total = 0;
+				for (std::size_t t : triangles[s][lod])
+					total += t;
+				out << "  level " << lod << " triangles " << total << " (skirts " << skirtTriangles[s][lod] << ") ms " << meshMs[s][lod];
+			}
+			out << "\n";
+		}
+		out << "  octree cells differing from majority/surface:";
+		for (int lod = 1; lod <= MaxChunkLod; lod++)
+		{
+			double cells = (double)coords.size() * (ChunkVolume >> (3 * lod));
+			out << "  level " << lod << " " << octreeMismatches[0][lod] / cells << "/" << octreeMismatches[1][lod] / cells <<
+				" (holes " << octreeHoles[lod] / cells << ")";
+		}
+		out << "\n";
+
+		// Chunks whose centres are within the render distance of a camera in the
+		// middle of the map, drawn at full resolution or at their level.
+		const float eye[3] = { mapSize * 0.5f, 40.0f, mapSize * 0.5f };
+		const float distances[4] = { 64.0f, 128.0f, 192.0f, 256.0f };
+		for (float distance : distances)
+		{
+			std::size_t chunks = 0, full = 0, withLod[2] = {};
+			for (std::size_t i = 0; i < coords.size(); i++)
+			{
+				float dx = coords[i].X * ChunkSize + ChunkSize * 0.5f - eye[0];
+				float dz = coords[i].Z * ChunkSize + ChunkSize * 0.5f - eye[2];
+				if (dx * dx + dz * dz > distance * distance)
+					continue;
+
+				int lod = SelectChunkLod(coords[i], eye[0], eye[1], eye[2]);
+				chunks++;
+				full += triangles[0][0][i];
+				for (int s = 0; s < 2; s++)
+					withLod[s] += triangles[s][lod][i];
+			}
+
+			out << "  render distance " << distance << ": chunks " << chunks << "  triangles full " << full <<
+				"  with LOD (majority) " << withLod[0] << "  with LOD (surface) " << withLod[1] << "\n";
+		}
+		out << "\n";
+	}
+
+	void BenchmarkTranslucentSort(std::ostream& out)
+	{
+		const int mapSize = 400;
+		World world;
+		GenerateDefaultMap(world, 1, mapSize);
+
+		ChunkMesher mesher;
+		TranslucentSorter sorter;
+		std::unordered_map<std::uint64_t, ChunkMesh> meshes;
+		std::size_t quads = 0;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			ChunkMesh mesh = mesher.Mesh(world, chunk.GetCoord());
+			for (const ChunkMeshPart& part : mesh.Parts)
+				if (part.Layer == ChunkLayer::Translucent)
+					quads += part.GetQuadCount();
+			sorter.SetChunk(mesh);
+			meshes[PackChunkCoord(chunk.GetCoord())] = std::move(mesh);
+		});
+
+		// Back to front from the camera's block, ties in mesh order.
+		const float eye[3] = { mapSize * 0.7f + 0.25f, 20.5f, mapSize * 0.7f + 0.75f };
+		sorter.Update(eye[0], eye[1], eye[2]);
+		const std::int64_t eye2[3] = { (std::int64_t)std::floor(eye[0]) * 2 + 1, (std::int64_t)std::floor(eye[1]) * 2 + 1, (std::int64_t)std::floor(eye[2]) * 2 + 1 };
+		auto distanceSq = [&](const std::int64_t* p2)
+		{
+			std::int64_t d[3] = { p2[0] - eye2[0], p2[1] - eye2[1], p2[2] - eye2[2] };
+			return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+		};
+
+		std::size_t misordered = 0, ties = 0, misorderedChunks = 0;
+		std::int64_t lastChunkDistance = std::numeric_limits<std::int64_t>::max();
+		const std::vector<std::uint32_t>& indices = sorter.GetIndices();
+		for (const TranslucentRange& range : sorter.GetRanges())
+		{
+			const ChunkCoord& c = range.Coord;
+			std::int64_t centre2[3] = { (c.X * 2 + 1) * ChunkSize, (c.Y * 2 + 1) * ChunkSize, (c.Z * 2 + 1) * ChunkSize };
+			std::int64_t chunkDistance = distanceSq(centre2);
+			if (chunkDistance > lastChunkDistance)
+				misorderedChunks++;
+			lastChunkDistance = chunkDistance;
+
+			const ChunkMesh& mesh = meshes[PackChunkCoord(c)];
+			auto part = std::find_if(mesh.Parts.begin(), mesh.Parts.end(), [&](const ChunkMeshPart& p) { return p.Block == range.Block; });
+			std::int64_t lastDistance = std::numeric_limits<std::int64_t>::max();
+			std::uint32_t lastQuad = 0;
+			for (std::uint32_t i = range.StartIndex; i < range.StartIndex + range.IndexCount; i += 6)
+			{
+				std::uint32_t q = indices[i] / 4;
+				const ChunkVertex& a = part->Vertices[q * 4];
+				const ChunkVertex& b = part->Vertices[q * 4 + 2];
+				std::int64_t p2[3] = { c.X * ChunkSize * 2 + a.GetX() + b.GetX(), c.Y * ChunkSize * 2 + a.GetY() + b.GetY(), c.Z * ChunkSize * 2 + a.GetZ() + b.GetZ() };
+				std::int64_t distance = distanceSq(p2);
+				if (distance > lastDistance || (distance == lastDistance && q < lastQuad))
+					misordered++;
+				if (distance == lastDistance)
+					ties++;
+				lastDistance = distance;
+				lastQuad = q;
+			}
+		}
+
+		// A grid of unit quads around the camera's block, where mirrored quads tie.
+		ChunkMeshPart grid;
+		for (int z = 0; z < ChunkSize; z++)
+			for (int x = 0; x < ChunkSize; x++)
+			{
+				grid.Vertices.push_back(ChunkVertex::Encode(x, 1, z, FaceDirection::PosY, 0, BlockId::Water));
+				grid.Vertices.push_back(ChunkVertex::Encode(x, 1, z + 1, FaceDirection::PosY, 1, BlockId::Water));
+				grid.Vertices.push_back(ChunkVertex::Encode(x + 1, 1, z + 1, FaceDirection::PosY, 2, BlockId::Water));
+				grid.Vertices.push_back(ChunkVertex::Encode(x + 1, 1, z, FaceDirection::PosY, 3, BlockId::Water));
+			}
+		const std::int64_t gridEye2[3] = { 15, 5, 15 };
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> scratch;
+		std::vector<std::uint32_t> gridIndices;
+		TranslucentSorter::SortQuads(grid, ChunkCoord{}, gridEye2, scratch, gridIndices);
+		std::int64_t lastDistance = std::numeric_limits<std::int64_t>::max();
+		std::uint32_t lastQuad = 0;
+		for (std::size_t i = 0; i < gridIndices.size(); i += 6)
+		{
+			std::uint32_t q = gridIndices[i] / 4;
+			std::int64_t dx = (q % ChunkSize) * 2 + 1 - gridEye2[0], dz = (q / ChunkSize) * 2 + 1 - gridEye2[2], dy = 2 - gridEye2[1];
+			std::int64_t distance = dx * dx + dy * dy + dz * dz;
+			if (distance > lastDistance || (distance == lastDistance && q < lastQuad))
+				misordered++;
+			if (distance == lastDistance)
+				ties++;
+			lastDistance = distance;
+			lastQuad = q;
+		}
+
+		// The same block gives the same indices, whatever the position inside it,
+		// the order chunks were added in or where the camera has been since.
+		std::vector<std::uint32_t> first = indices;
+		bool sameBlockResorted = sorter.Update(eye[0] + 0.5f, eye[1] - 0.25f, eye[2] - 0.5f);
+		sorter.Update(eye[0] + 5.0f, eye[1], eye[2] - 3.0f);
+		sorter.Update(eye[0], eye[1], eye[2]);
+		bool returnSame = sorter.GetIndices() == first;
+
+		TranslucentSorter reversed;
+		std::vector<std::uint64_t> keys;
+		for (const auto& e : meshes)
+			keys.push_back(e.first);
+		std::sort(keys.rbegin(), keys.rend());
+		for (std::uint64_t key : keys)
+			reversed.SetChunk(meshes[key]);
+		reversed.Update(eye[0], eye[1], eye[2]);
+		bool insertionSame = reversed.GetIndices() == first;
+
+		// Walking at 10 blocks a second at 60 frames a second, sorting only on
+		// a new block against sorting every frame.
+		const int frames = 600;
+		const float step = 10.0f / 60.0f;
+		TranslucentSortStats before = sorter.GetStats();
+		for (int f = 0; f < frames; f++)
+			sorter.Update(eye[0] + f * step, eye[1], eye[2] + f * step * 0.5f);
+		TranslucentSortStats walk = sorter.GetStats();
+		std::uint64_t sorts = walk.Sorts - before.Sorts;
+		double walkMs = walk.TotalSortMs - before.TotalSortMs;
+		double perSortMs = sorts > 0 ? walkMs / sorts : 0.0;
+
+		out << "Translucent sorting (" << mapSize << "x" << mapSize << " map, " << sorter.GetChunkCount() << " chunks with water, " << quads << " quads)\n";
+		out << "  misordered quads (map and test grid): " << misordered << " (distance ties: " << ties << ")  misordered chunks: " << misorderedChunks << "\n";
+		out << "  same block re-sorted: " << (sameBlockResorted ? "yes" : "no") << "  same indices after moving away and back: " << (returnSame ? "yes" : "no") <<
+			"  same indices for another insertion order: " << (insertionSame ? "yes" : "no") << "\n";
+		out << "  " << frames << " frame walk: sorts " << sorts << "  ms/sort " << perSortMs << "  ms/frame " << walkMs / frames <<
+			"  (sorting every frame: ms/frame " << perSortMs << ")\n\n";
+	}
+
+	void BenchmarkQuadIndices(std::ostream& out)
+	{
+		// The shared pattern in both widths, up to the last index 16 bits can hold.
+		std::vector<std::uint16_t> indices16;
+		std::vector<std::uint32_t> indices32;
+		BuildQuadIndices(MaxQuads16, indices16);
+		BuildQuadIndices(MaxQuads16, indices32);
+		std::size_t patternMismatches = 0;
+		for (std::size_t i = 0; i < indices32.size(); i++)
+		{
+			if (indices16[i] != indices32[i] || indices32[i] != (i / 6) * 4 + QuadIndexPattern[i % 6])
+				patternMismatches++;
+		}
+
+		// The worst case for one part: a checkerboard with every face showing.
+		World checkerboard;
+		for (int y = 0; y < ChunkSize; y++)
+			for (int z = 0; z < ChunkSize; z++)
+				for (int x = 0; x < ChunkSize; x++)
+					if (((x + y + z) & 1) == 0)
+						checkerboard.SetBlock(x, y, z, BlockId::Stone);
+		ChunkMesher mesher;
+		std::size_t worstQuads = mesher.Mesh(checkerboard, ChunkCoord{}).Parts[0].GetQuadCount();
+
+		const std::size_t sharedBytes = indices16.size() * sizeof(std::uint16_t);
+		out << "Shared quad indices\n";
+		out << "  pattern mismatches: " << patternMismatches << "  checkerboard part quads: " << worstQuads <<
+			" (MaxChunkPartQuads " << MaxChunkPartQuads << ", 16-bit limit " << MaxQuads16 << ")\n";
+
+		const int mapSizes[2] = { 100, 400 };
+		for (int mapSize : mapSizes)
+		{
+			World world;
+			GenerateDefaultMap(world, 1, mapSize);
+			std::size_t chunks = 0, quads = 0, maxPartQuads = 0;
+			world.ForEachChunk([&](const Chunk& chunk)
+			{
+				ChunkMesh mesh = mesher.Mesh(world, chunk.GetCoord());
+				if (mesh.IsEmpty())
+					return;
+				chunks++;
+				for (const ChunkMeshPart& part : mesh.Parts)
+				{
+					quads += part.GetQuadCount();
+					maxPartQuads = std::max(maxPartQuads, part.GetQuadCount());
+				}
+			});
+
+			// Per-chunk 32-bit indices were held on the GPU and in a CPU blob, and went through an upload buffer.
+			std::size_t perChunkBytes = quads * 6 * sizeof(std::uint32_t);
+			out << "  " << mapSize << "x" << mapSize << " map: chunks " << chunks << "  quads " << quads << "  largest part quads " << maxPartQuads << "\n";
+			out << "    per-chunk index bytes: gpu " << perChunkBytes << " + cpu " << perChunkBytes << "  uploaded " << perChunkBytes << "  uploads " << chunks << "\n";
+			out << "    shared index bytes: gpu " << sharedBytes << " + cpu 0  uploaded " << sharedBytes << "  uploads 1\n";
+		}
+		out << "\n";
+	}
+
+	// Mirrors ChunkVS in Default.hlsl.
+	void ChunkTexC(int face, const float* p, float* texC)
+	{
+		float side = (face & 1) ? -1.0f : 1.0f;
+		if (face < 2)
+		{
+			texC[0] = side * p[2];
+			texC[1] = -p[1];
+		}
+		else if (face < 4)
+		{
+			texC[0] = p[0];
+			texC[1] = -side * p[2];
+		}
+		else
+		{
+			texC[0] = -side * p[0];
+			texC[1] = -p[1];
+		}
+	}
+
+	void Cross(const float* a, const float* b, float* c)
+	{
+		c[0] = a[1] * b[2] - a[2] * b[1];
+		c[1] = a[2] * b[0] - a[0] * b[2];
+		c[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void BenchmarkVoxelFaces(std::ostream& out)
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::VoxelMeshData faces = geoGen.CreateVoxelFaces();
+
+		int rangeErrors = 0, uvErrors = 0, mirrored = 0, meshMismatches = 0;
+		int frontFromOutside = 0, culledFromInside = 0, triangles = 0;
+
+		// One lone block meshed by the chunk mesher, for comparison.
+		World world;
+		world.SetBlock(0, 0, 0, BlockId::Stone);
+		ChunkMesher mesher;
+		ChunkMesh mesh = mesher.Mesh(world, ChunkCoord{});
+		const std::vector<ChunkVertex>& chunkVertices = mesh.Parts[0].Vertices;
+
+		for (int f = 0; f < gNumFaceDirections; f++)
+		{
+			const GeometryGenerator::VoxelSubmesh& submesh = faces.Faces[f];
+			GeometryGenerator::VoxelMeshData single = geoGen.CreateVoxelFace((GeometryGenerator::VoxelFace)f);
+			if (submesh.IndexCount != 6 || submesh.StartIndexLocation != (std::uint32_t)f * 6 || submesh.BaseVertexLocation != (std::uint32_t)f * 4 ||
+				single.Vertices.size() != 4 || single.Indices.size() != 6)
+				rangeErrors++;
+
+			const GeometryGenerator::VoxelVertex* v = &faces.Vertices[submesh.BaseVertexLocation];
+			float p[4][3];
+			for (int i = 0; i < 4; i++)
+			{
+				p[i][0] = v[i].X;
+				p[i][1] = v[i].Y;
+				p[i][2] = v[i].Z;
+				if (v[i].Face != f || std::memcmp(&v[i], &single.Vertices[i], sizeof(v[i])) != 0)
+					rangeErrors++;
+
+				float texC[2];
+				ChunkTexC(f, p[i], texC);
+				if (std::fmod(texC[0] - v[i].U + 2.0f, 1.0f) != 0.0f || std::fmod(texC[1] - v[i].V + 2.0f, 1.0f) != 0.0f)
+					uvErrors++;
+			}
+
+			DirectX::XMFLOAT3 normal3 = geoGen.GetVoxelFaceNormal((GeometryGenerator::VoxelFace)f);
+			const float n[3] = { normal3.x, normal3.y, normal3.z };
+
+			// Look at the face from outside and inside with a left-handed camera
+			// like XMMatrixLookAtLH, and take the winding on screen, y up.  The
+			// opaque PSO culls back faces and leaves FrontCounterClockwise off,
+			// so clockwise triangles are the ones drawn.
+			for (int look = 0; look < 2; look++)
+			{
+				float forward[3] = { -n[0], -n[1], -n[2] };
+				if (look == 1)
+					std::copy(n, n + 3, forward);
+				float upHint[3] = { 0.0f, 1.0f, 0.0f };
+				if (f / 2 == 1)
+					std::swap(upHint[1], upHint[2]);
+				float right[3], up[3];
+				Cross(upHint, forward, right);
+				Cross(forward, right, up);
+
+				for (std::uint32_t t = 0; t < submesh.IndexCount; t += 3)
+				{
+					const std::uint16_t* tri = &faces.Indices[submesh.StartIndexLocation + t];
+					float sx[3], sy[3];
+					for (int i = 0; i < 3; i++)
+					{
+						sx[i] = Dot(p[tri[i]], right);
+						sy[i] = Dot(p[tri[i]], up);
+					}
+					float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+					if (look == 0)
+					{
+						triangles++;
+						if (area < 0.0f)
+							frontFromOutside++;
+					}
+					else if (area > 0.0f)
+					{
+						culledFromInside++;
+					}
+				}
+			}
+
+			// u to the right and v down when seen from outside: not mirrored.
+			float du[3] = {}, dv[3] = {};
+			for (int i = 0; i < 4; i++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					du[k] += (v[i].U ? 1.0f : -1.0f) * p[i][k];
+					dv[k] += (v[i].V ? 1.0f : -1.0f) * p[i][k];
+				}
+			}
+			float uv[3];
+			Cross(du, dv, uv);
+			if (Dot(uv, n) <= 0.0f)
+				mirrored++;
+
+			// The chunk mesher's quad for the same face has the same corners in the same order.
+			bool found = false;
+			for (std::size_t q = 0; q + 4 <= chunkVertices.size(); q += 4)
+			{
+				if ((int)chunkVertices[q].GetFace() != f)
+					continue;
+				found = true;
+				for (int i = 0; i < 4; i++)
+				{
+					const ChunkVertex& c = chunkVertices[q + i];
+					if (c.GetX() != v[i].X || c.GetY() != v[i].Y || c.GetZ() != v[i].Z)
+						meshMismatches++;
+				}
+			}
+			if (!found)
+				meshMismatches++;
+		}
+
+		out << "Voxel face primitives\n";
+		out << "  faces " << gNumFaceDirections << "  vertices " << faces.Vertices.size() << " x " << sizeof(GeometryGenerator::VoxelVertex) <<
+			" bytes  indices " << faces.Indices.size() << " x 16-bit\n";
+		out << "  front from outside: " << frontFromOutside << "/" << triangles << "  culled from inside: " << culledFromInside << "/" << triangles << "\n";
+		out << "  range errors: " << rangeErrors << "  uv errors: " << uvErrors << "  mirrored faces: " << mirrored <<
+			"  chunk mesh mismatches: " << meshMismatches << "\n\n";
+	}
+	// First fetches of vertices that don't follow on from the one before.
+	template<typename Index>
+	std::size_t CountFetchJumps(const std::vector<Index>& indices, std::size_t vertexCount)
+	{
+		std::vector<bool> fetched(vertexCount, false);
+		std::size_t jumps = 0;
+		std::int64_t last = -1;
+		for (Index i : indices)
+		{
+			if (fetched[i])
+				continue;
+			fetched[i] = true;
+			if ((std::int64_t)i != last + 1)
+				jumps++;
+			last = i;
+		}
+		return jumps;
+	}
+
+	// The mesh's triangles as vertex contents, each rotated to start at its
+	// smallest vertex so the winding is kept, in sorted order.
+	std::vector<std::string> CanonicalTriangles(const GeometryGenerator::MeshData& mesh)
+	{
+		std::vector<std::string> triangles;
+		for (std::size_t t = 0; t + 2 < mesh.Indices32.size(); t += 3)
+		{
+			std::string v[3];
+			for (int k = 0; k < 3; k++)
+				v[k].assign((const char*)&mesh.Vertices[mesh.Indices32[t + k]], sizeof(GeometryGenerator::Vertex));
+			int first = (int)(std::min_element(v, v + 3) - v);
+			triangles.push_back(v[first] + v[(first + 1) % 3] + v[(first + 2) % 3]);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	void BenchmarkMeshOptimizer(std::ostream& out)
+	{
+		GeometryGenerator geoGen;
+		struct Shape
+		{
+			const char* Name;
+			GeometryGenerator::MeshData Mesh;
+		};
+		std::vector<Shape> shapes;
+		shapes.push_back({ "box (3 subdivisions)", geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3) });
+		shapes.push_back({ "geosphere (5 subdivisions)", geoGen.CreateGeosphere(1.0f, 5) });
+		shapes.push_back({ "sphere 64x64", geoGen.CreateSphere(1.0f, 64, 64) });
+		shapes.push_back({ "cylinder 64x32", geoGen.CreateCylinder(1.0f, 1.0f, 3.0f, 64, 32) });
+		shapes.push_back({ "grid 128x128", geoGen.CreateGrid(10.0f, 10.0f, 128, 128) });
+
+		out << "Mesh optimizer (FIFO cache of " << VertexCacheSize << ")\n";
+		for (Shape& shape : shapes)
+		{
+			GeometryGenerator::MeshData& mesh = shape.Mesh;
+			std::vector<std::string> before = CanonicalTriangles(mesh);
+			std::size_t jumpsBefore = CountFetchJumps(mesh.Indices32, mesh.Vertices.size());
+
+			// The 16-bit path has to agree with the 32-bit one.
+			std::vector<GeometryGenerator::Vertex> welded(mesh.Vertices);
+			std::vector<std::uint32_t> cacheOnly(mesh.Indices32);
+			WeldVertices(welded, cacheOnly);
+			std::vector<std::uint16_t> indices16(cacheOnly.begin(), cacheOnly.end());
+			VertexCacheStats weldStats = AnalyzeVertexCache(cacheOnly, welded.size());
+			OptimizeVertexCache(indices16, welded.size());
+			OptimizeVertexCache(cacheOnly, welded.size());
+			bool widthsAgree = welded.size() > 65536 || std::equal(cacheOnly.begin(), cacheOnly.end(), indices16.begin());
+			VertexCacheStats cacheStats = AnalyzeVertexCache(cacheOnly, welded.size());
+
+			auto start = std::chrono::high_resolution_clock::now();
+			MeshOptimizeStats stats = OptimizeMesh(mesh);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			bool sameTriangles = CanonicalTriangles(mesh) == before;
+			std::size_t jumpsAfter = CountFetchJumps(mesh.Indices32, mesh.Vertices.size());
+
+			out << "  " << shape.Name << ": vertices " << stats.Before.Vertices << " -> " << stats.After.Vertices << "  triangles " << stats.Before.Triangles << "  " << ms << " ms\n";
+			out << "    ACMR " << stats.Before.GetAcmr() << " -> " << weldStats.GetAcmr() << " (weld) -> " << cacheStats.GetAcmr() <<
+				" (cache) -> " << stats.After.GetAcmr() <<
+				"  ATVR " << stats.Before.GetAtvr() << " -> " << stats.After.GetAtvr() << "\n";
+			out << "    fetch jumps " << jumpsBefore << " -> " << jumpsAfter << "  same triangles: " << (sameTriangles ? "yes" : "NO") <<
+				"  16/32-bit agree: " << (widthsAgree ? "yes" : "NO") << "\n";
+		}
+
+		// Chunk parts draw the shared quad pattern.  Quads share no vertices, so
+		// four transforms per two triangles is already all the reuse there is.
+		World world;
+		GenerateDefaultMap(world, 1, 100);
+		ChunkMesher mesher;
+		VertexCacheStats chunkBefore, chunkAfter;
+		std::size_t parts = 0, changedParts = 0;
+		world.ForEachChunk([&](const Chunk& chunk)
+		{
+			ChunkMesh mesh = mesher.Mesh(world, chunk.GetCoord());
+			for (const ChunkMeshPart& part : mesh.Parts)
+			{
+				std::vector<std::uint32_t> indices;
+				BuildQuadIndices(part.GetQuadCount(), indices);
+				VertexCacheStats before = AnalyzeVertexCache(indices, part.Vertices.size());
+				std::vector<std::uint32_t> remap;
+				std::vector<std::uint32_t> optimized(indices);
+				OptimizeVertexCache(optimized, part.Vertices.size());
+				OptimizeVertexFetch(optimized, part.Vertices.size(), remap);
+				VertexCacheStats after = AnalyzeVertexCache(optimized, part.Vertices.size());
+
+				chunkBefore.Triangles += before.Triangles;
+				chunkBefore.Vertices += before.Vertices;
+				chunkBefore.Transforms += before.Transforms;
+				chunkAfter.Triangles += after.Triangles;
+				chunkAfter.Vertices += after.Vertices;
+				chunkAfter.Transforms += after.Transforms;
+				parts++;
+				if (optimized != indices)
+					changedParts++;
+			}
+		});
+		out << "  chunk parts (100x100 map): parts " << parts << "  triangles " << chunkBefore.Triangles << "\n";
+		out << "    ACMR " << chunkBefore.GetAcmr() << " -> " << chunkAfter.GetAcmr() << "  ATVR " << chunkBefore.GetAtvr() << " -> " <<
+			chunkAfter.GetAtvr() << "  parts reordered: " << changedParts << "\n\n";
+	}
+	void BenchmarkBlockInstances(std::ostream& out)
+	{
+		// Calls a draw makes in DrawRenderItems: vertex and index buffers,
+		// topology, texture table, object and material constants, the draw.
+		const std::size_t callsPerItem = 7;
+		// The instanced path sets the cube's buffers and topology once, then a
+		// texture table, material constants, instance buffer and draw per batch.
+		const std::size_t callsOnce = 3, callsPerBatch = 4;
+		const std::size_t objectCBBytes = 256;
+		const std::size_t cubeTriangles = 12;
+
+		out << "Instanced blocks\n";
+		const int mapSizes[2] = { 100, 400 };
+		for (int mapSize : mapSizes)
+		{
+			World world;
+			GenerateDefaultMap(world, 1, mapSize);
+
+			BlockInstanceBuilder builder;
+			builder.Build(world);
+			const BlockInstanceStats& stats = builder.GetStats();
+			const std::vector<BlockInstance>& instances = builder.GetInstances();
+
+			// Every block with a visible face, checked one face at a time.
+			std::unordered_map<std::uint64_t, BlockId> expected;
+			world.ForEachChunk([&](const Chunk& chunk)
+			{
+				ChunkCoord c = chunk.GetCoord();
+				for (int y = 0; y < ChunkSize; y++)
+					for (int z = 0; z < ChunkSize; z++)
+						for (int x = 0; x < ChunkSize; x++)
+						{
+							int wx = c.X * ChunkSize + x, wy = c.Y * ChunkSize + y, wz = c.Z * ChunkSize + z;
+							BlockId block = world.GetBlock(wx, wy, wz);
+							if (block == BlockId::Air || GetChunkLayer(block) == ChunkLayer::Translucent)
+								continue;
+
+							const int offsets[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+							for (const auto& o : offsets)
+							{
+								if (ChunkMesher::IsFaceVisible(block, world.GetBlock(wx + o[0], wy + o[1], wz + o[2])))
+								{
+									expected[PackChunkCoord(ChunkCoord{ wx, wy, wz })] = block;
+									break;
+								}
+							}
+						}
+			});
+
+			std::size_t unexpected = 0, wrongBlock = 0;
+			for (const BlockInstance& instance : instances)
+			{
+				auto it = expected.find(PackChunkCoord(ChunkCoord{ instance.X, instance.Y, instance.Z }));
+				if (it == expected.end())
+					unexpected++;
+				else if ((std::uint32_t)it->second != instance.Block)
+					wrongBlock++;
+			}
+
+			std::size_t batchErrors = 0;
+			std::uint32_t next = 0;
+			for (const BlockInstanceBatch& batch : builder.GetBatches())
+			{
+				if (batch.StartInstance != next)
+					batchErrors++;
+				for (std::uint32_t i = batch.StartInstance; i < batch.StartInstance + batch.InstanceCount; i++)
+				{
+					if (instances[i].Block != (std::uint32_t)batch.Block)
+						batchErrors++;
+				}
+				next = batch.StartInstance + batch.InstanceCount;
+			}
+			if (next != instances.size())
+				batchErrors++;
+
+			// The chunk meshes draw a part per chunk and material.
+			ChunkMesher mesher;
+			std::size_t parts = 0, meshTriangles = 0;
+			world.ForEachChunk([&](const Chunk& chunk)
+			{
+				ChunkMesh mesh = mesher.Mesh(world, chunk.GetCoord());
+				for (const ChunkMeshPart& part : mesh.Parts)
+				{
+					if (part.Layer == ChunkLayer::Translucent)
+						continue;
+					parts++;
+					meshTriangles += part.GetQuadCount() * 2;
+				}
+			});
+
+			const std::size_t draws = builder.GetBatches().size();
+			out << "  " << mapSize << "x" << mapSize << " map: chunks " << stats.Chunks << "  instances " << stats.Instances <<
+				" (expected " << expected.size() << ")  build " << stats.BuildMs << " ms\n";
+			out << "    unexpected " << unexpected << "  wrong block " << wrongBlock <<
+				"  batch errors " << batchErrors << "\n";
+			out << "    item per block:  draws/frame " << stats.Instances << "  api calls " << stats.Instances * callsPerItem <<
+				"  object constant bytes " << stats.Instances * objectCBBytes << "\n";
+			out << "    chunk meshes:    draws/frame " << parts << "  api calls " << parts * callsPerItem <<
+				"  triangles " << meshTriangles << "\n";
+			out << "    instanced:       draws/frame " << draws << "  api calls " << callsOnce + draws * callsPerBatch <<
+				"  instance bytes " << stats.GetBytes() << " (copied per frame resource when blocks change)  triangles " <<
+				stats.Instances * cubeTriangles << "\n";
+		}
+		out << "\n";
+	}
+	void BenchmarkIndirectDraws(std::ostream& out)
+	{
+		// Synthetic frames: opaque and cutout passes sorted by material, then an
+		// ordered translucent pass.  ChunkIndex carries the input position so
+		// the order can be checked.
+		const int materials = 10;
+		struct DrawInput
+		{
+			IndirectCommand Command;
+			std::uint32_t Material;
+			bool Visible;
+		};
+		auto makeFrame = [&](std::size_t drawsPerPass)
+		{
+			std::mt19937 rng(7);
+			std::vector<std::vector<DrawInput>> frame(3);
+			for (int p = 0; p < 3; p++)
+			{
+				for (std::size_t i = 0; i < drawsPerPass; i++)
+				{
+					DrawInput input;
+					input.Command.ChunkIndex = (std::uint32_t)i;
+					input.Command.IndexCountPerInstance = (rng() % 20 == 0) ? 0 : 6 * (1 + rng() % 500);
+					input.Material = p == 2 ? (std::uint32_t)(rng() % 2) : (std::uint32_t)(rng() % materials);
+					input.Visible = rng() % 10 != 0;
+					frame[p].push_back(input);
+				}
+			}
+			return frame;
+		};
+		auto buildFrame = [](IndirectDrawBuilder& builder, const std::vector<std::vector<DrawInput>>& frame)
+		{
+			builder.Clear();
+			for (int p = 0; p < 3; p++)
+			{
+				builder.BeginPass();
+				for (const DrawInput& input : frame[p])
+					builder.Add(input.Command, input.Material, input.Visible);
+				builder.EndPass(p == 2);
+			}
+		};
+
+		IndirectDrawBuilder builder;
+		std::vector<std::vector<DrawInput>> frame = makeFrame(10000);
+		buildFrame(builder, frame);
+
+		// What should survive, as input position and material.
+		std::vector<std::vector<std::uint32_t>> kept(3);
+		for (int p = 0; p < 3; p++)
+		{
+			for (const DrawInput& input : frame[p])
+			{
+				if (input.Visible && input.Command.IndexCountPerInstance != 0)
+					kept[p].push_back(input.Command.ChunkIndex | (input.Material << 24));
+			}
+		}
+
+		const std::vector<IndirectCommand>& commands = builder.GetCommands();
+		const std::vector<IndirectGroup>& groups = builder.GetGroups();
+		std::size_t errors = 0;
+		std::uint32_t nextCommand = 0, nextGroup = 0;
+		for (int p = 0; p < 3; p++)
+		{
+			const IndirectPass& pass = builder.GetPasses()[p];
+			if (pass.FirstGroup != nextGroup)
+				errors++;
+			nextGroup = pass.FirstGroup + pass.GroupCount;
+
+			// Sorted passes keep the input order within each material.
+			std::vector<std::uint32_t> expected = kept[p];
+			if (p != 2)
+				std::stable_sort(expected.begin(), expected.end(), [](std::uint32_t a, std::uint32_t b) { return (a >> 24) < (b >> 24); });
+
+			std::vector<std::uint32_t> actual;
+			for (std::uint32_t g = pass.FirstGroup; g < pass.FirstGroup + pass.GroupCount; g++)
+			{
+				if (groups[g].FirstCommand != nextCommand || builder.GetCounts()[g] != groups[g].CommandCount)
+					errors++;
+				if (g > pass.FirstGroup && groups[g].Material == groups[g - 1].Material)
+					errors++;
+				for (std::uint32_t c = groups[g].FirstCommand; c < groups[g].FirstCommand + groups[g].CommandCount; c++)
+					actual.push_back(commands[c].ChunkIndex | (groups[g].Material << 24));
+				nextCommand = groups[g].FirstCommand + groups[g].CommandCount;
+			}
+			if (actual != expected)
+				errors++;
+		}
+		if (nextCommand != commands.size() || nextGroup != groups.size())
+			errors++;
+
+		out << "Indirect draws\n";
+		out << "  3 x 10000 draws: commands " << builder.GetStats().Commands << "  culled " << builder.GetStats().Culled <<
+			"  groups " << groups.size() << "  errors " << errors << "\n";
+
+		const std::size_t drawCounts[2] = { 10000, 100000 };
+		for (std::size_t draws : drawCounts)
+		{
+			const int repeats = 20;
+			std::vector<std::vector<DrawInput>> inputs = makeFrame(draws / 3);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repeats; r++)
+				buildFrame(builder, inputs);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / repeats;
+			out << "  " << draws << " draws: build " << ms << " ms (" << ms * 10000.0 / draws << " ms per 10k)  argument bytes " <<
+				builder.GetCommands().size() * sizeof(IndirectCommand) << "\n";
+		}
+
+		// The chunk passes of a map: each part is a draw, each pass and
+		// material an ExecuteIndirect.
+		const std::size_t callsPerItem = 7;
+		const std::size_t callsPerGroup = 3;
+		const int mapSizes[2] = { 100, 400 };
+		for (int mapSize : mapSizes)
+		{
+			World world;
+			GenerateDefaultMap(world, 1, mapSize);
+			ChunkMesher mesher;
+			std::vector<std::pair<ChunkLayer, BlockId>> parts;
+			world.ForEachChunk([&](const Chunk& chunk)
+			{
+				ChunkMesh mesh = mesher.Mesh(world, chunk.GetCoord());
+				for (const ChunkMeshPart& part : mesh.Parts)
+					parts.emplace_back(part.Layer, part.Block);
+			});
+
+			builder.Clear();
+			for (int layer = 0; layer < (int)ChunkLayer::Count; layer++)
+			{
+				builder.BeginPass();
+				for (const auto& part : parts)
+				{
+					if ((int)part.first != layer)
+						continue;
+					IndirectCommand command;
+					command.IndexCountPerInstance = 6;
+					builder.Add(command, (std::uint32_t)part.second);
+				}
+				builder.EndPass(layer == (int)ChunkLayer::Translucent);
+			}
+
+			const std::size_t draws = builder.GetStats().Commands;
+			const std::size_t calls = builder.GetStats().Groups * callsPerGroup;
+			out << "  " << mapSize << "x" << mapSize << " map: draws " << draws << "  direct api calls " << draws * callsPerItem <<
+				"  ExecuteIndirect calls " << builder.GetStats().Groups << "  indirect api calls " << calls <<
+				"  argument bytes " << draws * sizeof(IndirectCommand) << "\n";
+		}
+		out << "\n";
+	}
+
+	// Stands in for a D3D12 command list: keeps the draws it was given and
+	// spends a little time on each, like the calls DrawRenderItem makes.
+	class MockCommandList : public RecordingList
+	{
+	public:
+		void Reset() override { Draws.clear(); Resets++; Open = true; }
+		void Close() override { Closes++; Open = false; }
+
+		void Draw(std::size_t draw, int work)
+		{
+			unsigned int x = (unsigned int)draw;
+			for (int i = 0; i < work; i++)
+				x = x * 1664525u + 1013904223u;
+			Draws.push_back(draw);
+			Hash += x;
+		}
+
+		std::vector<std::size_t> Draws;
+		int Resets = 0;
+		int Closes = 0;
+		bool Open = false;
+		unsigned int Hash = 0;
+	};
+
+	void BenchmarkParallelRecording(std::ostream& out)
+	{
+		const int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		out << "Parallel command list recording (" << hardwareThreads << " hardware threads)\n";
+
+		int made = 0;
+		auto makePool = [&]()
+		{
+			return RecordingListPool([&]() { made++; return std::unique_ptr<RecordingList>(new MockCommandList()); });
+		};
+		auto record = [](int work)
+		{
+			return [work](RecordingList& list, const DrawRange& range)
+			{
+				MockCommandList& mock = static_cast<MockCommandList&>(list);
+				for (std::size_t i = range.Begin; i < range.End; i++)
+					mock.Draw(i, work);
+			};
+		};
+
+		// Every draw is in exactly one list, and submitting the lists in order
+		// gives back the draw order.  Two frames check the lists are reused.
+		std::size_t errors = 0;
+		const std::size_t drawCounts[5] = { 0, 1, 63, 1000, 20000 };
+		for (int threads = 1; threads <= 8; threads *= 2)
+		{
+			ParallelRecorder recorder(threads);
+			made = 0;
+			RecordingListPool pool = makePool();
+			for (std::size_t draws : drawCounts)
+			{
+				for (int frame = 0; frame < 2; frame++)
+				{
+					std::size_t lists = recorder.Record(draws, 64, pool, record(0));
+					if (lists > (std::size_t)threads || (draws >= 64 && lists != std::min<std::size_t>(threads, draws / 64)))
+						errors++;
+
+					std::size_t next = 0;
+					RecordingList* const* pooled = pool.Acquire(lists);
+					for (std::size_t l = 0; l < lists; l++)
+					{
+						const MockCommandList& mock = static_cast<const MockCommandList&>(*pooled[l]);
+						if (mock.Open || mock.Resets != mock.Closes || mock.Draws.empty())
+							errors++;
+						for (std::size_t d : mock.Draws)
+						{
+							if (d != next++)
+								errors++;
+						}
+					}
+					if (next != draws)
+						errors++;
+				}
+			}
+			if ((std::size_t)made != pool.GetSize() || pool.GetSize() > (std::size_t)threads)
+				errors++;
+		}
+
+		// A failure on a worker reaches the caller, and the recorder still works after.
+		{
+			ParallelRecorder recorder(4);
+			RecordingListPool pool = makePool();
+			bool thrown = false;
+			try
+			{
+				recorder.Record(1000, 64, pool, [](RecordingList&, const DrawRange& range)
+				{
+					if (range.Begin != 0)
+						throw std::runtime_error("record failed");
+				});
+			}
+			catch (const std::runtime_error&)
+			{
+				thrown = true;
+			}
+			if (!thrown || recorder.Record(1000, 64, pool, record(0)) != 4)
+				errors++;
+		}
+		out << "  order, reuse and error checks: errors " << errors << "\n";
+
+		// Recording time against thread count.  Each mock draw costs about
+		// what DrawRenderItem's seven calls into the runtime do.
+		const int work = 400;
+		const std::size_t scalingDraws[2] = { 2142, 20000 };
+		for (std::size_t draws : scalingDraws)
+		{
+			double oneThreadMs = 0.0;
+			for (int threads = 1; threads <= std::max(4, hardwareThreads); threads *= 2)
+			{
+				ParallelRecorder recorder(threads);
+				RecordingListPool pool = makePool();
+				recorder.Record(draws, 64, pool, record(work));
+
+				const int frames = 20;
+				auto start = Clock::now();
+				std::size_t lists = 0;
+				for (int f = 0; f < frames; f++)
+					lists = recorder.Record(draws, 64, pool, record(work));
+				double ms = ElapsedMs(start) / frames;
+				if (threads == 1)
+					oneThreadMs = ms;
+
+				unsigned int hash = 0;
+				for (std::size_t l = 0; l < lists; l++)
+					hash += static_cast<MockCommandList*>(pool.Acquire(lists)[l])->Hash;
+				gSink += hash;
+
+				out << "  " << draws << " draws, " << threads << " threads: lists " << lists << "  ms/frame " << ms <<
+					"  speedup " << oneThreadMs / ms << "\n";
+			}
+		}
+		out << "\n";
+	}
+
+	void BenchmarkDrawQueue(std::ostream& out)
+	{
+		// Synthetic chunk draws: each chunk has its own vertex buffer and
+		// object constants and a part per material, all sharing one index
+		// buffer.  Opaque and cutout passes are keyed by material and depth,
+		// the translucent pass by its back-to-front position.
+		struct Draw
+		{
+			std::uint32_t Pass;
+			std::uint32_t Material;
+			std::uint32_t Chunk;
+			float Distance;
+		};
+		const int materials = 10;
+		const float farZ = 1000.0f;
+		auto makeDraws = [&](std::size_t count)
+		{
+			std::mt19937 rng(11);
+			std::vector<Draw> draws;
+			std::uint32_t chunk = 0;
+			while (draws.size() < count)
+			{
+				float distance = (float)(rng() % 100000) / 100.0f;
+				for (int m = 0; m < materials && draws.size() < count; m++)
+				{
+					if (rng() % 3 != 0)
+						continue;
+					Draw draw;
+					draw.Material = (std::uint32_t)m;
+					draw.Pass = m == materials - 1 ? 2 : (m == materials - 2 ? 1 : 0);
+					draw.Chunk = chunk;
+					draw.Distance = distance;
+					draws.push_back(draw);
+				}
+				chunk++;
+			}
+			return draws;
+		};
+		auto keyFor = [&](const Draw& draw, std::uint32_t index)
+		{
+			if (draw.Pass == 2)
+				return MakeOrderedSortKey(draw.Pass, index);
+			return MakeSortKey(draw.Pass, draw.Pass, draw.Material, GetDepthBucket(draw.Distance, farZ), draw.Chunk);
+		};
+		auto stateFor = [](const Draw& draw)
+		{
+			DrawState state;
+			state.Bindings[(int)DrawBinding::Pso] = draw.Pass + 1;
+			state.Bindings[(int)DrawBinding::VertexBuffer] = 0x10000 + draw.Chunk;
+			state.Bindings[(int)DrawBinding::IndexBuffer] = draw.Pass == 2 ? 2 : 1;
+			state.Bindings[(int)DrawBinding::Topology] = 4;
+			state.Bindings[(int)DrawBinding::Texture] = 0x100 + draw.Material;
+			state.Bindings[(int)DrawBinding::MaterialCB] = 0x200 + draw.Material;
+			state.Bindings[(int)DrawBinding::ObjectCB] = 0x20000 + draw.Chunk;
+			return state;
+		};
+
+		out << "Draw queue\n";
+
+		// The radix sort against std::stable_sort, and the key helpers.
+		std::size_t errors = 0;
+		{
+			std::vector<Draw> draws = makeDraws(20000);
+			DrawQueue queue;
+			std::vector<DrawQueueEntry> expected;
+			for (std::uint32_t i = 0; i < draws.size(); i++)
+			{
+				queue.Push(keyFor(draws[i], i), i);
+				expected.push_back(queue.GetEntries().back());
+			}
+			queue.Sort();
+			std::stable_sort(expected.begin(), expected.end(), [](const DrawQueueEntry& a, const DrawQueueEntry& b) { return a.Key < b.Key; });
+			for (std::size_t i = 0; i < expected.size(); i++)
+			{
+				if (queue.GetEntries()[i].Key != expected[i].Key || queue.GetEntries()[i].Item != expected[i].Item)
+					errors++;
+			}
+
+			// Translucent draws keep their order and come last.
+			std::uint32_t lastTranslucent = 0;
+			for (const DrawQueueEntry& entry : queue.GetEntries())
+			{
+				if (GetSortKeyPass(entry.Key) != draws[entry.Item].Pass)
+					errors++;
+				if (draws[entry.Item].Pass == 2)
+				{
+					if (entry.Item < lastTranslucent)
+						errors++;
+					lastTranslucent = entry.Item;
+				}
+			}
+
+			if (MakeSortKey(99, 999, 99999, 99999, 0xFFFFFFFF) != ~0ull || GetDepthBucket(-1.0f, farZ) != 0 ||
+				GetDepthBucket(2.0f * farZ, farZ) != (1u << SortKeyDepthBits) - 1 ||
+				GetDepthBucket(1.0f, farZ) >= GetDepthBucket(2.0f, farZ))
+				errors++;
+		}
+		out << "  radix sort vs stable_sort, key fields: errors " << errors << "\n";
+
+		// Sort and submit time for 100k draws.  Submitting here is the state
+		// cache alone, which is what decides the calls a command list gets.
+		const std::size_t count = 100000;
+		const int repeats = 20;
+		std::vector<Draw> draws = makeDraws(count);
+		DrawQueue queue;
+		DrawStateCache cache;
+
+		auto start = Clock::now();
+		for (int r = 0; r < repeats; r++)
+		{
+			queue.Clear();
+			for (std::uint32_t i = 0; i < draws.size(); i++)
+				queue.Push(keyFor(draws[i], i), i);
+		}
+		double keyMs = ElapsedMs(start) / repeats;
+
+		start = Clock::now();
+		for (int r = 0; r < repeats; r++)
+		{
+			queue.Clear();
+			for (std::uint32_t i = 0; i < draws.size(); i++)
+				queue.Push(keyFor(draws[i], i), i);
+			queue.Sort();
+		}
+		double sortMs = ElapsedMs(start) / repeats - keyMs;
+
+		start = Clock::now();
+		unsigned int mask = 0;
+		for (int r = 0; r < repeats; r++)
+		{
+			cache.Reset();
+			cache.ResetStats();
+			for (const DrawQueueEntry& entry : queue.GetEntries())
+				mask ^= cache.Apply(stateFor(draws[entry.Item]));
+		}
+		double submitMs = ElapsedMs(start) / repeats;
+		gSink += mask;
+		DrawStateStats sorted = cache.GetStats();
+
+		// The same draws in queue order, the way DrawRenderItems walks the layers.
+		cache.Reset();
+		cache.ResetStats();
+		for (const Draw& draw : draws)
+			cache.Apply(stateFor(draw));
+		DrawStateStats unsorted = cache.GetStats();
+
+		const std::size_t callsPerDraw = (std::size_t)DrawBinding::Count;
+		out << "  " << count << " draws: keys " << keyMs << " ms  sort " << sortMs << " ms (" << queue.GetSortPasses() <<
+			" digit passes)  submit " << submitMs << " ms\n";
+		out << "  bindings: every draw " << count * callsPerDraw << "  queue order " << unsorted.GetSetTotal() <<
+			"  sorted " << sorted.GetSetTotal() << "  skipped " << sorted.GetSkippedTotal() << "\n";
+
+		const char* names[(int)DrawBinding::Count] = { "pso", "vb", "ib", "topology", "texture", "material", "object" };
+		out << "  sorted set/skipped:";
+		for (int b = 0; b < (int)DrawBinding::Count; b++)
+			out << " " << names[b] << " " << sorted.Set[b] << "/" << sorted.Skipped[b];
+		out << "\n\n";
+	}
+}
+
+void RunBenchmarks(std::ostream& out)
+{
+	BenchmarkWorldGeneration(out);
+	BenchmarkChunkStorage(out);
+	BenchmarkBlockLookup(out);
+	BenchmarkColdTier(out);
+	BenchmarkSurfaceQueries(out);
+	BenchmarkConcurrentMap(out);
+	BenchmarkRegionFiles(out);
+	BenchmarkEditJournal(out);
+	BenchmarkAutosave(out);
+	BenchmarkFaceCulling(out);
+	BenchmarkMeshing(out);
+	BenchmarkVertexFormat(out);
+	BenchmarkAmbientOcclusion(out);
+	BenchmarkMeshWorkers(out);
+	BenchmarkRemeshing(out);
+	BenchmarkChunkLod(out);
+	BenchmarkTranslucentSort(out);
+	BenchmarkQuadIndices(out);
+	BenchmarkVoxelFaces(out);
+	BenchmarkMeshOptimizer(out);
+	BenchmarkBlockInstances(out);
+	BenchmarkIndirectDraws(out);
+	BenchmarkParallelRecording(out);
+	BenchmarkDrawQueue(out);
+	BenchmarkOctree(out, 100);
+	BenchmarkOctree(out, 400);
+}
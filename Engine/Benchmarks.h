@@ -0,0 +1,8 @@
+#pragma once
+
+#include <ostream>
+
+// Headless benchmarks for the voxel world code.  These run without creating a
+// window or a D3D device; start the app with "-bench" on the command line to
+// run them and write the results to benchmarks.txt.
+void RunBenchmarks(std::ostream& out);
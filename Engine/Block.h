@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+
+// Compact identifier for a single voxel.  The world stores one of these per
+// block instead of a RenderItem, so it must stay a single byte.
+enum class BlockId : std::uint8_t
+{
+	Air = 0,
+	Dirt,
+	Bedrock,
+	Stone,
+	Grass,
+	Wood,
+	Leaves,
+	Iron,
+	Gravel,
+	Sand,
+	Water,
+	Count
+};
+
+// Number of distinct block types, including air.
+const int gNumBlockTypes = (int)BlockId::Count;
+
+// Per-type properties used by meshing, culling and lighting.
+enum BlockFlags : std::uint8_t
+{
+	BlockFlag_None = 0,
+	// Fully covers its cell; hides the faces of neighbours behind it.
+	BlockFlag_Opaque = 1 << 0,
+	// Drawn with alpha testing (e.g. leaves); doesn't hide neighbours.
+	BlockFlag_Cutout = 1 << 1,
+	// Drawn blended after opaque geometry.
+	BlockFlag_Translucent = 1 << 2,
+	BlockFlag_Fluid = 1 << 3,
+	BlockFlag_Gravity = 1 << 4,
+	BlockFlag_EmitsLight = 1 << 5,
+};
+
+struct BlockInfo
+{
+	// Key of the block's material in CrateApp::mMaterials.
+	const char* Name;
+	std::uint8_t Flags;
+	// Index into the material constant buffer, -1 for air.
+	int MatCBIndex;
+	// Index into the SRV heap for the diffuse texture, -1 for air.
+	int DiffuseSrvHeapIndex;
+};
+
+// Indexed by BlockId.  Material and texture indices match CrateApp::BuildMaterials
+// and CrateApp::BuildDescriptorHeaps.
+constexpr BlockInfo gBlockInfo[] =
+{
+	{ "air",     BlockFlag_None,                                -1, -1 },
+	{ "dirt",    BlockFlag_Opaque,                               0,  0 },
+	{ "bedrock", BlockFlag_Opaque,                               1,  1 },
+	{ "stone",   BlockFlag_Opaque,                               2,  2 },
+	{ "grass",   BlockFlag_Opaque,                               3,  3 },
+	{ "wood",    BlockFlag_Opaque,                               4,  4 },
+	{ "leaves",  BlockFlag_Cutout,                               5,  5 },
+	{ "iron",    BlockFlag_Opaque,                               6,  6 },
+	{ "gravel",  BlockFlag_Opaque | BlockFlag_Gravity,           7,  7 },
+	{ "sand",    BlockFlag_Opaque | BlockFlag_Gravity,           8,  8 },
+	{ "water",   BlockFlag_Translucent | BlockFlag_Fluid,        9,  9 },
+};
+
+constexpr const BlockInfo& GetBlockInfo(BlockId id)
+{
+	return gBlockInfo[(int)id];
+}
+
+constexpr bool HasBlockFlag(BlockId id, std::uint8_t flag)
+{
+	return (gBlockInfo[(int)id].Flags & flag) != 0;
+}
+
+namespace BlockRegistryChecks
+{
+	// Every solid type uses exactly one render path, fluids are translucent and
+	// material/texture slots are unique.  Air has no properties at all.
+	constexpr bool IsValid()
+	{
+		if (gBlockInfo[0].Flags != BlockFlag_None || gBlockInfo[0].MatCBIndex != -1)
+			return false;
+
+		for (int i = 1; i < gNumBlockTypes; i++)
+		{
+			std::uint8_t paths = gBlockInfo[i].Flags & (BlockFlag_Opaque | BlockFlag_Cutout | BlockFlag_Translucent);
+			if (paths != BlockFlag_Opaque && paths != BlockFlag_Cutout && paths != BlockFlag_Translucent)
+				return false;
+
+			if ((gBlockInfo[i].Flags & BlockFlag_Fluid) && !(gBlockInfo[i].Flags & BlockFlag_Translucent))
+				return false;
+
+			if (gBlockInfo[i].MatCBIndex < 0 || gBlockInfo[i].DiffuseSrvHeapIndex < 0)
+				return false;
+
+			for (int j = 1; j < i; j++)
+			{
+				if (gBlockInfo[i].MatCBIndex == gBlockInfo[j].MatCBIndex)
+					return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+static_assert(sizeof(gBlockInfo) / sizeof(gBlockInfo[0]) == gNumBlockTypes, "gBlockInfo must have one entry per BlockId");
+static_assert(sizeof(BlockId) == 1, "BlockId must stay one byte");
+static_assert(BlockRegistryChecks::IsValid(), "gBlockInfo has an inconsistent entry");
+static_assert(HasBlockFlag(BlockId::Water, BlockFlag_Fluid), "water must be a fluid");
+static_assert(!HasBlockFlag(BlockId::Air, BlockFlag_Opaque), "air must not occlude");
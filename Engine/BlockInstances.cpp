@@ -0,0 +1,70 @@
+#include "BlockInstances.h"
+#include <chrono>
+
+void BlockInstanceBuilder::Build(const World& world)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (auto& instances : mByBlock)
+		instances.clear();
+
+	mStats.Chunks = 0;
+	world.ForEachChunk([&](const Chunk& chunk)
+	{
+		AddChunk(world, chunk.GetCoord());
+		mStats.Chunks++;
+	});
+
+	mInstances.clear();
+	mBatches.clear();
+	for (int i = 1; i < gNumBlockTypes; i++)
+	{
+		if (mByBlock[i].empty())
+			continue;
+
+		BlockInstanceBatch batch;
+		batch.Block = (BlockId)i;
+		batch.StartInstance = (std::uint32_t)mInstances.size();
+		batch.InstanceCount = (std::uint32_t)mByBlock[i].size();
+		mBatches.push_back(batch);
+		mInstances.insert(mInstances.end(), mByBlock[i].begin(), mByBlock[i].end());
+	}
+
+	mStats.Instances = mInstances.size();
+	mStats.BuildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void BlockInstanceBuilder::AddChunk(const World& world, const ChunkCoord& coord)
+{
+	ChunkMesher::GatherBlocks(world, coord, mPadded.data());
+	CullHiddenFaces(mPadded.data(), mMasks);
+
+	const int x0 = coord.X * ChunkSize, y0 = coord.Y * ChunkSize, z0 = coord.Z * ChunkSize;
+	for (int y = 0; y < ChunkSize; y++)
+	{
+		for (int z = 0; z < ChunkSize; z++)
+		{
+			// Blocks along the row with any face showing.
+			std::uint32_t row = 0;
+			for (int face = 0; face < gNumFaceDirections; face++)
+				row |= mMasks.Rows[face][(y << ChunkShift) | z];
+
+			for (int x = 0; x < ChunkSize; x++)
+			{
+				if (((row >> x) & 1) == 0)
+					continue;
+
+				BlockId block = mPadded[ChunkMesher::PaddedIndex(x, y, z)];
+				if (GetChunkLayer(block) == ChunkLayer::Translucent)
+					continue;
+
+				BlockInstance instance;
+				instance.X = x0 + x;
+				instance.Y = y0 + y;
+				instance.Z = z0 + z;
+				instance.Block = (std::uint32_t)block;
+				mByBlock[(int)block].push_back(instance);
+			}
+		}
+	}
+}
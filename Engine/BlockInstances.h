@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ChunkMesher.h"
+#include "FaceCulling.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One block of the instanced path, read by BlockVS in Default.hlsl from a
+// StructuredBuffer indexed by SV_InstanceID.  Keep the two in step.
+struct BlockInstance
+{
+	// World position of the block's low corner.
+	std::int32_t X = 0;
+	std::int32_t Y = 0;
+	std::int32_t Z = 0;
+	// BlockId, which picks the material.
+	std::uint32_t Block = 0;
+};
+
+static_assert(sizeof(BlockInstance) == 16, "BlockInstance must match the structured buffer stride in Default.hlsl");
+
+// The instances of one block type, drawn with one DrawIndexedInstanced.
+struct BlockInstanceBatch
+{
+	BlockId Block = BlockId::Air;
+	std::uint32_t StartInstance = 0;
+	std::uint32_t InstanceCount = 0;
+};
+
+struct BlockInstanceStats
+{
+	std::size_t Chunks = 0;
+	std::size_t Instances = 0;
+	double BuildMs = 0.0;
+
+	std::size_t GetBytes()const { return Instances * sizeof(BlockInstance); }
+};
+
+// Builds the instance buffer for drawing blocks as whole unit cubes, one
+// instanced draw per block type rather than a draw per block.
+//
+// Only blocks with a visible face (see CullHiddenFaces) get an instance.
+// Translucent blocks are left out: they have to be blended back to front,
+// which the sorted chunk meshes already do.
+class BlockInstanceBuilder
+{
+public:
+	void Build(const World& world);
+
+	// Instances grouped by block type, in BlockId order.
+	const std::vector<BlockInstance>& GetInstances()const { return mInstances; }
+	// One batch for each block type that has instances.
+	const std::vector<BlockInstanceBatch>& GetBatches()const { return mBatches; }
+	const BlockInstanceStats& GetStats()const { return mStats; }
+
+private:
+	void AddChunk(const World& world, const ChunkCoord& coord);
+
+private:
+	std::vector<BlockInstance> mInstances;
+	std::vector<BlockInstanceBatch> mBatches;
+	BlockInstanceStats mStats;
+
+	// Instances of each block type while a build gathers them.
+	std::vector<BlockInstance> mByBlock[gNumBlockTypes];
+	std::vector<BlockId> mPadded = std::vector<BlockId>(MeshPadVolume);
+	ChunkFaceMasks mMasks;
+};
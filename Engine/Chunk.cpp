@@ -0,0 +1,202 @@
+#include "Chunk.h"
+#include <algorithm>
+#include <chrono>
+
+ColdTierCounters Chunk::sColdTierCounters;
+CopyOnWriteCounters Chunk::sCopyOnWriteCounters;
+
+namespace
+{
+	std::uint64_t ElapsedNanoseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		auto elapsed = std::chrono::high_resolution_clock::now() - start;
+		return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	}
+}
+
+Chunk::Chunk(const ChunkCoord& coord)
+	: mCoord(coord), mBlocks(std::make_shared<PalettedStorage>(ChunkVolume, BlockId::Air))
+{
+}
+
+void Chunk::SetBlock(int x, int y, int z, BlockId id)
+{
+	if (mCold != nullptr)
+		Thaw();
+
+	MakeBlocksUnique();
+	BlockId old = mBlocks->Set(Index(x, y, z), id);
+	if (old == id)
+		return;
+
+	mDirty = true;
+	mEditGeneration++;
+	if (old == BlockId::Air)
+		mSolidCount++;
+	else if (id == BlockId::Air)
+		mSolidCount--;
+
+	UpdateHeightmaps(x, y, z, id);
+}
+
+void Chunk::CopyBlocks(BlockId* dest)const
+{
+	if (mCold != nullptr)
+		mCold->Decode(dest);
+	else
+		mBlocks->CopyTo(dest);
+}
+
+void Chunk::AssignBlocks(const BlockId* src)
+{
+	// No need to copy storage that is about to be overwritten.
+	mCold.reset();
+	if (mBlocks == nullptr || mBlocks.use_count() > 1)
+		mBlocks = std::make_shared<PalettedStorage>(ChunkVolume);
+	mBlocks->Assign(src);
+	mSolidCount = ChunkVolume - mBlocks->GetCount(BlockId::Air);
+	mDirty = true;
+	mEditGeneration++;
+	RebuildHeightmaps(src);
+}
+
+void Chunk::Freeze()
+{
+	if (mCold != nullptr)
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	BlockId blocks[ChunkVolume];
+	mBlocks->CopyTo(blocks);
+	auto cold = std::make_shared<RleColumns>();
+	cold->Encode(blocks);
+	mCold = cold;
+
+	// The cold tier is the only copy now; snapshots keep their own reference.
+	mBlocks.reset();
+
+	sColdTierCounters.Freezes++;
+	sColdTierCounters.FreezeNanoseconds += ElapsedNanoseconds(start);
+}
+
+void Chunk::Thaw()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	BlockId blocks[ChunkVolume];
+	mCold->Decode(blocks);
+	auto storage = std::make_shared<PalettedStorage>(ChunkVolume);
+	storage->Assign(blocks);
+	mBlocks = storage;
+	mCold.reset();
+
+	std::uint64_t ns = ElapsedNanoseconds(start);
+	sColdTierCounters.Thaws++;
+	sColdTierCounters.ThawNanoseconds += ns;
+
+	std::uint64_t prevMax = sColdTierCounters.MaxThawNanoseconds;
+	while (ns > prevMax && !sColdTierCounters.MaxThawNanoseconds.compare_exchange_weak(prevMax, ns))
+	{
+	}
+}
+
+ChunkSnapshot Chunk::Snapshot()const
+{
+	ChunkSnapshot snapshot(mCoord);
+	snapshot.mBlocks = mBlocks;
+	snapshot.mCold = mCold;
+	snapshot.mEditGeneration = mEditGeneration;
+	return snapshot;
+}
+
+void Chunk::MakeBlocksUnique()
+{
+	// Only the owning thread adds references, so a count of one can't go up
+	// behind our back.  A snapshot dropped concurrently just costs a copy.
+	if (mBlocks.use_count() == 1)
+		return;
+
+	mBlocks = std::make_shared<PalettedStorage>(*mBlocks);
+	sCopyOnWriteCounters.Copies++;
+	sCopyOnWriteCounters.CopiedBytes += mBlocks->GetMemoryUsage();
+}
+
+void Chunk::UpdateHeightmaps(int x, int y, int z, BlockId id)
+{
+	for (int t = 0; t < gNumHeightmapTypes; t++)
+	{
+		HeightmapType type = (HeightmapType)t;
+		std::uint8_t& height = mHeightmaps[t][(z << ChunkShift) | x];
+
+		if (MatchesHeightmap(type, id))
+		{
+			if (y >= height)
+				height = (std::uint8_t)(y + 1);
+		}
+		else if (y == height - 1)
+		{
+			// The top block went away; walk down to the next one.  This is
+			// bounded by the chunk height and only happens on removals.
+			int below = y - 1;
+			while (below >= 0 && !MatchesHeightmap(type, mBlocks->Get(Index(x, below, z))))
+				below--;
+			height = (std::uint8_t)(below + 1);
+		}
+	}
+}
+
+void Chunk::RebuildHeightmaps(const BlockId* blocks)
+{
+	for (int t = 0; t < gNumHeightmapTypes; t++)
+	{
+		HeightmapType type = (HeightmapType)t;
+		for (int z = 0; z < ChunkSize; z++)
+		{
+			for (int x = 0; x < ChunkSize; x++)
+			{
+				int y = ChunkSize - 1;
+				while (y >= 0 && !MatchesHeightmap(type, blocks[Index(x, y, z)]))
+					y--;
+				mHeightmaps[t][(z << ChunkShift) | x] = (std::uint8_t)(y + 1);
+			}
+		}
+	}
+}
+
+std::size_t Chunk::GetMemoryUsage()const
+{
+	std::size_t bytes = sizeof(Chunk);
+	if (mBlocks != nullptr)
+		bytes += mBlocks->GetMemoryUsage();
+	if (mCold != nullptr)
+		bytes += mCold->GetMemoryUsage();
+
+	return bytes;
+}
+
+void ChunkSnapshot::CopyBlocks(BlockId* dest)const
+{
+	if (mCold != nullptr)
+		mCold->Decode(dest);
+	else if (mBlocks != nullptr)
+		mBlocks->CopyTo(dest);
+	else
+		std::fill(dest, dest + ChunkVolume, BlockId::Air);
+}
+
+BlockId ChunkSnapshot::GetBlock(int x, int y, int z)const
+{
+	return mBlocks != nullptr ? mBlocks->Get(Chunk::Index(x, y, z)) : BlockId::Air;
+}
+
+std::size_t ChunkSnapshot::GetMemoryUsage()const
+{
+	std::size_t bytes = sizeof(ChunkSnapshot);
+	if (mBlocks != nullptr)
+		bytes += mBlocks->GetMemoryUsage();
+	if (mCold != nullptr)
+		bytes += mCold->GetMemoryUsage();
+
+	return bytes;
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "Block.h"
+#include "PalettedStorage.h"
+#include "RleColumns.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Chunks are cubes of ChunkSize blocks along each axis.
+const int ChunkShift = 4;
+const int ChunkSize = 1 << ChunkShift;
+const int ChunkMask = ChunkSize - 1;
+const int ChunkVolume = ChunkSize * ChunkSize * ChunkSize;
+
+// Integer position of a chunk in chunk units (world position >> ChunkShift).
+struct ChunkCoord
+{
+	int X = 0;
+	int Y = 0;
+	int Z = 0;
+};
+
+inline bool operator==(const ChunkCoord& a, const ChunkCoord& b)
+{
+	return a.X == b.X && a.Y == b.Y && a.Z == b.Z;
+}
+
+// Packs a chunk coordinate into 64 bits (21 bits per axis, two's complement).
+inline std::uint64_t PackChunkCoord(const ChunkCoord& c)
+{
+	const std::uint64_t mask = (1ull << 21) - 1;
+	return ((std::uint64_t)(c.X & mask) << 42) | ((std::uint64_t)(c.Y & mask) << 21) | (std::uint64_t)(c.Z & mask);
+}
+
+inline ChunkCoord UnpackChunkCoord(std::uint64_t key)
+{
+	// Shift each field to the top of a 64-bit word and back to sign extend it.
+	ChunkCoord c;
+	c.X = (int)((std::int64_t)(key << 1) >> 43);
+	c.Y = (int)((std::int64_t)(key << 22) >> 43);
+	c.Z = (int)((std::int64_t)(key << 43) >> 43);
+	return c;
+}
+
+// Per-column surfaces tracked by every chunk and by the World.
+enum class HeightmapType : int
+{
+	// Any block that isn't air.
+	Solid = 0,
+	// Blocks with BlockFlag_Opaque, i.e. what blocks the sun.
+	Opaque,
+	// Solid blocks other than fluids, i.e. what something can stand on.
+	NonFluid,
+	Count
+};
+
+const int gNumHeightmapTypes = (int)HeightmapType::Count;
+
+constexpr bool MatchesHeightmap(HeightmapType type, BlockId id)
+{
+	return type == HeightmapType::Solid ? id != BlockId::Air :
+		type == HeightmapType::Opaque ? HasBlockFlag(id, BlockFlag_Opaque) :
+		id != BlockId::Air && !HasBlockFlag(id, BlockFlag_Fluid);
+}
+
+// Process-wide counters for moving chunks between the hot (paletted) and
+// cold (run-length encoded) tiers.
+struct ColdTierCounters
+{
+	std::atomic<std::uint64_t> Freezes{ 0 };
+	std::atomic<std::uint64_t> Thaws{ 0 };
+	std::atomic<std::uint64_t> FreezeNanoseconds{ 0 };
+	std::atomic<std::uint64_t> ThawNanoseconds{ 0 };
+	// Longest single thaw, i.e. the worst access-latency spike.
+	std::atomic<std::uint64_t> MaxThawNanoseconds{ 0 };
+};
+
+// Counters for chunk storage copied because a snapshot still shared it.
+struct CopyOnWriteCounters
+{
+	std::atomic<std::uint64_t> Copies{ 0 };
+	std::atomic<std::uint64_t> CopiedBytes{ 0 };
+};
+
+// Read-only view of a chunk's blocks as they were when Chunk::Snapshot() was
+// called.  It shares storage with the chunk, which copies the storage before
+// its next edit, so taking one is cheap and it can be read on another thread.
+class ChunkSnapshot
+{
+public:
+	ChunkSnapshot() = default;
+	// A snapshot of a chunk that doesn't exist: all air.
+	explicit ChunkSnapshot(const ChunkCoord& coord) : mCoord(coord) {}
+
+	const ChunkCoord& GetCoord()const { return mCoord; }
+	void CopyBlocks(BlockId* dest)const;
+	// Single blocks can only be read from a hot snapshot; a cold one has to
+	// be decoded with CopyBlocks.
+	BlockId GetBlock(int x, int y, int z)const;
+	bool IsCold()const { return mCold != nullptr; }
+	// Bytes kept alive by this snapshot, whether or not the chunk still shares them.
+	std::size_t GetMemoryUsage()const;
+	// The chunk's edit generation when the snapshot was taken.
+	std::uint32_t GetEditGeneration()const { return mEditGeneration; }
+
+private:
+	friend class Chunk;
+
+	ChunkCoord mCoord;
+	std::uint32_t mEditGeneration = 0;
+	std::shared_ptr<const PalettedStorage> mBlocks;
+	std::shared_ptr<const RleColumns> mCold;
+};
+
+// Fixed-size cube of blocks.  Block indices are laid out x-fastest, then z,
+// then y so a horizontal slice is contiguous; the ids themselves are kept in
+// palette-compressed storage.  A chunk that hasn't been used for a while can
+// be frozen into RleColumns; reads decode from there and the first write
+// thaws it again.
+//
+// Storage is reference counted so snapshots can share it; it is only ever
+// modified in place while the chunk is its sole owner.
+//
+// Each chunk also keeps a heightmap per HeightmapType that SetBlock maintains,
+// so surface queries never scan the column.  Heightmaps stay hot when the
+// chunk is frozen.
+class Chunk
+{
+public:
+	explicit Chunk(const ChunkCoord& coord);
+	Chunk(const Chunk& rhs) = delete;
+	Chunk& operator=(const Chunk& rhs) = delete;
+
+	const ChunkCoord& GetCoord()const { return mCoord; }
+
+	// Local coordinates are in [0, ChunkSize).  A frozen chunk is read straight
+	// from the cold tier, so reads never modify the chunk.
+	BlockId GetBlock(int x, int y, int z)const
+	{
+		return mCold != nullptr ? mCold->GetBlock(x, y, z) : mBlocks->Get(Index(x, y, z));
+	}
+	void SetBlock(int x, int y, int z, BlockId id);
+
+	// Bulk access to all ChunkVolume blocks in Index() order.  Copying out of a
+	// frozen chunk decodes straight from the cold tier without thawing it.
+	void CopyBlocks(BlockId* dest)const;
+	void AssignBlocks(const BlockId* src);
+
+	// Moves the blocks into the run-length encoded cold tier.
+	void Freeze();
+	// Expands the blocks back into paletted storage.  Edits thaw on their own;
+	// World::Update thaws chunks that have been read since they froze.
+	void Thaw();
+	bool IsCold()const { return mCold != nullptr; }
+
+	// Time of the last access through the World, in World::Update time.  Safe
+	// to touch from several reading threads at once.
+	double GetLastAccess()const { return mLastAccess.load(std::memory_order_relaxed); }
+	void Touch(double now)const { mLastAccess.store(now, std::memory_order_relaxed); }
+
+	static const ColdTierCounters& GetColdTierCounters() { return sColdTierCounters; }
+
+	// Shares the current blocks with a snapshot.  Constant time.
+	ChunkSnapshot Snapshot()const;
+	static const CopyOnWriteCounters& GetCopyOnWriteCounters() { return sCopyOnWriteCounters; }
+
+	// Set by every edit; cleared by whoever saves the chunk.
+	bool IsDirty()const { return mDirty; }
+	void ClearDirty()const { mDirty = false; }
+	// Counts edits, so a save that finishes later can tell whether the chunk
+	// changed after its snapshot was taken.
+	std::uint32_t GetEditGeneration()const { return mEditGeneration; }
+
+	// Local y + 1 of the highest block in the column that matches the
+	// heightmap, or 0 if there is none.
+	int GetColumnHeight(HeightmapType type, int x, int z)const
+	{
+		return mHeightmaps[(int)type][(z << ChunkShift) | x];
+	}
+
+	// Number of blocks that are not air.
+	int GetSolidCount()const { return mSolidCount; }
+	bool IsEmpty()const { return mSolidCount == 0; }
+
+	// Width of the packed block indices: 0 (uniform or frozen), 1, 2, 4 or 8.
+	int GetBitsPerBlock()const { return mBlocks != nullptr ? mBlocks->GetBitsPerBlock() : 0; }
+
+	// Bytes of CPU memory owned by this chunk.
+	std::size_t GetMemoryUsage()const;
+
+	static int Index(int x, int y, int z) { return (y << (2 * ChunkShift)) | (z << ChunkShift) | x; }
+
+private:
+	// Copies the paletted storage first if a snapshot still shares it.
+	void MakeBlocksUnique();
+	void UpdateHeightmaps(int x, int y, int z, BlockId id);
+	void RebuildHeightmaps(const BlockId* blocks);
+
+private:
+	ChunkCoord mCoord;
+	int mSolidCount = 0;
+	std::uint8_t mHeightmaps[gNumHeightmapTypes][ChunkSize * ChunkSize] = {};
+	// Exactly one tier is set: mCold while the chunk is cold, mBlocks
+	// otherwise.  Neither is modified while a snapshot shares it.
+	std::shared_ptr<PalettedStorage> mBlocks;
+	std::shared_ptr<const RleColumns> mCold;
+	mutable std::atomic<double> mLastAccess{ 0.0 };
+	mutable bool mDirty = false;
+	std::uint32_t mEditGeneration = 0;
+
+	static ColdTierCounters sColdTierCounters;
+	static CopyOnWriteCounters sCopyOnWriteCounters;
+};
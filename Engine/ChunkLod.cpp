@@ -0,0 +1,99 @@
+#include "ChunkLod.h"
+#include <algorithm>
+#include <cmath>
+
+static_assert((ChunkSize >> MaxChunkLod) > 0, "the coarsest level must keep at least one block per chunk");
+static_assert(MaxChunkLod <= ChunkVertex::MaxLod, "LOD levels must fit in a ChunkVertex");
+
+namespace
+{
+	BlockId CommonestBlock(const int* counts)
+	{
+		int best = 0;
+		for (int i = 1; i < gNumBlockTypes; i++)
+		{
+			if (counts[i] > counts[best])
+				best = i;
+		}
+		return (BlockId)best;
+	}
+}
+
+void DownsampleBlocks(const BlockId* padded, int lod, LodSelection selection, BlockId* coarse)
+{
+	std::fill(coarse, coarse + MeshPadVolume, BlockId::Air);
+
+	const int scale = 1 << lod;
+	const int size = ChunkSize >> lod;
+	for (int cy = 0; cy < size; cy++)
+	{
+		for (int cz = 0; cz < size; cz++)
+		{
+			for (int cx = 0; cx < size; cx++)
+			{
+				// counts[0] stays 0, so air only wins when nothing else was counted.
+				int counts[gNumBlockTypes] = {};
+				int solid = 0;
+				const int x0 = cx * scale, y0 = cy * scale, z0 = cz * scale;
+				for (int z = z0; z < z0 + scale; z++)
+				{
+					for (int x = x0; x < x0 + scale; x++)
+					{
+						for (int y = y0 + scale - 1; y >= y0; y--)
+						{
+							BlockId block = padded[ChunkMesher::PaddedIndex(x, y, z)];
+							if (block == BlockId::Air)
+								continue;
+
+							solid++;
+							counts[(int)block]++;
+							// Only the top block of each column counts towards the surface.
+							if (selection == LodSelection::Surface)
+								break;
+						}
+					}
+				}
+
+				bool keep = selection == LodSelection::Surface ? solid > 0 : solid * 2 > scale * scale * scale;
+				if (keep)
+					coarse[ChunkMesher::PaddedIndex(cx, cy, cz)] = CommonestBlock(counts);
+			}
+		}
+	}
+}
+
+void MeshChunkLod(ChunkMesher& mesher, const ChunkCoord& coord, const BlockId* padded, int lod,
+	LodSelection selection, BlockId* coarse, ChunkMesh& mesh)
+{
+	if (lod == 0)
+	{
+		mesher.Mesh(coord, padded, mesh);
+		return;
+	}
+
+	DownsampleBlocks(padded, lod, selection, coarse);
+	mesher.Mesh(coord, coarse, mesh);
+
+	mesh.Lod = lod;
+	for (ChunkMeshPart& part : mesh.Parts)
+	{
+		for (ChunkVertex& v : part.Vertices)
+			v.SetLod(lod);
+	}
+}
+
+int SelectChunkLod(const ChunkCoord& coord, float x, float y, float z)
+{
+	const float half = ChunkSize * 0.5f;
+	float dx = coord.X * ChunkSize + half - x;
+	float dy = coord.Y * ChunkSize + half - y;
+	float dz = coord.Z * ChunkSize + half - z;
+	float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+	for (int lod = 0; lod < MaxChunkLod; lod++)
+	{
+		if (distance <= ChunkLodDistances[lod])
+			return lod;
+	}
+	return MaxChunkLod;
+}
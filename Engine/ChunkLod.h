@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ChunkMesher.h"
+
+// Level 0 is full resolution; level n merges 2^n x 2^n x 2^n blocks into one.
+const int MaxChunkLod = 2;
+
+// Distance in blocks from the camera to a chunk's centre up to which each
+// level is used; past the last one chunks use MaxChunkLod.
+const float ChunkLodDistances[MaxChunkLod] = { 64.0f, 128.0f };
+
+// How a group of blocks becomes one coarse block.
+enum class LodSelection
+{
+	// Solid when more than half the blocks are, as the commonest solid type.
+	Majority,
+	// Solid when any block is, as the commonest type seen from above.  Coarse
+	// chunks then cover everything the full-resolution chunks do, so a
+	// neighbour drawn at level 0 never shows a hole where it culled a face.
+	Surface
+};
+
+// Fills coarse (MeshPadVolume entries, laid out like the padded chunk) with
+// the chunk downsampled to the given level.  The coarse blocks fill the low
+// corner, ChunkSize >> lod per axis, and everything else reads as air.
+//
+// That includes the border, so a coarse chunk always closes its faces on the
+// chunk boundary.  Those faces are the skirts: they hide the gaps between
+// neighbours drawn at different levels, and are hidden by the neighbour when
+// both are drawn at the same level.
+//
+// WorldOctree's coarse levels aren't a substitute: their representative types
+// are majorities, which drop the thin surface cells LodSelection::Surface
+// keeps and open holes between levels.
+void DownsampleBlocks(const BlockId* padded, int lod, LodSelection selection, BlockId* coarse);
+
+// Meshes the chunk at the given level with the ordinary mesher, then tags the
+// vertices with the level so the shader scales them back to block units (see
+// ChunkVertex).  Level 0 is the same as ChunkMesher::Mesh.  coarse is scratch
+// space for MeshPadVolume blocks.
+void MeshChunkLod(ChunkMesher& mesher, const ChunkCoord& coord, const BlockId* padded, int lod,
+	LodSelection selection, BlockId* coarse, ChunkMesh& mesh);
+
+// Level for a chunk from the camera's position in world blocks.
+int SelectChunkLod(const ChunkCoord& coord, float x, float y, float z);
@@ -0,0 +1,321 @@
+#include "ChunkMesher.h"
+#include "FaceCulling.h"
+#include <algorithm>
+
+static_assert(ChunkSize <= ChunkVertex::MaxCoord, "chunk corners must fit in a ChunkVertex");
+
+std::size_t ChunkMesh::GetVertexCount()const
+{
+	std::size_t count = 0;
+	for (const ChunkMeshPart& part : Parts)
+		count += part.Vertices.size();
+	return count;
+}
+
+std::size_t ChunkMesh::GetTriangleCount()const
+{
+	std::size_t count = 0;
+	for (const ChunkMeshPart& part : Parts)
+		count += part.GetQuadCount() * 2;
+	return count;
+}
+
+namespace
+{
+	// Distance between neighbouring padded cells along x, y and z.
+	const int PadStride[3] = { 1, MeshPadSize * MeshPadSize, MeshPadSize };
+
+	// Mask entry for a face with no occlusion at any corner.
+	const std::uint16_t OpenFaceAo = 0xFF;
+
+	void CopyCenter(const BlockId* blocks, BlockId* padded)
+	{
+		for (int y = 0; y < ChunkSize; y++)
+		{
+			for (int z = 0; z < ChunkSize; z++)
+				std::copy(&blocks[Chunk::Index(0, y, z)], &blocks[Chunk::Index(0, y, z)] + ChunkSize, &padded[ChunkMesher::PaddedIndex(0, y, z)]);
+		}
+	}
+
+	// Copies the part of the border that the neighbour at (dx, dy, dz) covers:
+	// a face, an edge or a corner.  Along each axis -1 takes the neighbour's
+	// last layer, +1 its first and 0 the whole span.
+	template<typename ReadBlock>
+	void CopyBorder(int dx, int dy, int dz, BlockId* padded, ReadBlock read)
+	{
+		int minX = dx < 0 ? ChunkMask : 0, maxX = dx > 0 ? 0 : ChunkMask;
+		int minY = dy < 0 ? ChunkMask : 0, maxY = dy > 0 ? 0 : ChunkMask;
+		int minZ = dz < 0 ? ChunkMask : 0, maxZ = dz > 0 ? 0 : ChunkMask;
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int z = minZ; z <= maxZ; z++)
+			{
+				for (int x = minX; x <= maxX; x++)
+					padded[ChunkMesher::PaddedIndex(x + dx * ChunkSize, y + dy * ChunkSize, z + dz * ChunkSize)] = read(x, y, z);
+			}
+		}
+	}
+}
+
+void ChunkMesher::GatherBlocks(const World& world, const ChunkCoord& coord, BlockId* padded)
+{
+	BlockId blocks[ChunkVolume];
+	const Chunk* center = world.GetChunk(coord);
+	if (center != nullptr)
+		center->CopyBlocks(blocks);
+	else
+		std::fill(blocks, blocks + ChunkVolume, BlockId::Air);
+	CopyCenter(blocks, padded);
+
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if (dx == 0 && dy == 0 && dz == 0)
+					continue;
+
+				const Chunk* chunk = world.GetChunk(ChunkCoord{ coord.X + dx, coord.Y + dy, coord.Z + dz });
+				CopyBorder(dx, dy, dz, padded, [chunk](int x, int y, int z)
+				{
+					return chunk != nullptr ? chunk->GetBlock(x, y, z) : BlockId::Air;
+				});
+			}
+		}
+	}
+}
+
+ChunkNeighbourhood ChunkNeighbourhood::Capture(const World& world, const ChunkCoord& coord)
+{
+	ChunkNeighbourhood n;
+	n.Coord = coord;
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				ChunkCoord c{ coord.X + dx, coord.Y + dy, coord.Z + dz };
+				const Chunk* chunk = world.GetChunk(c);
+				n.Chunks[NeighbourIndex(dx, dy, dz)] = chunk != nullptr ? chunk->Snapshot() : ChunkSnapshot(c);
+			}
+		}
+	}
+
+	return n;
+}
+
+void ChunkNeighbourhood::GatherBlocks(BlockId* padded)const
+{
+	BlockId blocks[ChunkVolume];
+	Chunks[NeighbourIndex(0, 0, 0)].CopyBlocks(blocks);
+	CopyCenter(blocks, padded);
+
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if (dx == 0 && dy == 0 && dz == 0)
+					continue;
+
+				// Cold neighbours can't be read a block at a time, so decode them.
+				const ChunkSnapshot& snapshot = Chunks[NeighbourIndex(dx, dy, dz)];
+				if (snapshot.IsCold())
+				{
+					snapshot.CopyBlocks(blocks);
+					CopyBorder(dx, dy, dz, padded, [&blocks](int x, int y, int z) { return blocks[Chunk::Index(x, y, z)]; });
+				}
+				else
+				{
+					CopyBorder(dx, dy, dz, padded, [&snapshot](int x, int y, int z) { return snapshot.GetBlock(x, y, z); });
+				}
+			}
+		}
+	}
+}
+
+void ChunkMesher::Mesh(const ChunkCoord& coord, const BlockId* padded, ChunkMesh& mesh)
+{
+	for (ChunkMeshPart& part : mParts)
+	{
+		part.Vertices.clear();
+	}
+	mFaceCount = 0;
+
+	ChunkFaceMasks faces;
+	CullHiddenFaces(padded, faces);
+
+	if (mAmbientOcclusion)
+	{
+		for (int i = 0; i < MeshPadVolume; i++)
+			mOpaque[i] = HasBlockFlag(padded[i], BlockFlag_Opaque) ? 1 : 0;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		MeshDirection(padded, faces, axis, 1);
+		MeshDirection(padded, faces, axis, -1);
+	}
+
+	mesh.Coord = coord;
+	mesh.Lod = 0;
+	mesh.Parts.clear();
+	mesh.FaceCount = mFaceCount;
+	for (int layer = 0; layer < (int)ChunkLayer::Count; layer++)
+	{
+		for (int i = 0; i < gNumBlockTypes; i++)
+		{
+			if (mParts[i].Vertices.empty() || GetChunkLayer((BlockId)i) != (ChunkLayer)layer)
+				continue;
+
+			mesh.Parts.push_back(ChunkMeshPart());
+			mesh.Parts.back().Block = (BlockId)i;
+			mesh.Parts.back().Layer = (ChunkLayer)layer;
+			mesh.Parts.back().Vertices = mParts[i].Vertices;
+		}
+	}
+}
+
+ChunkMesh ChunkMesher::Mesh(const World& world, const ChunkCoord& coord)
+{
+	mPadded.resize(MeshPadVolume);
+	GatherBlocks(world, coord, mPadded.data());
+
+	ChunkMesh mesh;
+	Mesh(coord, mPadded.data(), mesh);
+	return mesh;
+}
+
+void ChunkMesher::MeshDirection(const BlockId* padded, const ChunkFaceMasks& faces, int axis, int sign)
+{
+	// u and v span the slice; (axis, u, v) is a cyclic order of (x, y, z).
+	const int uAxis = (axis + 1) % 3;
+	const int vAxis = (axis + 2) % 3;
+	const FaceDirection direction = (FaceDirection)(axis * 2 + (sign > 0 ? 0 : 1));
+
+	for (int slice = 0; slice < ChunkSize; slice++)
+	{
+		int pos[3];
+		pos[axis] = slice;
+		for (int v = 0; v < ChunkSize; v++)
+		{
+			pos[vAxis] = v;
+			for (int u = 0; u < ChunkSize; u++)
+			{
+				pos[uAxis] = u;
+				std::uint16_t key = 0;
+				if (faces.IsVisible(direction, pos[0], pos[1], pos[2]))
+				{
+					int index = PaddedIndex(pos[0], pos[1], pos[2]);
+					int ao = mAmbientOcclusion ? FaceAo(index, axis, sign) : OpenFaceAo;
+					key = (std::uint16_t)((int)padded[index] | (ao << 8));
+				}
+				mMask[v * ChunkSize + u] = key;
+			}
+		}
+
+		// Grow each rectangle along u first, then along v while whole rows match.
+		const int plane = sign > 0 ? slice + 1 : slice;
+		for (int v = 0; v < ChunkSize; v++)
+		{
+			for (int u = 0; u < ChunkSize; )
+			{
+				std::uint16_t key = mMask[v * ChunkSize + u];
+				if (key == 0)
+				{
+					u++;
+					continue;
+				}
+
+				int width = 1;
+				while (u + width < ChunkSize && mMask[v * ChunkSize + u + width] == key)
+					width++;
+
+				int height = 1;
+				for (; v + height < ChunkSize; height++)
+				{
+					const std::uint16_t* row = &mMask[(v + height) * ChunkSize + u];
+					if (std::find_if(row, row + width, [key](std::uint16_t k) { return k != key; }) != row + width)
+						break;
+				}
+
+				for (int h = 0; h < height; h++)
+					std::fill(&mMask[(v + h) * ChunkSize + u], &mMask[(v + h) * ChunkSize + u] + width, (std::uint16_t)0);
+
+				EmitQuad((BlockId)(key & 0xFF), key >> 8, axis, sign, plane, u, v, width, height);
+				mFaceCount += width * height;
+				u += width;
+			}
+		}
+	}
+}
+
+int ChunkMesher::FaceAo(int index, int axis, int sign)const
+{
+	// The blocks that shade a face are in the layer in front of it.
+	const int su = PadStride[(axis + 1) % 3];
+	const int sv = PadStride[(axis + 2) % 3];
+	const std::uint8_t* front = &mOpaque[index + sign * PadStride[axis]];
+
+	bool uNeg = front[-su] != 0, uPos = front[su] != 0;
+	bool vNeg = front[-sv] != 0, vPos = front[sv] != 0;
+	int ao00 = VertexAo(uNeg, vNeg, front[-su - sv] != 0);
+	int ao10 = VertexAo(uPos, vNeg, front[su - sv] != 0);
+	int ao01 = VertexAo(uNeg, vPos, front[-su + sv] != 0);
+	int ao11 = VertexAo(uPos, vPos, front[su + sv] != 0);
+	return ao00 | (ao10 << 2) | (ao01 << 4) | (ao11 << 6);
+}
+
+void ChunkMesher::EmitQuad(BlockId block, int ao, int axis, int sign, int plane, int u, int v, int width, int height)
+{
+	const int uAxis = (axis + 1) % 3;
+	const int vAxis = (axis + 2) % 3;
+
+	int origin[3];
+	origin[axis] = plane;
+	origin[uAxis] = u;
+	origin[vAxis] = v;
+
+	int du[3] = {};
+	int dv[3] = {};
+	du[uAxis] = width;
+	dv[vAxis] = height;
+
+	// Front faces wind clockwise.  Going origin, +a, +a+b, +b does that when
+	// a x b points along the normal, which u x v does for the positive side.
+	const int* a = sign > 0 ? du : dv;
+	const int* b = sign > 0 ? dv : du;
+	const FaceDirection face = (FaceDirection)(axis * 2 + (sign > 0 ? 0 : 1));
+
+	ChunkVertex corners[4];
+	int cornerAo[4];
+	for (int corner = 0; corner < 4; corner++)
+	{
+		int wa = (corner == 1 || corner == 2) ? 1 : 0;
+		int wb = (corner == 2 || corner == 3) ? 1 : 0;
+
+		int p[3];
+		for (int i = 0; i < 3; i++)
+			p[i] = origin[i] + wa * a[i] + wb * b[i];
+
+		// a and b are u and v swapped on the negative side.
+		int cu = sign > 0 ? wa : wb;
+		int cv = sign > 0 ? wb : wa;
+		cornerAo[corner] = (ao >> ((cv * 2 + cu) * 2)) & ChunkVertex::MaxAo;
+
+		corners[corner] = ChunkVertex::Encode(p[0], p[1], p[2], face, corner, block, cornerAo[corner]);
+	}
+
+	// Split along the brighter diagonal.  Otherwise a single dark corner is
+	// interpolated across both triangles and the shading depends on how the
+	// quad happens to be wound.  QuadIndexPattern splits from the first vertex
+	// to the third, so the other split starts the quad one corner later, which
+	// keeps the winding.
+	const int first = cornerAo[0] + cornerAo[2] < cornerAo[1] + cornerAo[3] ? 1 : 0;
+	ChunkMeshPart& part = mParts[(int)block];
+	for (int i = 0; i < 4; i++)
+		part.Vertices.push_back(corners[(first + i) & 3]);
+}
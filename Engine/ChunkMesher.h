@@ -0,0 +1,172 @@
+#pragma once
+
+#include "ChunkVertex.h"
+#include "World.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A chunk is meshed from a copy of its blocks with a one-block border taken
+// from the 26 neighbouring chunks, so faces on the chunk boundary can be culled
+// without looking anything up while meshing.
+const int MeshPadSize = ChunkSize + 2;
+const int MeshPadVolume = MeshPadSize * MeshPadSize * MeshPadSize;
+
+struct ChunkFaceMasks;
+
+// Everything needed to mesh a chunk, captured on the thread that owns the
+// world: snapshots of the chunk and its 26 neighbours.  Taking it only bumps
+// reference counts, and the result can be meshed on any thread while the
+// world keeps changing.
+struct ChunkNeighbourhood
+{
+	ChunkCoord Coord;
+	// Level of detail to mesh at.
+	int Lod = 0;
+	// Indexed by NeighbourIndex; missing chunks are empty snapshots.
+	ChunkSnapshot Chunks[27];
+
+	static int NeighbourIndex(int dx, int dy, int dz) { return ((dy + 1) * 3 + (dz + 1)) * 3 + (dx + 1); }
+
+	static ChunkNeighbourhood Capture(const World& world, const ChunkCoord& coord);
+	// Fills padded (MeshPadVolume entries) like ChunkMesher::GatherBlocks.
+	void GatherBlocks(BlockId* padded)const;
+};
+
+// Pass a block's faces are drawn in, from its BlockFlags.
+enum class ChunkLayer : int
+{
+	Opaque = 0,
+	// Alpha tested, e.g. leaves.
+	Cutout,
+	// Blended back to front, e.g. water.
+	Translucent,
+	Count
+};
+
+inline ChunkLayer GetChunkLayer(BlockId id)
+{
+	if (HasBlockFlag(id, BlockFlag_Translucent))
+		return ChunkLayer::Translucent;
+	return HasBlockFlag(id, BlockFlag_Cutout) ? ChunkLayer::Cutout : ChunkLayer::Opaque;
+}
+
+// Chunk meshes have no index lists of their own.  Every quad is four
+// vertices, drawn with these six indices offset by four per quad, so all chunks
+// share one static index buffer (see BuildQuadIndices).
+const std::uint32_t QuadIndexPattern[6] = { 0, 1, 2, 0, 2, 3 };
+
+// Most quads 16-bit indices can reach from one base vertex.
+const std::size_t MaxQuads16 = 65536 / 4;
+// Most quads one part can have: every other block of one type, with all six
+// faces showing.
+const std::size_t MaxChunkPartQuads = ChunkVolume / 2 * gNumFaceDirections;
+
+// Fills indices with QuadIndexPattern for quadCount quads.  Index is
+// std::uint16_t (up to MaxQuads16 quads) or std::uint32_t.
+template<typename Index>
+void BuildQuadIndices(std::size_t quadCount, std::vector<Index>& indices)
+{
+	indices.resize(quadCount * 6);
+	for (std::size_t q = 0; q < quadCount; q++)
+	{
+		for (int i = 0; i < 6; i++)
+			indices[q * 6 + i] = (Index)(q * 4 + QuadIndexPattern[i]);
+	}
+}
+
+// The visible faces of one block type in a chunk, four vertices per quad.
+struct ChunkMeshPart
+{
+	BlockId Block = BlockId::Air;
+	ChunkLayer Layer = ChunkLayer::Opaque;
+	std::vector<ChunkVertex> Vertices;
+
+	std::size_t GetQuadCount()const { return Vertices.size() / 4; }
+};
+
+// Triangle list for a chunk in chunk-local block units; translate it by the
+// chunk's world position to draw it.
+struct ChunkMesh
+{
+	ChunkCoord Coord;
+	// Level of detail it was meshed at (see ChunkLod.h).
+	int Lod = 0;
+	// One part per block type with visible faces, grouped by layer and in
+	// BlockId order within a layer, so each layer is one run of parts.
+	std::vector<ChunkMeshPart> Parts;
+	// Number of block faces the quads cover, before merging.
+	std::size_t FaceCount = 0;
+
+	std::size_t GetVertexCount()const;
+	std::size_t GetTriangleCount()const;
+	bool IsEmpty()const { return Parts.empty(); }
+};
+
+// Builds chunk meshes from the exposed block faces only, found a row at a time
+// by CullHiddenFaces (FaceCulling.h).  Faces in the same plane that face the
+// same way and share a block type are merged greedily into larger quads, which
+// the shader tiles with the texture once per block (see ChunkVertex).
+//
+// Each vertex also gets a baked ambient occlusion level from the opaque blocks
+// around its corner in front of the face, so creases and corners darken at no
+// cost when drawing.  Faces only merge when their four corner levels match,
+// and quads are split along the diagonal that keeps the shading symmetric.
+class ChunkMesher
+{
+public:
+	// Fills padded (MeshPadVolume entries) with the chunk and its border.
+	// Missing chunks read as air.
+	static void GatherBlocks(const World& world, const ChunkCoord& coord, BlockId* padded);
+
+	// Coordinates are chunk-local and may be -1 or ChunkSize for the border.
+	static int PaddedIndex(int x, int y, int z)
+	{
+		return ((y + 1) * MeshPadSize + (z + 1)) * MeshPadSize + (x + 1);
+	}
+
+	// Whether a face of block shows when the given block is next to it.  This
+	// is the rule CullHiddenFaces applies to whole rows.
+	static bool IsFaceVisible(BlockId block, BlockId neighbour)
+	{
+		if (block == BlockId::Air || HasBlockFlag(neighbour, BlockFlag_Opaque))
+			return false;
+
+		// Water and leaves don't draw the faces between two blocks of their own type.
+		return neighbour != block;
+	}
+
+	// Occlusion level of a face corner, 0 (darkest) to ChunkVertex::MaxAo, from
+	// the two blocks beside it and the one diagonal to it in front of the face.
+	// With both sides blocked the corner is fully dark whatever the diagonal.
+	static int VertexAo(bool side1, bool side2, bool corner)
+	{
+		if (side1 && side2)
+			return 0;
+		return ChunkVertex::MaxAo - ((int)side1 + (int)side2 + (int)corner);
+	}
+
+	// On by default.  Off gives every vertex MaxAo and merges as before.
+	void SetAmbientOcclusion(bool enabled) { mAmbientOcclusion = enabled; }
+
+	void Mesh(const ChunkCoord& coord, const BlockId* padded, ChunkMesh& mesh);
+	ChunkMesh Mesh(const World& world, const ChunkCoord& coord);
+
+private:
+	// axis is 0, 1 or 2 for x, y or z; sign is +1 or -1.
+	void MeshDirection(const BlockId* padded, const ChunkFaceMasks& faces, int axis, int sign);
+	// Levels of the face's (u, v) corners (0, 0), (1, 0), (0, 1) and (1, 1), two bits each.
+	int FaceAo(int index, int axis, int sign)const;
+	void EmitQuad(BlockId block, int ao, int axis, int sign, int plane, int u, int v, int width, int height);
+
+private:
+	// Block type of the visible face at each cell of the slice being merged in
+	// the low byte and its FaceAo levels in the high byte; 0 for no face.
+	std::uint16_t mMask[ChunkSize * ChunkSize];
+	// 1 for each opaque block of the padded chunk being meshed.
+	std::uint8_t mOpaque[MeshPadVolume];
+	bool mAmbientOcclusion = true;
+	ChunkMeshPart mParts[gNumBlockTypes];
+	std::size_t mFaceCount = 0;
+	std::vector<BlockId> mPadded;
+};
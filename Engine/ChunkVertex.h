@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Block.h"
+#include <cstdint>
+
+// Direction a block face points in.  Faces of one axis are adjacent, positive first.
+enum class FaceDirection : int
+{
+	PosX = 0,
+	NegX,
+	PosY,
+	NegY,
+	PosZ,
+	NegZ,
+	Count
+};
+
+const int gNumFaceDirections = (int)FaceDirection::Count;
+
+// Packed vertex of a chunk mesh, drawn with the R32G32_UINT "PACKED" input
+// layout and unpacked by ChunkVS in Default.hlsl.  Keep the two in step.
+//
+// Position: bits 0-5 x, 6-11 y, 12-17 z in chunk-local block units,
+//           18-20 FaceDirection, 21-22 quad corner (0-3), 23-24 LOD level,
+//           25-31 unused.  At level n the position is in units of 2^n blocks.
+// Attributes: bits 0-7 BlockId, 8-9 ambient occlusion (0 darkest, 3 open),
+//             10-31 unused.
+//
+// The normal and texture coordinates aren't stored: the shader takes the
+// normal from the face direction and tiles the texture across the face from
+// the position, one repeat per block.
+struct ChunkVertex
+{
+	std::uint32_t Position;
+	std::uint32_t Attributes;
+
+	static const int CoordBits = 6;
+	static const int MaxCoord = (1 << CoordBits) - 1;
+	static const int MaxAo = 3;
+	static const int MaxLod = 3;
+
+	static ChunkVertex Encode(int x, int y, int z, FaceDirection face, int corner, BlockId block, int ao = MaxAo)
+	{
+		ChunkVertex v;
+		v.Position = (std::uint32_t)x | ((std::uint32_t)y << 6) | ((std::uint32_t)z << 12) |
+			((std::uint32_t)face << 18) | ((std::uint32_t)corner << 21);
+		v.Attributes = (std::uint32_t)block | ((std::uint32_t)ao << 8);
+		return v;
+	}
+
+	int GetX()const { return (int)(Position & MaxCoord); }
+	int GetY()const { return (int)((Position >> 6) & MaxCoord); }
+	int GetZ()const { return (int)((Position >> 12) & MaxCoord); }
+	FaceDirection GetFace()const { return (FaceDirection)((Position >> 18) & 7); }
+	int GetCorner()const { return (int)((Position >> 21) & 3); }
+	int GetLod()const { return (int)((Position >> 23) & MaxLod); }
+	BlockId GetBlock()const { return (BlockId)(Attributes & 0xFF); }
+	int GetAo()const { return (int)((Attributes >> 8) & MaxAo); }
+
+	void SetLod(int lod) { Position = (Position & ~((std::uint32_t)MaxLod << 23)) | ((std::uint32_t)lod << 23); }
+};
+
+static_assert(sizeof(ChunkVertex) == 8, "ChunkVertex must match the R32G32_UINT input layout");
+static_assert(gNumFaceDirections <= 8, "FaceDirection must fit in three bits");
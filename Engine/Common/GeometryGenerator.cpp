@@ -655,3 +655,87 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 
     return meshData;
 }
+
+GeometryGenerator::VoxelMeshData GeometryGenerator::CreateVoxelFace(VoxelFace face)
+{
+	VoxelMeshData meshData;
+	AppendVoxelFace(face, meshData);
+
+	return meshData;
+}
+
+GeometryGenerator::VoxelMeshData GeometryGenerator::CreateVoxelFaces()
+{
+	const int faceCount = (int)VoxelFace::Count;
+
+	VoxelMeshData meshData;
+	meshData.Vertices.reserve(faceCount * 4);
+	meshData.Indices.reserve(faceCount * 6);
+	for(int i = 0; i < faceCount; ++i)
+		AppendVoxelFace((VoxelFace)i, meshData);
+
+	return meshData;
+}
+
+XMFLOAT3 GeometryGenerator::GetVoxelFaceNormal(VoxelFace face)
+{
+	float n[3] = { 0.0f, 0.0f, 0.0f };
+	n[(int)face / 2] = ((int)face & 1) ? -1.0f : 1.0f;
+
+	return XMFLOAT3(n[0], n[1], n[2]);
+}
+
+void GeometryGenerator::AppendVoxelFace(VoxelFace face, VoxelMeshData& meshData)
+{
+	const int axis = (int)face / 2;
+	const bool positive = ((int)face & 1) == 0;
+
+	VoxelSubmesh& submesh = meshData.Faces[(int)face];
+	submesh.IndexCount = 6;
+	submesh.StartIndexLocation = (uint32)meshData.Indices.size();
+	submesh.BaseVertexLocation = (uint32)meshData.Vertices.size();
+
+	// The corners go origin, +a, +a+b, +b, which winds clockwise seen from
+	// outside when a x b points out of the cube.  ChunkMesher::EmitQuad
+	// builds its quads the same way.
+	const int uAxis = (axis + 1) % 3;
+	const int vAxis = (axis + 2) % 3;
+	const int a = positive ? uAxis : vAxis;
+	const int b = positive ? vAxis : uAxis;
+
+	for(int corner = 0; corner < 4; ++corner)
+	{
+		uint8 p[3];
+		p[axis] = positive ? 1 : 0;
+		p[a] = (corner == 1 || corner == 2) ? 1 : 0;
+		p[b] = (corner == 2 || corner == 3) ? 1 : 0;
+
+		VoxelVertex v;
+		v.X = p[0];
+		v.Y = p[1];
+		v.Z = p[2];
+		v.Face = (uint8)face;
+
+		// Same orientation as ChunkVS in Default.hlsl, wrapped into [0,1].
+		if(axis == 0)
+		{
+			v.U = positive ? v.Z : 1 - v.Z;
+			v.V = 1 - v.Y;
+		}
+		else if(axis == 1)
+		{
+			v.U = v.X;
+			v.V = positive ? 1 - v.Z : v.Z;
+		}
+		else
+		{
+			v.U = positive ? 1 - v.X : v.X;
+			v.V = 1 - v.Y;
+		}
+
+		meshData.Vertices.push_back(v);
+	}
+
+	const uint16 quadIndices[6] = { 0, 1, 2, 0, 2, 3 };
+	meshData.Indices.insert(meshData.Indices.end(), quadIndices, quadIndices + 6);
+}
@@ -22,6 +22,7 @@ class GeometryGenerator
 {
 public:
 
+    using uint8 = std::uint8_t;
     using uint16 = std::uint16_t;
     using uint32 = std::uint32_t;
 
@@ -74,6 +75,48 @@ public:
 		std::vector<uint16> mIndices16;
 	};
 
+	// The faces of a voxel, in the same order as the engine's FaceDirection.
+	enum class VoxelFace : uint8
+	{
+		PosX = 0,
+		NegX,
+		PosY,
+		NegY,
+		PosZ,
+		NegZ,
+		Count
+	};
+
+	// Vertex of a voxel face.  Position and texture coordinates are all 0 or 1,
+	// so they fit in bytes; the normal comes from the face.
+	struct VoxelVertex
+	{
+		uint8 X = 0;
+		uint8 Y = 0;
+		uint8 Z = 0;
+		uint8 Face = 0;
+		uint8 U = 0;
+		uint8 V = 0;
+	};
+
+	// Where one face sits in VoxelMeshData, laid out like SubmeshGeometry.
+	struct VoxelSubmesh
+	{
+		uint32 IndexCount = 0;
+		uint32 StartIndexLocation = 0;
+		uint32 BaseVertexLocation = 0;
+	};
+
+	// Each face is a quad of four vertices and six 16-bit indices.  The indices
+	// are the face's own (0-3), so a face is drawn with its BaseVertexLocation,
+	// either alone or together with the ones after it.
+	struct VoxelMeshData
+	{
+		std::vector<VoxelVertex> Vertices;
+		std::vector<uint16> Indices;
+		VoxelSubmesh Faces[(int)VoxelFace::Count];
+	};
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
@@ -110,10 +153,30 @@ public:
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// Creates one face of the unit cube [0,1]^3.  Seen from outside, the face
+	/// winds clockwise, which is front facing with the default rasterizer state,
+	/// and has u to the right and v down.  Side faces are upright and the top
+	/// and bottom faces have u along +x, matching the chunk meshes' tiling.
+	///</summary>
+	VoxelMeshData CreateVoxelFace(VoxelFace face);
+
+	///<summary>
+	/// Creates all six faces of the unit cube, in VoxelFace order, with a
+	/// submesh per face.
+	///</summary>
+	VoxelMeshData CreateVoxelFaces();
+
+	///<summary>
+	/// Returns the outward unit normal of a voxel face.
+	///</summary>
+	DirectX::XMFLOAT3 GetVoxelFaceNormal(VoxelFace face);
+
 private:
 	void Subdivide(MeshData& meshData);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
     void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
     void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+	void AppendVoxelFace(VoxelFace face, VoxelMeshData& meshData);
 };
 
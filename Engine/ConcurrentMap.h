@@ -0,0 +1,253 @@
+#pragma once
+
+#include "Epoch.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Open-addressing hash map from 64-bit keys to owned T objects.
+//
+// Find() never takes a lock.  Insert, Erase and Clear are serialized by a writer
+// mutex and are safe to run while readers are probing.  Erased values and
+// outgrown tables are retired to the EpochManager rather than deleted, so a
+// pointer returned by Find() stays valid for as long as the caller stays inside
+// an EpochGuard.
+//
+// Keys must not have the top bit set; those values mark empty and erased slots.
+// PackChunkCoord only ever uses the low 63 bits.
+template<typename T>
+class ConcurrentMap
+{
+public:
+	static const std::uint64_t EmptyKey = ~0ull;
+	static const std::uint64_t TombstoneKey = ~0ull - 1;
+
+	explicit ConcurrentMap(std::size_t initialCapacity = 64)
+	{
+		std::size_t capacity = 16;
+		while (capacity < initialCapacity)
+			capacity *= 2;
+
+		mTable.store(new Table(capacity));
+	}
+
+	ConcurrentMap(const ConcurrentMap& rhs) = delete;
+	ConcurrentMap& operator=(const ConcurrentMap& rhs) = delete;
+
+	~ConcurrentMap()
+	{
+		// Readers must be gone by now, so skip the epoch machinery.
+		Table* table = mTable.load();
+		for (std::size_t i = 0; i < table->Capacity; i++)
+			delete table->Slots[i].Value.load();
+		delete table;
+	}
+
+	T* Find(std::uint64_t key)const
+	{
+		EpochGuard guard;
+
+		const Table* table = mTable.load(std::memory_order_acquire);
+		std::size_t mask = table->Capacity - 1;
+		for (std::size_t i = Hash(key) & mask, probes = 0; probes < table->Capacity; i = (i + 1) & mask, probes++)
+		{
+			std::uint64_t k = table->Slots[i].Key.load(std::memory_order_acquire);
+			if (k == key)
+			{
+				T* value = table->Slots[i].Value.load(std::memory_order_acquire);
+
+				// The slot may have been erased and reused for another key
+				// between the two loads; the value then belongs to that key.
+				if (table->Slots[i].Key.load(std::memory_order_acquire) != key)
+					return nullptr;
+
+				return value;
+			}
+			if (k == EmptyKey)
+				return nullptr;
+		}
+
+		return nullptr;
+	}
+
+	// Stores value under key unless the key is already present.  Returns the
+	// object now stored under key; a losing value is destroyed.
+	T* Insert(std::uint64_t key, std::unique_ptr<T> value)
+	{
+		std::lock_guard<std::mutex> lock(mWriteMutex);
+
+		Table* table = mTable.load(std::memory_order_relaxed);
+		std::size_t slot = FindSlot(table, key);
+		if (slot != Npos)
+			return table->Slots[slot].Value.load(std::memory_order_relaxed);
+
+		// Tombstones count towards the load since probes walk over them.
+		if ((mUsedSlots + 1) * 2 > table->Capacity)
+			table = Grow(table);
+
+		std::size_t mask = table->Capacity - 1;
+		std::size_t i = Hash(key) & mask;
+		for (;;)
+		{
+			std::uint64_t k = table->Slots[i].Key.load(std::memory_order_relaxed);
+			if (k == EmptyKey || k == TombstoneKey)
+				break;
+			i = (i + 1) & mask;
+		}
+
+		if (table->Slots[i].Key.load(std::memory_order_relaxed) == EmptyKey)
+			mUsedSlots++;
+
+		// Publish the value before the key so a reader that matches the key
+		// always sees the value.
+		T* result = value.release();
+		table->Slots[i].Value.store(result, std::memory_order_release);
+		table->Slots[i].Key.store(key, std::memory_order_release);
+		mSize++;
+		return result;
+	}
+
+	bool Erase(std::uint64_t key)
+	{
+		std::lock_guard<std::mutex> lock(mWriteMutex);
+
+		Table* table = mTable.load(std::memory_order_relaxed);
+		std::size_t slot = FindSlot(table, key);
+		if (slot == Npos)
+			return false;
+
+		T* value = table->Slots[slot].Value.exchange(nullptr, std::memory_order_acq_rel);
+		table->Slots[slot].Key.store(TombstoneKey, std::memory_order_release);
+		mSize--;
+
+		EpochManager::Get().Retire(value);
+		EpochManager::Get().Collect();
+		return true;
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(mWriteMutex);
+
+		Table* old = mTable.load(std::memory_order_relaxed);
+		mTable.store(new Table(16), std::memory_order_release);
+		for (std::size_t i = 0; i < old->Capacity; i++)
+		{
+			T* value = old->Slots[i].Value.load(std::memory_order_relaxed);
+			if (value != nullptr)
+				EpochManager::Get().Retire(value);
+		}
+		EpochManager::Get().Retire(old);
+		EpochManager::Get().Collect();
+
+		mSize = 0;
+		mUsedSlots = 0;
+	}
+
+	// Visits every value.  Entries inserted or erased during the walk may or
+	// may not be seen.
+	template<typename Fn>
+	void ForEach(Fn fn)const
+	{
+		EpochGuard guard;
+
+		const Table* table = mTable.load(std::memory_order_acquire);
+		for (std::size_t i = 0; i < table->Capacity; i++)
+		{
+			std::uint64_t k = table->Slots[i].Key.load(std::memory_order_acquire);
+			if (k == EmptyKey || k == TombstoneKey)
+				continue;
+
+			T* value = table->Slots[i].Value.load(std::memory_order_acquire);
+			if (value != nullptr)
+				fn(*value);
+		}
+	}
+
+	std::size_t Size()const { return mSize.load(std::memory_order_relaxed); }
+	std::size_t GetCapacity()const { return mTable.load(std::memory_order_acquire)->Capacity; }
+	std::size_t GetMemoryUsage()const { return sizeof(ConcurrentMap) + sizeof(Table) + GetCapacity() * sizeof(Slot); }
+
+private:
+	struct Slot
+	{
+		std::atomic<std::uint64_t> Key{ EmptyKey };
+		std::atomic<T*> Value{ nullptr };
+	};
+
+	struct Table
+	{
+		explicit Table(std::size_t capacity) : Capacity(capacity), Slots(new Slot[capacity]) {}
+
+		std::size_t Capacity;
+		std::unique_ptr<Slot[]> Slots;
+	};
+
+	static const std::size_t Npos = ~(std::size_t)0;
+
+	static std::size_t Hash(std::uint64_t key)
+	{
+		// splitmix64 finalizer; packed coordinates are far from uniform.
+		key ^= key >> 30;
+		key *= 0xbf58476d1ce4e5b9ull;
+		key ^= key >> 27;
+		key *= 0x94d049bb133111ebull;
+		key ^= key >> 31;
+		return (std::size_t)key;
+	}
+
+	// Writer-side lookup; the caller holds mWriteMutex.
+	std::size_t FindSlot(const Table* table, std::uint64_t key)const
+	{
+		std::size_t mask = table->Capacity - 1;
+		for (std::size_t i = Hash(key) & mask, probes = 0; probes < table->Capacity; i = (i + 1) & mask, probes++)
+		{
+			std::uint64_t k = table->Slots[i].Key.load(std::memory_order_relaxed);
+			if (k == key)
+				return i;
+			if (k == EmptyKey)
+				return Npos;
+		}
+
+		return Npos;
+	}
+
+	// Copies the live entries into a table twice the size (or the same size
+	// if it is mostly tombstones), publishes it and retires the old one.
+	Table* Grow(Table* old)
+	{
+		std::size_t capacity = old->Capacity;
+		if ((mSize + 1) * 4 > capacity)
+			capacity *= 2;
+
+		Table* table = new Table(capacity);
+		std::size_t mask = capacity - 1;
+		for (std::size_t i = 0; i < old->Capacity; i++)
+		{
+			std::uint64_t k = old->Slots[i].Key.load(std::memory_order_relaxed);
+			if (k == EmptyKey || k == TombstoneKey)
+				continue;
+
+			std::size_t j = Hash(k) & mask;
+			while (table->Slots[j].Key.load(std::memory_order_relaxed) != EmptyKey)
+				j = (j + 1) & mask;
+
+			table->Slots[j].Value.store(old->Slots[i].Value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			table->Slots[j].Key.store(k, std::memory_order_relaxed);
+		}
+
+		mUsedSlots = mSize;
+		mTable.store(table, std::memory_order_release);
+		EpochManager::Get().Retire(old);
+		EpochManager::Get().Collect();
+		return table;
+	}
+
+private:
+	std::atomic<Table*> mTable{ nullptr };
+	std::atomic<std::size_t> mSize{ 0 };
+	// Slots that are full or tombstoned; only touched under mWriteMutex.
+	std::size_t mUsedSlots = 0;
+	std::mutex mWriteMutex;
+};
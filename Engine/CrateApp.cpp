@@ -10,7 +10,31 @@
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
 #include "FrameResource.h"
+#include "World.h"
+#include "WorldGenerator.h"
+#include "RegionFile.h"
+#include "EditJournal.h"
+#include "Autosave.h"
+#include "ChunkMesher.h"
+#include "ChunkLod.h"
+#include "MeshWorkerPool.h"
+#include "RemeshQueue.h"
+#include "TranslucentSort.h"
+#include "BlockInstances.h"
+#include "DrawQueue.h"
+#include "IndirectDraws.h"
+#include "ParallelRecorder.h"
+#include "VoxelOctree.h"
+#include "Benchmarks.h"
 #include "Windows.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -22,6 +46,38 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Seconds between background saves of edited chunks.
+const float gAutosaveInterval = 60.0f;
+
+// Farthest block a right click can dig or build on, in blocks.
+const float gPickDistance = 64.0f;
+
+// Edits in the journal before it is folded into the region files (16 bytes
+// each), and seconds to wait before checking again after a compaction.
+const std::uint64_t gJournalCompactionEdits = 100000;
+const float gJournalCompactionInterval = 10.0f;
+
+// Object constant buffer slots for chunks; each chunk takes one for all its materials.
+const UINT gMaxChunkObjects = 1024;
+
+// Sorted translucent indices each frame resource can hold; the farthest are dropped past this.
+const UINT gMaxTranslucentIndices = 1 << 18;
+
+// Blocks each frame resource can hold for the instanced path; the rest aren't drawn.
+const UINT gMaxBlockInstances = 1 << 19;
+
+// Commands and ExecuteIndirect groups each frame resource can hold; draws past these are dropped.
+const UINT gMaxIndirectCommands = 1 << 14;
+const UINT gMaxIndirectGroups = 256;
+
+// Fewest draws worth a command list of their own when recording in parallel.
+const std::size_t gMinDrawsPerCommandList = 64;
+
+static_assert(offsetof(IndirectCommand, IndexBufferLocation) == sizeof(D3D12_VERTEX_BUFFER_VIEW) &&
+	offsetof(IndirectCommand, ChunkIndex) == sizeof(D3D12_VERTEX_BUFFER_VIEW) + sizeof(D3D12_INDEX_BUFFER_VIEW) &&
+	sizeof(IndirectCommand) == offsetof(IndirectCommand, IndexCountPerInstance) + sizeof(D3D12_DRAW_INDEXED_ARGUMENTS),
+	"IndirectCommand must match the chunk command signature");
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -50,14 +106,25 @@ struct RenderItem
 	// Primitive topology.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
+	// Draws from the frame resource's back-to-front TranslucentIB instead of Geo's index buffer.
+	bool SortedIndices = false;
+
 	// DrawIndexedInstanced parameters.
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
 };
 
+// One draw of the sorted list the chunk layers are drawn from.
+struct DrawListItem
+{
+	RenderItem* Ri = nullptr;
+	ID3D12PipelineState* Pso = nullptr;
+};
+
 enum class RenderLayer : int {
 	Opaque = 0,
+	AlphaTested,
 	Mirrors,
 	Reflected,
 	Transparent,
@@ -83,6 +150,9 @@ private:
 	bool debugMode = false;
 	bool cullFront = false;
 	bool cullNone = false;
+	bool instancedBlocks = false;
+	bool indirectDraws = false;
+	bool parallelRecording = false;
 	bool isBuilt = false;
 
 
@@ -106,14 +176,36 @@ private:
 
 	void LoadTextures();
 	void BuildRootSignature();
+	void BuildCommandSignature();
 	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
+	void LoadWorld();
 	void BuildShapeGeometry();
+	MeshGeometry* UploadChunkMesh(const ChunkMesh& mesh);
+	void BuildQuadIndexBuffers();
+	std::unique_ptr<MeshGeometry> CreateQuadIndexBuffer(const std::string& name, const void* indices, UINT byteSize, DXGI_FORMAT format);
+	MeshGeometry* GetQuadIndexBuffer(std::size_t quadCount);
+	void BuildBlockGeometry();
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
 	void BuildRenderItems();
+	void BuildChunkRenderItems(const ChunkCoord& c, MeshGeometry* geo);
+	void RemoveChunkGeometry(const ChunkCoord& c);
+	void ApplyRemeshedChunks();
+	void UpdateChunkLods();
+	void UpdateTranslucentOrder();
+	void UpdateBlockInstances();
+	void SetBlock(int x, int y, int z, BlockId id);
+	void PickBlock(bool place);
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void SetDrawTargets(ID3D12GraphicsCommandList* cmdList);
+	void BuildDrawList(bool debugPso);
+	void DrawList(ID3D12GraphicsCommandList* cmdList, std::size_t begin, std::size_t end, DrawStateCache& cache);
+	std::size_t RecordLayersInParallel();
+	void DrawBlockInstances(ID3D12GraphicsCommandList* cmdList);
+	void DrawIndirect(ID3D12GraphicsCommandList* cmdList);
+	D3D12_INDEX_BUFFER_VIEW GetIndexBufferView(const RenderItem* ri);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
@@ -126,22 +218,86 @@ private:
 	UINT mCbvSrvDescriptorSize = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	// Vertex and index buffers, chunk slot and draw of one IndirectCommand.
+	ComPtr<ID3D12CommandSignature> mChunkCommandSignature = nullptr;
 
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+	// Mesh of each chunk with visible faces, keyed by PackChunkCoord.
+	std::unordered_map<std::uint64_t, MeshGeometry*> mChunkGeometries;
+	// Object constant buffer slot of each chunk that has been drawn.
+	std::unordered_map<std::uint64_t, UINT> mChunkObjCBIndices;
+	// Index buffers every chunk mesh draws its quads with; the 32-bit one is only made for parts too big for 16-bit indices.
+	std::unique_ptr<MeshGeometry> mQuadIndices16;
+	std::unique_ptr<MeshGeometry> mQuadIndices32;
+	// Replaced chunk meshes, kept until the gpu has finished the frames that use them.
+	std::deque<std::pair<UINT64, std::unique_ptr<MeshGeometry>>> mRetiredGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
+	// Material of each block type, indexed by BlockId (air is null).
+	Material* mBlockMaterials[gNumBlockTypes] = {};
+	// Every material, indexed by MatCBIndex.
+	std::vector<Material*> mMaterialsByCBIndex;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+	// Packed ChunkVertex, unpacked by ChunkVS.
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mChunkInputLayout;
+	// GeometryGenerator::VoxelVertex of the cube BlockVS instances.
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mVoxelInputLayout;
 
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mOpaquePSO;
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
-	// Render items divided by PSO.
-	std::vector<RenderItem*> mOpaqueRitems;
+
+	// Block data for the whole map, stored as chunks of block IDs.
+	World mWorld;
+	//the map is saved here after the first run and loaded on later ones
+	RegionStore mRegionStore{ "world" };
+	//block edits are logged here between saves and replayed on startup
+	EditJournal mJournal{ mRegionStore };
+	//edited chunks are written back in the background without stalling the frame
+	Autosave mAutosave{ mRegionStore, &mJournal };
+	//mouse picks are cast through this instead of stepping block by block
+	WorldOctree mOctree;
+	float mNextAutosave = gAutosaveInterval;
+	float mNextCompaction = 0.0f;
+	//chunk meshes are built on these threads from snapshots of the world
+	MeshWorkerPool mMeshWorkers;
+	//chunks whose meshes are out of date after block edits
+	RemeshQueue mRemeshQueue;
+	//chunk the camera was in when levels of detail were last picked
+	ChunkCoord mLodCameraChunk;
+	bool mLodCameraChunkValid = false;
+	//water and other translucent quads, kept in back-to-front order for the camera
+	TranslucentSorter mTranslucentSorter;
+	//translucent render items of each chunk, which mRitemLayer only holds once they are sorted
+	std::unordered_map<std::uint64_t, std::vector<RenderItem*>> mTranslucentRitems;
+	//frame resources whose TranslucentIB still holds an older order
+	int mTranslucentFramesDirty = 0;
+	//first sorted index that fits in TranslucentIB
+	std::size_t mTranslucentFirstIndex = 0;
+	//blocks with a visible face, grouped by type for the instanced path
+	BlockInstanceBuilder mBlockInstances;
+	//set by block edits; the instances are only rebuilt while the instanced path is in use
+	bool mBlockInstancesDirty = true;
+	//frame resources whose BlockInstances buffer is out of date
+	int mBlockInstanceFramesDirty = 0;
+	//argument buffer contents of the indirect draws, packed again every frame
+	IndirectDrawBuilder mIndirectDraws;
+	//worker threads that record the chunk layers into the frame resource's thread lists
+	ParallelRecorder mRecorder;
+	//chunk layer draws by sort key, and the same draws in the order they were queued
+	DrawQueue mDrawQueue;
+	std::vector<DrawListItem> mDrawList;
+	std::vector<DrawListItem> mQueuedDraws;
+	DrawStateCache mDrawStateCache;
+	//bindings set and skipped while drawing the last frame's draw list
+	DrawStateStats mDrawStateStats;
+	std::mutex mDrawStateStatsMutex;
+	std::vector<ID3D12CommandList*> mSubmitLists;
 
 	PassConstants mMainPassCB;
 
@@ -153,6 +309,7 @@ private:
 	float mPhi = 0.4f*XM_PI;
 	float mRadius = 2.5f;
 
+	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
 	Camera mCamera;
@@ -189,6 +346,14 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+	// "-bench" runs the headless world benchmarks instead of the game.
+	if (cmdLine != nullptr && strstr(cmdLine, "-bench") != nullptr)
+	{
+		std::ofstream out("benchmarks.txt");
+		RunBenchmarks(out);
+		return 0;
+	}
+
 	try
 	{
 		CrateApp theApp(hInstance);
@@ -228,12 +393,16 @@ bool CrateApp::Initialize()
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	LoadTextures();
 	BuildRootSignature();
+	BuildCommandSignature();
 	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
+	LoadWorld();
+	BuildQuadIndexBuffers();
 	BuildShapeGeometry();
+	BuildBlockGeometry();
 	BuildMaterials();
-	BuildRenderItems();
 	BuildFrameResources();
+	BuildRenderItems();
 	BuildPSOs();
 	//PlaySound(TEXT("water.wav"), NULL, SND_FILENAME);
 	//Play intro sound?
@@ -277,10 +446,37 @@ void CrateApp::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
+	// Meshes replaced in earlier frames can go once the GPU is past them.
+	while (!mRetiredGeometries.empty() && mRetiredGeometries.front().first <= mFence->GetCompletedValue())
+		mRetiredGeometries.pop_front();
+
+	// Lets chunks that haven't been touched for a while drop into the cold tier.
+	mWorld.Update(gt.TotalTime());
+
+	// Sends the chunks edited or changing level of detail since the last frame to the mesh workers, once each.
+	UpdateChunkLods();
+	mRemeshQueue.Submit(mWorld, mMeshWorkers);
+
+	// Snapshots dirty chunks at the frame boundary; the writing happens on the save thread.
+	// Autosave and journal compaction both write the region store, so only one of them runs
+	// at a time; otherwise an older snapshot of a chunk could land after a newer one.
+	if (!mJournal.IsCompacting() && gt.TotalTime() >= mNextAutosave && mAutosave.BeginSave(mWorld))
+	{
+		mNextAutosave = gt.TotalTime() + gAutosaveInterval;
+	}
+	else if (!mAutosave.IsSaving() && !mJournal.IsCompacting() && gt.TotalTime() >= mNextCompaction &&
+		mJournal.GetStats().LogRecords >= gJournalCompactionEdits)
+	{
+		//folds the journal into the region files in the background so it doesn't grow forever
+		mJournal.BeginCompaction(mWorld);
+		mNextCompaction = gt.TotalTime() + gJournalCompactionInterval;
+	}
+
 	AnimateMaterials(gt);
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
+	UpdateBlockInstances();
 
 	changeLightStrength(); //OISIN	
 	backColourChange(); //OISIN
@@ -440,6 +636,8 @@ void CrateApp::Draw(const GameTimer& gt)
 	ThrowIfFailed(cmdListAlloc->Reset());
 
 	//Conor: changing the pso when a key is pressed
+	//the debug psos draw every layer, the normal one starts with the opaque layer
+	bool debugPso = true;
 		if (debugMode)
 		{
 			ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mOpaquePSO["opaque_wireframe"].Get()));
@@ -456,16 +654,18 @@ void CrateApp::Draw(const GameTimer& gt)
 		//when no key is pressed change the pso bck to opaque
 		else
 		{
-			ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mOpaquePSO["transparent"].Get()));
-			DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
+			ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mOpaquePSO["opaque"].Get()));
+			debugPso = false;
 		}
 	//}
 	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
 	// Reusing the command list reuses memory.
 	/*ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), &mOpaquePSO.Get()));*/
 
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
+	// Swap in any chunk meshes rebuilt after block edits.
+	ApplyRemeshedChunks();
+	//sorting after the swap, so chunks remeshed this frame don't go a frame without water
+	UpdateTranslucentOrder();
 
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -481,29 +681,61 @@ void CrateApp::Draw(const GameTimer& gt)
 	// Clear the back buffer and depth buffer.
 	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-	// Specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
-
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	SetDrawTargets(mCommandList.Get());
 
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+	//the indirect mode submits every layer from the argument buffer
+	bool indirect = indirectDraws && !debugPso;
+	//the parallel mode records the same layers into thread lists submitted after this one
+	bool parallel = parallelRecording && !debugPso && !indirect && !instancedBlocks;
+	std::size_t threadLists = 0;
+	if (parallel)
+	{
+		threadLists = RecordLayersInParallel();
+	}
+	else if (indirect)
+	{
+		DrawIndirect(mCommandList.Get());
+	}
+	//the instanced path replaces the opaque and cutout chunk meshes, water still comes from the sorted meshes
+	else if (instancedBlocks && !debugPso)
+	{
+		DrawBlockInstances(mCommandList.Get());
+	}
+	else
+	{
+		//every chunk layer from the sorted draw list, setting only the bindings that change
+		BuildDrawList(debugPso);
+		mDrawStateCache.Reset();
+		mDrawStateCache.ResetStats();
+		DrawList(mCommandList.Get(), 0, mDrawList.size(), mDrawStateCache);
+		mDrawStateStats = mDrawStateCache.GetStats();
+	}
 
-	DrawRenderItems(mCommandList.Get(), mOpaqueRitems);
+	//water is blended over the instanced blocks back to front
+	if (instancedBlocks && !debugPso && !indirect && !parallel)
+	{
+		mCommandList->SetPipelineState(mOpaquePSO["transparent"].Get());
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
+	}
 
 	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	// The last thread list does it when there is one.
+	if (threadLists == 0)
+	{
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	}
 
 	// Done recording commands.
 	ThrowIfFailed(mCommandList->Close());
 
-	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	// Add the command list to the queue for execution, then the thread lists in draw order.
+	mSubmitLists.clear();
+	mSubmitLists.push_back(mCommandList.Get());
+	RecordingList* const* lists = mCurrFrameResource->ThreadCmdLists.Acquire(threadLists);
+	for (std::size_t i = 0; i < threadLists; i++)
+		mSubmitLists.push_back(static_cast<FrameCommandList*>(lists[i])->Get());
+	mCommandQueue->ExecuteCommandLists((UINT)mSubmitLists.size(), mSubmitLists.data());
 
 	// Swap the back and front buffers
 	ThrowIfFailed(mSwapChain->Present(0, 0));
@@ -523,6 +755,10 @@ void CrateApp::OnMouseDown(WPARAM btnState, int x, int y)
 	mLastMousePos.x = x;
 	mLastMousePos.y = y;
 
+	//right click digs out the block in the middle of the screen, shift + right click builds stone against it
+	if ((btnState & MK_RBUTTON) != 0)
+		PickBlock((GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0);
+
 	SetCapture(mhMainWnd);
 }
 
@@ -642,6 +878,24 @@ void CrateApp::OnKeyboardInput(const GameTimer& gt)
 	else
 		cullNone = false;
 
+	//holding 4 draws the blocks as instanced cubes, one draw per block type
+	if (GetAsyncKeyState('4') & 0x8000)
+		instancedBlocks = true;
+	else
+		instancedBlocks = false;
+
+	//holding 5 submits the chunk meshes with ExecuteIndirect instead of a draw each
+	if (GetAsyncKeyState('5') & 0x8000)
+		indirectDraws = true;
+	else
+		indirectDraws = false;
+
+	//holding 6 records the chunk layers on worker threads, one command list each
+	if (GetAsyncKeyState('6') & 0x8000)
+		parallelRecording = true;
+	else
+		parallelRecording = false;
+
 	mCamera.UpdateViewMatrix();
 }
 
@@ -667,7 +921,7 @@ void CrateApp::AnimateMaterials(const GameTimer& gt)
 	// Scroll the water material texture coordinates.
 
 	//Get the material
-	auto waterMat = mMaterials["water"].get();
+	auto waterMat = mBlockMaterials[(int)BlockId::Water];
 
 	//Move the texture
 	float& a = waterMat->MatTransform(3, 0);
@@ -887,18 +1141,23 @@ void CrateApp::BuildRootSignature()
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[7];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[1].InitAsConstantBufferView(0);
 	slotRootParameter[2].InitAsConstantBufferView(1);
 	slotRootParameter[3].InitAsConstantBufferView(2);
+	//instance buffer of the instanced block path
+	slotRootParameter[4].InitAsShaderResourceView(1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	//chunk slot set by each indirect command, and the object constants read as a structured buffer
+	slotRootParameter[5].InitAsConstants(1, 3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[6].InitAsShaderResourceView(2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
 	auto staticSamplers = GetStaticSamplers();
 
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -921,6 +1180,28 @@ void CrateApp::BuildRootSignature()
 		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
 }
 
+void CrateApp::BuildCommandSignature()
+{
+	//each command sets the chunk's buffers and object slot, then draws; the layout is IndirectCommand's
+	D3D12_INDIRECT_ARGUMENT_DESC args[4] = {};
+	args[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+	args[0].VertexBuffer.Slot = 0;
+	args[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+	args[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	args[2].Constant.RootParameterIndex = 5;
+	args[2].Constant.DestOffsetIn32BitValues = 0;
+	args[2].Constant.Num32BitValuesToSet = 1;
+	args[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC desc = {};
+	desc.ByteStride = sizeof(IndirectCommand);
+	desc.NumArgumentDescs = _countof(args);
+	desc.pArgumentDescs = args;
+
+	//changing root arguments needs the root signature they belong to
+	ThrowIfFailed(md3dDevice->CreateCommandSignature(&desc, mRootSignature.Get(), IID_PPV_ARGS(&mChunkCommandSignature)));
+}
+
 //Conor
 void CrateApp::BuildDescriptorHeaps()
 {
@@ -1104,6 +1385,9 @@ void CrateApp::BuildShadersAndInputLayout()
 	};
 
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_0");
+	mShaders["chunkVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "ChunkVS", "vs_5_0");
+	mShaders["blockVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "BlockVS", "vs_5_0");
+	mShaders["chunkIndirectVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "ChunkIndirectVS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_0");
 	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_0");
 
@@ -1113,59 +1397,200 @@ void CrateApp::BuildShadersAndInputLayout()
 		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+
+	mChunkInputLayout =
+	{
+		{ "PACKED", 0, DXGI_FORMAT_R32G32_UINT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
+	mVoxelInputLayout =
+	{
+		{ "CORNER", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R8G8_UINT, 0, 4, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
 }
 
 void CrateApp::BuildShapeGeometry()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//meshing every chunk on the worker threads at the level of detail for the camera and uploading each mesh as soon as it is done
+	mWorld.ForEachChunk([&](const Chunk& chunk) { mRemeshQueue.MarkChunkDirty(chunk.GetCoord()); });
+	UpdateChunkLods();
+	mRemeshQueue.Submit(mWorld, mMeshWorkers);
+
+	std::size_t triangles = 0;
+	std::size_t vertexCount = 0;
+	std::size_t coarseChunks = 0;
+	ChunkMesh mesh;
+	while (mMeshWorkers.GetPendingCount() > 0)
+	{
+		if (!mMeshWorkers.PopCompleted(mesh))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		mRemeshQueue.Completed(mesh.Coord);
+		if (mesh.IsEmpty())
+			continue;
+
+		UploadChunkMesh(mesh);
+		triangles += mesh.GetTriangleCount();
+		vertexCount += mesh.GetVertexCount();
+		if (mesh.Lod > 0)
+			coarseChunks++;
+	}
+
+	double meshMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = 0;
-	boxSubmesh.BaseVertexLocation = 0;
+	//what per-chunk 32-bit index buffers used to take on the gpu, in the cpu copy and in the upload heap
+	std::size_t indexBytesSaved = triangles * 3 * sizeof(std::uint32_t) * 3;
 
+	std::wstring text = L"***Meshes: chunks = " + std::to_wstring(mChunkGeometries.size()) +
+		L" coarse chunks = " + std::to_wstring(coarseChunks) +
+		L" triangles = " + std::to_wstring(triangles) +
+		L" index bytes saved = " + std::to_wstring(indexBytesSaved) +
+		L" vertices = " + std::to_wstring(vertexCount) +
+		L" workers = " + std::to_wstring(mMeshWorkers.GetThreadCount()) +
+		L" mesh ms = " + std::to_wstring(meshMs) + L"\n";
+	OutputDebugString(text.c_str());
+}
 
-	std::vector<Vertex> vertices(box.Vertices.size());
+MeshGeometry* CrateApp::UploadChunkMesh(const ChunkMesh& mesh)
+{
+	//one buffer of exposed faces per chunk, with a submesh per block material
+	const ChunkCoord& c = mesh.Coord;
+	std::vector<ChunkVertex> vertices;
+	std::size_t maxPartQuads = 0;
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "chunk " + std::to_string(c.X) + " " + std::to_string(c.Y) + " " + std::to_string(c.Z);
 
-	for (size_t i = 0; i < box.Vertices.size(); ++i)
+	//every part draws from the start of the shared quad indices, offset by its base vertex
+	for (const ChunkMeshPart& part : mesh.Parts)
 	{
-		vertices[i].Pos = box.Vertices[i].Position;
-		vertices[i].Normal = box.Vertices[i].Normal;
-		vertices[i].TexC = box.Vertices[i].TexC;
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)part.GetQuadCount() * 6;
+		submesh.StartIndexLocation = 0;
+		submesh.BaseVertexLocation = (INT)vertices.size();
+		geo->DrawArgs[GetBlockInfo(part.Block).Name] = submesh;
+
+		vertices.insert(vertices.end(), part.Vertices.begin(), part.Vertices.end());
+		maxPartQuads = std::max(maxPartQuads, part.GetQuadCount());
 	}
 
-	std::vector<std::uint16_t> indices = box.GetIndices16();
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(ChunkVertex);
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+
+	geo->VertexByteStride = sizeof(ChunkVertex);
+	geo->VertexBufferByteSize = vbByteSize;
+
+	//no index data of its own, just a reference to the shared buffer
+	MeshGeometry* quadIndices = GetQuadIndexBuffer(maxPartQuads);
+	geo->IndexBufferGPU = quadIndices->IndexBufferGPU;
+	geo->IndexFormat = quadIndices->IndexFormat;
+	geo->IndexBufferByteSize = quadIndices->IndexBufferByteSize;
+
+	MeshGeometry* result = geo.get();
+	mChunkGeometries[PackChunkCoord(c)] = result;
+	mGeometries[geo->Name] = std::move(geo);
+
+	//translucent quads are also kept on the cpu to be drawn back to front
+	mTranslucentSorter.SetChunk(mesh);
+	return result;
+}
+
+void CrateApp::BuildQuadIndexBuffers()
+{
+	//every chunk part fits 16-bit indices, as it can't have more than MaxChunkPartQuads quads
+	std::vector<std::uint16_t> indices;
+	BuildQuadIndices(MaxQuads16, indices);
+	mQuadIndices16 = CreateQuadIndexBuffer("quad indices 16", indices.data(),
+		(UINT)(indices.size() * sizeof(std::uint16_t)), DXGI_FORMAT_R16_UINT);
+}
+
+std::unique_ptr<MeshGeometry> CrateApp::CreateQuadIndexBuffer(const std::string& name, const void* indices, UINT byteSize, DXGI_FORMAT format)
+{
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), indices, byteSize, geo->IndexBufferUploader);
+	geo->IndexFormat = format;
+	geo->IndexBufferByteSize = byteSize;
+	return geo;
+}
+
+MeshGeometry* CrateApp::GetQuadIndexBuffer(std::size_t quadCount)
+{
+	if (quadCount <= MaxQuads16)
+		return mQuadIndices16.get();
+
+	//grown on demand; meshes using an older one keep its buffer alive through their own reference
+	std::size_t capacity = mQuadIndices32 ? mQuadIndices32->IndexBufferByteSize / (6 * sizeof(std::uint32_t)) : 0;
+	if (quadCount > capacity)
+	{
+		if (mQuadIndices32)
+			mRetiredGeometries.emplace_back(mCurrentFence, std::move(mQuadIndices32));
+
+		std::vector<std::uint32_t> indices;
+		BuildQuadIndices(std::max(quadCount, capacity * 2), indices);
+		mQuadIndices32 = CreateQuadIndexBuffer("quad indices 32", indices.data(),
+			(UINT)(indices.size() * sizeof(std::uint32_t)), DXGI_FORMAT_R32_UINT);
+	}
+	return mQuadIndices32.get();
+}
+
+void CrateApp::BuildBlockGeometry()
+{
+	//the unit cube every block of the instanced path is drawn with
+	GeometryGenerator geoGen;
+	GeometryGenerator::VoxelMeshData cube = geoGen.CreateVoxelFaces();
+
+	//the faces index their own four vertices, so they are rebased to draw the whole cube at once
+	std::vector<std::uint16_t> indices;
+	for (const GeometryGenerator::VoxelSubmesh& face : cube.Faces)
+	{
+		for (UINT i = 0; i < face.IndexCount; i++)
+			indices.push_back((std::uint16_t)(cube.Indices[face.StartIndexLocation + i] + face.BaseVertexLocation));
+	}
+
+	const UINT vbByteSize = (UINT)cube.Vertices.size() * sizeof(GeometryGenerator::VoxelVertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "boxGeo";
+	geo->Name = "blockGeo";
 
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), cube.Vertices.data(), vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		mCommandList.Get(), cube.Vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexByteStride = sizeof(GeometryGenerator::VoxelVertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	geo->DrawArgs["box"] = boxSubmesh;
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)indices.size();
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
+	geo->DrawArgs["cube"] = submesh;
 
 	mGeometries[geo->Name] = std::move(geo);
 }
 
-//Conor
 void CrateApp::BuildPSOs()
 {
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
@@ -1174,12 +1599,13 @@ void CrateApp::BuildPSOs()
 	// PSO for opaque objects.
 	//
 	ZeroMemory(&opaquePsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-	opaquePsoDesc.InputLayout = { mInputLayout.data(), (UINT)mInputLayout.size() };
+	//the world is all chunk meshes, which use the packed vertex
+	opaquePsoDesc.InputLayout = { mChunkInputLayout.data(), (UINT)mChunkInputLayout.size() };
 	opaquePsoDesc.pRootSignature = mRootSignature.Get();
 	opaquePsoDesc.VS =
 	{
-		reinterpret_cast<BYTE*>(mShaders["standardVS"]->GetBufferPointer()),
-		mShaders["standardVS"]->GetBufferSize()
+		reinterpret_cast<BYTE*>(mShaders["chunkVS"]->GetBufferPointer()),
+		mShaders["chunkVS"]->GetBufferSize()
 	};
 	opaquePsoDesc.PS =
 	{
@@ -1217,6 +1643,31 @@ void CrateApp::BuildPSOs()
 	opaqueCullNonePsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueCullNonePsoDesc, IID_PPV_ARGS(&mOpaquePSO["opaque_cullnone"])));
 
+	//pso for cutout blocks, two sided so the far faces show through the holes
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC alphaTestedPsoDesc = opaquePsoDesc;
+	alphaTestedPsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["alphaTestedPS"]->GetBufferPointer()),
+		mShaders["alphaTestedPS"]->GetBufferSize()
+	};
+	alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, IID_PPV_ARGS(&mOpaquePSO["alphaTested"])));
+
+	//psos for the instanced block path, which draws the voxel cube instead of chunk meshes
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC blockPsoDesc = opaquePsoDesc;
+	blockPsoDesc.InputLayout = { mVoxelInputLayout.data(), (UINT)mVoxelInputLayout.size() };
+	blockPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["blockVS"]->GetBufferPointer()),
+		mShaders["blockVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&blockPsoDesc, IID_PPV_ARGS(&mOpaquePSO["block"])));
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC blockAlphaTestedPsoDesc = alphaTestedPsoDesc;
+	blockAlphaTestedPsoDesc.InputLayout = blockPsoDesc.InputLayout;
+	blockAlphaTestedPsoDesc.VS = blockPsoDesc.VS;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&blockAlphaTestedPsoDesc, IID_PPV_ARGS(&mOpaquePSO["blockAlphaTested"])));
+
 	//pso for blending
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentPsoDesc = opaquePsoDesc;
 	D3D12_RENDER_TARGET_BLEND_DESC transparencyBlendDesc;
@@ -1233,6 +1684,24 @@ void CrateApp::BuildPSOs()
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mOpaquePSO["transparent"])));
 
+	//the same three for indirect draws, which find their chunk through the root constant
+	D3D12_SHADER_BYTECODE chunkIndirectVS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["chunkIndirectVS"]->GetBufferPointer()),
+		mShaders["chunkIndirectVS"]->GetBufferSize()
+	};
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueIndirectPsoDesc = opaquePsoDesc;
+	opaqueIndirectPsoDesc.VS = chunkIndirectVS;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueIndirectPsoDesc, IID_PPV_ARGS(&mOpaquePSO["opaqueIndirect"])));
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC alphaTestedIndirectPsoDesc = alphaTestedPsoDesc;
+	alphaTestedIndirectPsoDesc.VS = chunkIndirectVS;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&alphaTestedIndirectPsoDesc, IID_PPV_ARGS(&mOpaquePSO["alphaTestedIndirect"])));
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentIndirectPsoDesc = transparentPsoDesc;
+	transparentIndirectPsoDesc.VS = chunkIndirectVS;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentIndirectPsoDesc, IID_PPV_ARGS(&mOpaquePSO["transparentIndirect"])));
+
 }
 
 void CrateApp::BuildFrameResources()
@@ -1240,7 +1709,8 @@ void CrateApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+			1, gMaxChunkObjects, (UINT)mMaterials.size(), gMaxTranslucentIndices, gMaxBlockInstances,
+			gMaxIndirectCommands, gMaxIndirectGroups));
 	}
 }
 
@@ -1250,8 +1720,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the dirt block which sets the physical properties of the block
 	auto dirt = std::make_unique<Material>();
 	dirt->Name = "dirt";
-	dirt->MatCBIndex = 0;
-	dirt->DiffuseSrvHeapIndex = 0;
+	dirt->MatCBIndex = GetBlockInfo(BlockId::Dirt).MatCBIndex;
+	dirt->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Dirt).DiffuseSrvHeapIndex;
 	dirt->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	dirt->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	dirt->Roughness = 0.2f;
@@ -1261,8 +1731,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the bedrock block which sets the physical properties of the block
 	auto bedrock = std::make_unique<Material>();
 	bedrock->Name = "bedrock";
-	bedrock->MatCBIndex = 1;
-	bedrock->DiffuseSrvHeapIndex = 1;
+	bedrock->MatCBIndex = GetBlockInfo(BlockId::Bedrock).MatCBIndex;
+	bedrock->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Bedrock).DiffuseSrvHeapIndex;
 	bedrock->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	bedrock->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	bedrock->Roughness = 0.2f;
@@ -1272,8 +1742,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the stone block which sets the physical properties of the block
 	auto stone = std::make_unique<Material>();
 	stone->Name = "stone";
-	stone->MatCBIndex = 2;
-	stone->DiffuseSrvHeapIndex = 2;
+	stone->MatCBIndex = GetBlockInfo(BlockId::Stone).MatCBIndex;
+	stone->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Stone).DiffuseSrvHeapIndex;
 	stone->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	stone->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	stone->Roughness = 0.2f;
@@ -1283,8 +1753,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the grass block which sets the physical properties of the block
 	auto grass = std::make_unique<Material>();
 	grass->Name = "grass";
-	grass->MatCBIndex = 3;
-	grass->DiffuseSrvHeapIndex = 3;
+	grass->MatCBIndex = GetBlockInfo(BlockId::Grass).MatCBIndex;
+	grass->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Grass).DiffuseSrvHeapIndex;
 	grass->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	grass->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	grass->Roughness = 0.2f;
@@ -1294,8 +1764,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the wood block which sets the physical properties of the block
 	auto wood = std::make_unique<Material>();
 	wood->Name = "wood";
-	wood->MatCBIndex = 4;
-	wood->DiffuseSrvHeapIndex = 4;
+	wood->MatCBIndex = GetBlockInfo(BlockId::Wood).MatCBIndex;
+	wood->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Wood).DiffuseSrvHeapIndex;
 	wood->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	wood->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	wood->Roughness = 0.2f;
@@ -1305,8 +1775,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the leaves block which sets the physical properties of the block
 	auto leaves = std::make_unique<Material>();
 	leaves->Name = "leaves";
-	leaves->MatCBIndex = 5;
-	leaves->DiffuseSrvHeapIndex = 5;
+	leaves->MatCBIndex = GetBlockInfo(BlockId::Leaves).MatCBIndex;
+	leaves->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Leaves).DiffuseSrvHeapIndex;
 	leaves->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	leaves->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	leaves->Roughness = 0.2f;
@@ -1316,8 +1786,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the iron block which sets the physical properties of the block
 	auto iron = std::make_unique<Material>();
 	iron->Name = "iron";
-	iron->MatCBIndex = 6;
-	iron->DiffuseSrvHeapIndex = 6;
+	iron->MatCBIndex = GetBlockInfo(BlockId::Iron).MatCBIndex;
+	iron->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Iron).DiffuseSrvHeapIndex;
 	iron->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	iron->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	iron->Roughness = 0.2f;
@@ -1327,8 +1797,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the gravel block which sets the physical properties of the block
 	auto gravel = std::make_unique<Material>();
 	gravel->Name = "gravel";
-	gravel->MatCBIndex = 7;
-	gravel->DiffuseSrvHeapIndex = 7;
+	gravel->MatCBIndex = GetBlockInfo(BlockId::Gravel).MatCBIndex;
+	gravel->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Gravel).DiffuseSrvHeapIndex;
 	gravel->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	gravel->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	gravel->Roughness = 0.2f;
@@ -1338,8 +1808,8 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the sand block which sets the physical properties of the block
 	auto sand = std::make_unique<Material>();
 	sand->Name = "sand";
-	sand->MatCBIndex = 8;
-	sand->DiffuseSrvHeapIndex = 8;
+	sand->MatCBIndex = GetBlockInfo(BlockId::Sand).MatCBIndex;
+	sand->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Sand).DiffuseSrvHeapIndex;
 	sand->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	sand->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	sand->Roughness = 0.2f;
@@ -1349,753 +1819,323 @@ void CrateApp::BuildMaterials()
 	//Creating the material for the water block which sets the physical properties of the block
 	auto water = std::make_unique<Material>();
 	water->Name = "water";
-	water->MatCBIndex = 9;
-	water->DiffuseSrvHeapIndex = 9;
+	water->MatCBIndex = GetBlockInfo(BlockId::Water).MatCBIndex;
+	water->DiffuseSrvHeapIndex = GetBlockInfo(BlockId::Water).DiffuseSrvHeapIndex;
 	water->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	water->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	water->Roughness = 0.2f;
 
 	mMaterials["water"] = std::move(water);
+
+	//caching the material of each block type so per-block code never hashes a name
+	for (int i = 1; i < gNumBlockTypes; i++)
+		mBlockMaterials[i] = mMaterials[GetBlockInfo((BlockId)i).Name].get();
+
+	mMaterialsByCBIndex.resize(mMaterials.size());
+	for (auto& e : mMaterials)
+		mMaterialsByCBIndex[e.second->MatCBIndex] = e.second.get();
 }
 
 //Conor
+void CrateApp::LoadWorld()
+{
+	//loading the saved map if there is one
+	const int mapSize = 100;
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	std::size_t loadedChunks = mRegionStore.LoadArea(mWorld, ChunkCoord{ 0, 0, 0 },
+		ChunkCoord{ (mapSize - 1) >> ChunkShift, RegionHeight - 1, (mapSize - 1) >> ChunkShift });
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+
+	WorldGenStats genStats;
+	if (loadedChunks > 0)
+	{
+		genStats.BlockCount = mWorld.GetSolidBlockCount();
+		genStats.ChunkCount = mWorld.GetChunkCount();
+		genStats.MemoryBytes = mWorld.GetMemoryUsage();
+
+		std::wstring text = L"***Regions: loaded chunks = " + std::to_wstring(loadedChunks) +
+			L" corrupt chunks = " + std::to_wstring(mRegionStore.GetStats().CorruptChunks) +
+			L" load ms = " + std::to_wstring(loadMs) + L"\n";
+		OutputDebugString(text.c_str());
+	}
+	else
+	{
+		//creating a timer to read in current time and setting the seed for rand function so that a random map is generated the first time
+		GameTimer gt;
+		genStats = GenerateDefaultMap(mWorld, (unsigned int)gt.CurrTime(), mapSize);
+
+		auto saveStart = std::chrono::high_resolution_clock::now();
+		mRegionStore.SaveWorld(mWorld);
+		mRegionStore.Flush();
+		double saveMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - saveStart).count();
+
+		std::wstring text = L"***Regions: saved chunks = " + std::to_wstring(mRegionStore.GetStats().ChunksSaved) +
+			L" save ms = " + std::to_wstring(saveMs) + L"\n";
+		OutputDebugString(text.c_str());
+	}
+
+	//applying any edits the last run didn't get to save
+	mJournal.Open(mWorld);
+	std::wstring journalText = L"***Journal: replayed edits = " + std::to_wstring(mJournal.GetStats().Replayed) +
+		L" torn batches = " + std::to_wstring(mJournal.GetStats().TornBatches) +
+		L" failed compactions = " + std::to_wstring(mJournal.GetStats().FailedCompactions) + L"\n";
+	OutputDebugString(journalText.c_str());
+
+	//built once the world is final; SetBlock keeps it up to date a chunk at a time
+	mOctree.Build(mWorld);
+
+	std::wstring worldText = L"***World: blocks = " + std::to_wstring(genStats.BlockCount) +
+		L" chunks = " + std::to_wstring(genStats.ChunkCount) +
+		L" bytes/block = " + std::to_wstring((double)genStats.MemoryBytes / genStats.BlockCount) +
+		L" generation ms = " + std::to_wstring(genStats.GenerationMs) + L"\n";
+	OutputDebugString(worldText.c_str());
+}
+
 void CrateApp::BuildRenderItems()
 {
-	//auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
-	//creating a timer to read in current time and setting the seed for rand function so that a random map is generated each time
-	GameTimer gt;
-	srand((int)gt.CurrTime());
-
-	//setting a variable to control the amount of trees that increments every time a tree spawns
-	int treeCount = 0;
-	int index = 0, random = 0;
-
-	//creating a bool array to store the trees x z coordinates so that i can prevent trees spawning too close that the leaves overlap
-	//50x50 so trees only spawn in the grass quadrant of the map
-	bool ar1[80][50][50];
-	for (int i = 0; i < 80; i++) {
-		for (int j = 0; j < 50; j++) {
-			for (int k = 0; k < 50; k++) {
-				//setting all the values to false as no trees have spawned yet, when set to true a tree cant spawn beside it
-				//i is the amount of trees allowed to spawn, it is the index number
-				//j is the x coordinate of the tree position, it will store true if there is a wood or leaves block on it
-				//k is the z coordinate of the tree position, it will store true if there is a wood or leaves block on it
-				ar1[i][j][k] = false;
-			}
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (auto& e : mChunkGeometries)
+		BuildChunkRenderItems(UnpackChunkCoord(e.first), e.second);
+
+	double ritemMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::wstring text = L"***RenderItems: count = " + std::to_wstring(mAllRitems.size()) +
+		L" build ms = " + std::to_wstring(ritemMs) + L"\n";
+	OutputDebugString(text.c_str());
+
+	isBuilt = true;
+}
+
+void CrateApp::BuildChunkRenderItems(const ChunkCoord& c, MeshGeometry* geo)
+{
+	//every material of a chunk shares the chunk's object constants, so a remesh never needs a new slot
+	std::uint64_t key = PackChunkCoord(c);
+	auto slot = mChunkObjCBIndices.find(key);
+	if (slot == mChunkObjCBIndices.end())
+	{
+		if (mChunkObjCBIndices.size() >= gMaxChunkObjects)
+		{
+			OutputDebugString(L"***RenderItems: out of chunk object constant buffer slots\n");
+			return;
 		}
+		slot = mChunkObjCBIndices.emplace(key, (UINT)mChunkObjCBIndices.size()).first;
+
+		//a new slot isn't read by any frame in flight, so every frame resource can be filled now
+		ObjectConstants objConstants;
+		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(XMMatrixTranslation(
+			(float)(c.X * ChunkSize), (float)(c.Y * ChunkSize), (float)(c.Z * ChunkSize))));
+		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(XMMatrixIdentity()));
+		for (auto& frameResource : mFrameResources)
+			frameResource->ObjectCB->CopyData(slot->second, objConstants);
 	}
-	//mCommandList->Reset(cmdListAlloc.Get(), mOpaquePSO["transparent"].Get());
-	//grass qaudrant generation 50 x 50 
-	for (int z = 0; z < 50; z++) {
-		for (int x = 0; x < 50; x++) {
-
-			//creating random number between 1 and 2 to randomize the height of y
-			random = rand() % 2 + 1;
-			for (int y = 0; y < random + 8; y++) {
-				//cheking to see if y is at the bottom so that it spawns bedrock
-				if (y == 0)
-				{
-					//creating a bedrock block at position x,y,z
-					auto boxR2item = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxR2item->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxR2item->ObjCBIndex = index;
-					boxR2item->Mat = mMaterials["bedrock"].get();
-					boxR2item->Geo = mGeometries["boxGeo"].get();
-					boxR2item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxR2item->IndexCount = boxR2item->Geo->DrawArgs["box"].IndexCount;
-					boxR2item->StartIndexLocation = boxR2item->Geo->DrawArgs["box"].StartIndexLocation;
-					boxR2item->BaseVertexLocation = boxR2item->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxR2item));
-					index++;
-				}
-				//creating a layer in a low range so only stone, gravel and iron spawn
-				else if (y > 0 && y < 4)
-				{
-					//creating a random number between 1 and 5 and spawning a gravel block when it equals 2 so there is a 1 in 5 chance to spawn gravel
-					if (rand() % 5 + 1 == 2) {
-						//creating a gravel block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["gravel"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-					//creating a random number between 1 and 10 and spawning a iron block when it equals 2 so there is a 1 in 10 chance to spawn iron
-					else if (rand() % 10 + 1 == 2) {
-						//creating a iron block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["iron"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-					//making the rest of the blocks in this range to stone
-					else {
-						//creating a stone block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["stone"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-				}
-				//cheking if the y value is on the top row to spawn grass
-				else if ((random == 2 && y == 9) || (random == 1 && y == 8)) {
-					//creating a grass block at position x,y,z
-					auto boxRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxRitem->ObjCBIndex = index;
-					boxRitem->Mat = mMaterials["grass"].get();
-					boxRitem->Geo = mGeometries["boxGeo"].get();
-					boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-					boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-					boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxRitem));
-					index++;
-
-				}
-				//making every other block in this range dirt
-				else {
-					//creating a dirt block at position x,y,z
-					auto boxRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxRitem->ObjCBIndex = index;
-					boxRitem->Mat = mMaterials["dirt"].get();
-					boxRitem->Geo = mGeometries["boxGeo"].get();
-					boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-					boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-					boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxRitem));
-					index++;
-				}
-			}
 
-			//checking if there are 80 trees already made
-			if (treeCount < 80) {
-				//creating random number so tree spawns randomly
-				if (rand() % 20 == 4) {
-					//cycle ethrough xz coordinates in grass quadrant
-					if (x > 0 && x < 50) {
-						if (z > 0 && z < 50) {
-							//setting variable to false then searching if there is a tree already in the area
-							bool isTree = false;
-							for (int a = 0; a < 80; a++) {
-								if (ar1[a][x][z]) {
-									isTree = true;
-								}
-							}
-							//if there is no tree, build one
-							if (!isTree) {
-								// creating all the tree blocks including wood and leaves
-								auto boxRitem = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)random + 8, (float)z));
-								boxRitem->ObjCBIndex = index;
-								boxRitem->Mat = mMaterials["wood"].get();
-								boxRitem->Geo = mGeometries["boxGeo"].get();
-								boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-								boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-								boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxRitem));
-								index++;
-
-								auto boxR2item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR2item->World, XMMatrixTranslation((float)x, (float)random + 9, (float)z));
-								boxR2item->ObjCBIndex = index;
-								boxR2item->Mat = mMaterials["wood"].get();
-								boxR2item->Geo = mGeometries["boxGeo"].get();
-								boxR2item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR2item->IndexCount = boxR2item->Geo->DrawArgs["box"].IndexCount;
-								boxR2item->StartIndexLocation = boxR2item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR2item->BaseVertexLocation = boxR2item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR2item));
-								index++;
-
-								auto boxR3item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR3item->World, XMMatrixTranslation((float)x, (float)random + 10, (float)z));
-								boxR3item->ObjCBIndex = index;
-								boxR3item->Mat = mMaterials["wood"].get();
-								boxR3item->Geo = mGeometries["boxGeo"].get();
-								boxR3item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR3item->IndexCount = boxR3item->Geo->DrawArgs["box"].IndexCount;
-								boxR3item->StartIndexLocation = boxR3item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR3item->BaseVertexLocation = boxR3item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR3item));
-								index++;
-
-								auto boxR4item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR4item->World, XMMatrixTranslation((float)x + 1, (float)random + 10, (float)z));
-								boxR4item->ObjCBIndex = index;
-								boxR4item->Mat = mMaterials["leaves"].get();
-								boxR4item->Geo = mGeometries["boxGeo"].get();
-								boxR4item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR4item->IndexCount = boxR4item->Geo->DrawArgs["box"].IndexCount;
-								boxR4item->StartIndexLocation = boxR4item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR4item->BaseVertexLocation = boxR4item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR4item));
-								index++;
-
-								auto boxR5item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR5item->World, XMMatrixTranslation((float)x + 1, (float)random + 10, (float)z + 1));
-								boxR5item->ObjCBIndex = index;
-								boxR5item->Mat = mMaterials["leaves"].get();
-								boxR5item->Geo = mGeometries["boxGeo"].get();
-								boxR5item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR5item->IndexCount = boxR5item->Geo->DrawArgs["box"].IndexCount;
-								boxR5item->StartIndexLocation = boxR5item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR5item->BaseVertexLocation = boxR5item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR5item));
-								index++;
-
-								auto boxR6item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR6item->World, XMMatrixTranslation((float)x, (float)random + 10, (float)z + 1));
-								boxR6item->ObjCBIndex = index;
-								boxR6item->Mat = mMaterials["leaves"].get();
-								boxR6item->Geo = mGeometries["boxGeo"].get();
-								boxR6item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR6item->IndexCount = boxR6item->Geo->DrawArgs["box"].IndexCount;
-								boxR6item->StartIndexLocation = boxR6item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR6item->BaseVertexLocation = boxR6item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR6item));
-								index++;
-
-								auto boxR7item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR7item->World, XMMatrixTranslation((float)x - 1, (float)random + 10, (float)z + 1));
-								boxR7item->ObjCBIndex = index;
-								boxR7item->Mat = mMaterials["leaves"].get();
-								boxR7item->Geo = mGeometries["boxGeo"].get();
-								boxR7item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR7item->IndexCount = boxR7item->Geo->DrawArgs["box"].IndexCount;
-								boxR7item->StartIndexLocation = boxR7item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR7item->BaseVertexLocation = boxR7item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR7item));
-								index++;
-
-								auto boxR8item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR8item->World, XMMatrixTranslation((float)x - 1, (float)random + 10, (float)z));
-								boxR8item->ObjCBIndex = index;
-								boxR8item->Mat = mMaterials["leaves"].get();
-								boxR8item->Geo = mGeometries["boxGeo"].get();
-								boxR8item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR8item->IndexCount = boxR8item->Geo->DrawArgs["box"].IndexCount;
-								boxR8item->StartIndexLocation = boxR8item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR8item->BaseVertexLocation = boxR8item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR8item));
-								index++;
-
-								auto boxR9item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR9item->World, XMMatrixTranslation((float)x - 1, (float)random + 10, (float)z - 1));
-								boxR9item->ObjCBIndex = index;
-								boxR9item->Mat = mMaterials["leaves"].get();
-								boxR9item->Geo = mGeometries["boxGeo"].get();
-								boxR9item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR9item->IndexCount = boxR9item->Geo->DrawArgs["box"].IndexCount;
-								boxR9item->StartIndexLocation = boxR9item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR9item->BaseVertexLocation = boxR9item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR9item));
-								index++;
-
-								auto boxR10item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR10item->World, XMMatrixTranslation((float)x, (float)random + 10, (float)z - 1));
-								boxR10item->ObjCBIndex = index;
-								boxR10item->Mat = mMaterials["leaves"].get();
-								boxR10item->Geo = mGeometries["boxGeo"].get();
-								boxR10item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR10item->IndexCount = boxR10item->Geo->DrawArgs["box"].IndexCount;
-								boxR10item->StartIndexLocation = boxR10item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR10item->BaseVertexLocation = boxR10item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR10item));
-								index++;
-
-								auto boxR11item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR11item->World, XMMatrixTranslation((float)x + 1, (float)random + 10, (float)z - 1));
-								boxR11item->ObjCBIndex = index;
-								boxR11item->Mat = mMaterials["leaves"].get();
-								boxR11item->Geo = mGeometries["boxGeo"].get();
-								boxR11item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR11item->IndexCount = boxR11item->Geo->DrawArgs["box"].IndexCount;
-								boxR11item->StartIndexLocation = boxR11item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR11item->BaseVertexLocation = boxR11item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR11item));
-								index++;
-
-								auto boxR12item = std::make_unique<RenderItem>();
-								XMStoreFloat4x4(&boxR12item->World, XMMatrixTranslation((float)x, (float)random + 11, (float)z));
-								boxR12item->ObjCBIndex = index;
-								boxR12item->Mat = mMaterials["leaves"].get();
-								boxR12item->Geo = mGeometries["boxGeo"].get();
-								boxR12item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-								boxR12item->IndexCount = boxR12item->Geo->DrawArgs["box"].IndexCount;
-								boxR12item->StartIndexLocation = boxR12item->Geo->DrawArgs["box"].StartIndexLocation;
-								boxR12item->BaseVertexLocation = boxR12item->Geo->DrawArgs["box"].BaseVertexLocation;
-								mAllRitems.push_back(std::move(boxR12item));
-								index++;
-
-								//adding 1 to the tree count
-								treeCount++;
-								//setting the bool array to true in the xz coordinates area that the tree encompases
-								for (int i = z + 2; i > z - 1; i--) {
-									for (int j = x - 2; j < x + 3; j++) {
-										ar1[treeCount][j][i] = true;
-									}
-								}
-
-							}
-						}
-					}
-				}
-
-			}
+	//creating a render item for each block material in the chunk mesh
+	for (int i = 1; i < gNumBlockTypes; i++)
+	{
+		auto it = geo->DrawArgs.find(GetBlockInfo((BlockId)i).Name);
+		if (it == geo->DrawArgs.end())
+			continue;
+
+		auto chunkRitem = std::make_unique<RenderItem>();
+		XMStoreFloat4x4(&chunkRitem->World, XMMatrixTranslation(
+			(float)(c.X * ChunkSize), (float)(c.Y * ChunkSize), (float)(c.Z * ChunkSize)));
+		chunkRitem->ObjCBIndex = slot->second;
+		chunkRitem->Mat = mBlockMaterials[i];
+		chunkRitem->Geo = geo;
+		chunkRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		chunkRitem->IndexCount = it->second.IndexCount;
+		chunkRitem->StartIndexLocation = it->second.StartIndexLocation;
+		chunkRitem->BaseVertexLocation = it->second.BaseVertexLocation;
+		chunkRitem->NumFramesDirty = 0;
+
+		//translucent items join their layer once UpdateTranslucentOrder has sorted them
+		ChunkLayer layer = GetChunkLayer((BlockId)i);
+		if (layer == ChunkLayer::Translucent)
+		{
+			chunkRitem->SortedIndices = true;
+			chunkRitem->IndexCount = 0;
+			mTranslucentRitems[key].push_back(chunkRitem.get());
 		}
+		else
+		{
+			mRitemLayer[(int)(layer == ChunkLayer::Cutout ? RenderLayer::AlphaTested : RenderLayer::Opaque)].push_back(chunkRitem.get());
+		}
+		mAllRitems.push_back(std::move(chunkRitem));
 	}
+}
+
+void CrateApp::RemoveChunkGeometry(const ChunkCoord& c)
+{
+	auto it = mChunkGeometries.find(PackChunkCoord(c));
+	if (it == mChunkGeometries.end())
+		return;
 
-	//sand quadrant generation
-	for (int z = 50; z < 100; z++) {
-		for (int x = 50; x < 100; x++) {
-			//creating random number between 1 and 10
-			random = rand() % 10 + 1;
-			//if the random number equals 2 then make the terrain 1 block higher, so 1 in 10 blocks are higher
-			if (random == 2) {
-				for (int y = 0; y < 10; y++) {
-					//cheking to see if y is at the bottom so that it spawns bedrock
-					if (y == 0)
-					{
-						//creating a bedrock block at position x,y,z
-						auto boxR2item = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxR2item->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxR2item->ObjCBIndex = index;
-						boxR2item->Mat = mMaterials["bedrock"].get();
-						boxR2item->Geo = mGeometries["boxGeo"].get();
-						boxR2item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxR2item->IndexCount = boxR2item->Geo->DrawArgs["box"].IndexCount;
-						boxR2item->StartIndexLocation = boxR2item->Geo->DrawArgs["box"].StartIndexLocation;
-						boxR2item->BaseVertexLocation = boxR2item->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxR2item));
-						index++;
-					}
-					//creating a layer in a low range so only stone, gravel and iron spawn
-					else if (y > 0 && y < 4)
-					{
-						//creating a random number between 1 and 5 and spawning a gravel block when it equals 2 so there is a 1 in 5 chance to spawn gravel
-						if (rand() % 5 + 1 == 2) {
-							//creating a gravel block at position x,y,z
-							auto boxRitem = std::make_unique<RenderItem>();
-							XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-							boxRitem->ObjCBIndex = index;
-							boxRitem->Mat = mMaterials["gravel"].get();
-							boxRitem->Geo = mGeometries["boxGeo"].get();
-							boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-							boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-							boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-							boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-							mAllRitems.push_back(std::move(boxRitem));
-							index++;
-						}
-						//creating a random number between 1 and 10 and spawning a iron block when it equals 2 so there is a 1 in 10 chance to spawn iron
-						else if (rand() % 10 + 1 == 2) {
-							//creating a iron block at position x,y,z
-							auto boxRitem = std::make_unique<RenderItem>();
-							XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-							boxRitem->ObjCBIndex = index;
-							boxRitem->Mat = mMaterials["iron"].get();
-							boxRitem->Geo = mGeometries["boxGeo"].get();
-							boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-							boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-							boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-							boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-							mAllRitems.push_back(std::move(boxRitem));
-							index++;
-						}
-						//making every other block in this range stone
-						else {
-							//creating a stone block at position x,y,z
-							auto boxRitem = std::make_unique<RenderItem>();
-							XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-							boxRitem->ObjCBIndex = index;
-							boxRitem->Mat = mMaterials["stone"].get();
-							boxRitem->Geo = mGeometries["boxGeo"].get();
-							boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-							boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-							boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-							boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-							mAllRitems.push_back(std::move(boxRitem));
-							index++;
-						}
-					}
-					//making top row sand
-					else if (y == 9) {
-						//creating a sand block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["sand"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-
-					}
-					//making every other block in this range dirt
-					else {
-						//creating a dirt block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["dirt"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-				}
+	MeshGeometry* geo = it->second;
+	mChunkGeometries.erase(it);
+
+	for (auto& layer : mRitemLayer)
+	{
+		layer.erase(std::remove_if(layer.begin(), layer.end(),
+			[geo](RenderItem* ri) { return ri->Geo == geo; }), layer.end());
+	}
+	mTranslucentRitems.erase(PackChunkCoord(c));
+	mTranslucentSorter.RemoveChunk(c);
+	mAllRitems.erase(std::remove_if(mAllRitems.begin(), mAllRitems.end(),
+		[geo](const std::unique_ptr<RenderItem>& ri) { return ri->Geo == geo; }), mAllRitems.end());
+
+	//frames already submitted may still read the buffers, so they go once the gpu has passed the last of them
+	auto named = mGeometries.find(geo->Name);
+	mRetiredGeometries.emplace_back(mCurrentFence, std::move(named->second));
+	mGeometries.erase(named);
+}
+
+void CrateApp::ApplyRemeshedChunks()
+{
+	//swapping in the meshes the workers finished since the last frame; uploads go on the open command list
+	ChunkMesh mesh;
+	while (mMeshWorkers.PopCompleted(mesh))
+	{
+		mRemeshQueue.Completed(mesh.Coord);
+		RemoveChunkGeometry(mesh.Coord);
+		if (!mesh.IsEmpty())
+			BuildChunkRenderItems(mesh.Coord, UploadChunkMesh(mesh));
+	}
+}
+
+void CrateApp::UpdateChunkLods()
+{
+	//levels only need picking again once the camera moves into another chunk
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	ChunkCoord cameraChunk = World::ToChunkCoord((int)std::floor(eye.x), (int)std::floor(eye.y), (int)std::floor(eye.z));
+	if (mLodCameraChunkValid && cameraChunk == mLodCameraChunk)
+		return;
+
+	mLodCameraChunk = cameraChunk;
+	mLodCameraChunkValid = true;
+	mWorld.ForEachChunk([&](const Chunk& chunk)
+	{
+		mRemeshQueue.SetChunkLod(chunk.GetCoord(), SelectChunkLod(chunk.GetCoord(), eye.x, eye.y, eye.z));
+	});
+}
+
+void CrateApp::UpdateTranslucentOrder()
+{
+	//sorting again only when the camera moves into another block or meshes change
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	if (mTranslucentSorter.Update(eye.x, eye.y, eye.z))
+	{
+		const std::vector<std::uint32_t>& indices = mTranslucentSorter.GetIndices();
+		const std::vector<TranslucentRange>& ranges = mTranslucentSorter.GetRanges();
+
+		//if the buffer is too small the farthest chunks go without water
+		mTranslucentFirstIndex = 0;
+		for (const TranslucentRange& range : ranges)
+		{
+			if (indices.size() - range.StartIndex <= gMaxTranslucentIndices)
+			{
+				mTranslucentFirstIndex = range.StartIndex;
+				break;
 			}
-			//lower level sand
-			else {
-				//height of sand
-				for (int y = 0; y < 9; y++) {
-					//cheking to see if y is at the bottom so that it spawns bedrock
-					if (y == 0)
-					{
-						//creating a bedrock block at position x,y,z
-						auto boxR2item = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxR2item->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxR2item->ObjCBIndex = index;
-						boxR2item->Mat = mMaterials["bedrock"].get();
-						boxR2item->Geo = mGeometries["boxGeo"].get();
-						boxR2item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxR2item->IndexCount = boxR2item->Geo->DrawArgs["box"].IndexCount;
-						boxR2item->StartIndexLocation = boxR2item->Geo->DrawArgs["box"].StartIndexLocation;
-						boxR2item->BaseVertexLocation = boxR2item->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxR2item));
-						index++;
-					}
-					//creating a layer in a low range so only stone, gravel and iron spawn
-					else if (y > 0 && y < 4)
-					{
-						//creating a random number between 1 and 5 and spawning a gravel block when it equals 2 so there is a 1 in 5 chance to spawn gravel
-						if (rand() % 5 + 1 == 2) {
-							//creating a gravel block at position x,y,z
-							auto boxRitem = std::make_unique<RenderItem>();
-							XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-							boxRitem->ObjCBIndex = index;
-							boxRitem->Mat = mMaterials["gravel"].get();
-							boxRitem->Geo = mGeometries["boxGeo"].get();
-							boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-							boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-							boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-							boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-							mAllRitems.push_back(std::move(boxRitem));
-							index++;
-						}
-						//creating a random number between 1 and 10 and spawning a iron block when it equals 2 so there is a 1 in 10 chance to spawn iron
-						else if (rand() % 10 + 1 == 2) {
-							//creating a iron block at position x,y,z
-							auto boxRitem = std::make_unique<RenderItem>();
-							XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-							boxRitem->ObjCBIndex = index;
-							boxRitem->Mat = mMaterials["iron"].get();
-							boxRitem->Geo = mGeometries["boxGeo"].get();
-							boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-							boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-							boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-							boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-							mAllRitems.push_back(std::move(boxRitem));
-							index++;
-						}
-						//making every other block in this range stone
-						else {
-							//creating a stone block at position x,y,z
-							auto boxRitem = std::make_unique<RenderItem>();
-							XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-							boxRitem->ObjCBIndex = index;
-							boxRitem->Mat = mMaterials["stone"].get();
-							boxRitem->Geo = mGeometries["boxGeo"].get();
-							boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-							boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-							boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-							boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-							mAllRitems.push_back(std::move(boxRitem));
-							index++;
-						}
-					}
-					//making top row sand
-					else if (y == 8) {
-						//creating a sand block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["sand"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-
-					}
-					//making every other block in this range dirt
-					else {
-						//creating a dirt block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["dirt"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-				}
+			mTranslucentFirstIndex = indices.size();
+		}
+
+		auto& layer = mRitemLayer[(int)RenderLayer::Transparent];
+		layer.clear();
+		for (const TranslucentRange& range : ranges)
+		{
+			auto items = mTranslucentRitems.find(PackChunkCoord(range.Coord));
+			if (range.StartIndex < mTranslucentFirstIndex || items == mTranslucentRitems.end())
+				continue;
+
+			for (RenderItem* ri : items->second)
+			{
+				if (ri->Mat != mBlockMaterials[(int)range.Block])
+					continue;
+
+				ri->StartIndexLocation = range.StartIndex - (UINT)mTranslucentFirstIndex;
+				ri->IndexCount = range.IndexCount;
+				layer.push_back(ri);
 			}
 		}
+
+		mTranslucentFramesDirty = gNumFrameResources;
 	}
 
+	//each frame resource has its own copy of the order, like the constant buffers
+	if (mTranslucentFramesDirty > 0)
+	{
+		const std::vector<std::uint32_t>& indices = mTranslucentSorter.GetIndices();
+		auto currTranslucentIB = mCurrFrameResource->TranslucentIB.get();
+		for (std::size_t i = mTranslucentFirstIndex; i < indices.size(); i++)
+			currTranslucentIB->CopyData((int)(i - mTranslucentFirstIndex), indices[i]);
 
-	//gravel quadrant generation
-	for (int z = 0; z < 50; z++) {
-		for (int x = 50; x < 100; x++) {
-			//create random number between 3 and 1 so there is a range of 3 in height in this quadrant
-			random = rand() % 3 + 1;
-			for (int y = 0; y < random + 8; y++) {
-				//cheking to see if y is at the bottom so that it spawns bedrock
-				if (y == 0)
-				{
-					//creating a bedrock block at position x,y,z
-					auto boxR2item = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxR2item->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxR2item->ObjCBIndex = index;
-					boxR2item->Mat = mMaterials["bedrock"].get();
-					boxR2item->Geo = mGeometries["boxGeo"].get();
-					boxR2item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxR2item->IndexCount = boxR2item->Geo->DrawArgs["box"].IndexCount;
-					boxR2item->StartIndexLocation = boxR2item->Geo->DrawArgs["box"].StartIndexLocation;
-					boxR2item->BaseVertexLocation = boxR2item->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxR2item));
-					index++;
-				}
-				//creating a layer in a low range so only stone, gravel and iron spawn
-				else if (y > 0 && y < 4)
-				{
-					//creating a random number between 1 and 5 and spawning a gravel block when it equals 2 so there is a 1 in 5 chance to spawn gravel
-					if (rand() % 5 + 1 == 2) {
-						//creating a gravel block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["gravel"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-					//creating a random number between 1 and 10 and spawning a iron block when it equals 2 so there is a 1 in 10 chance to spawn iron
-					else if (rand() % 10 + 1 == 2) {
-						//creating a iron block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["iron"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-					//making every other block in this range stone
-					else {
-						//creating a stone block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["stone"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-				}
-				//making the top 3 rows gravel
-				else if ((random == 1 && y == 8) || (random == 2 && ((y == 9) || (y == 8))) || (random == 3 && ((y == 10) || (y == 9) || (y == 8)))) {
-					//creating a gravel block at position x,y,z
-					auto boxRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxRitem->ObjCBIndex = index;
-					boxRitem->Mat = mMaterials["gravel"].get();
-					boxRitem->Geo = mGeometries["boxGeo"].get();
-					boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-					boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-					boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxRitem));
-					index++;
-
-				}
-				//making every other block in this range dirt
-				else {
-					//creating a dirt block at position x,y,z
-					auto boxRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxRitem->ObjCBIndex = index;
-					boxRitem->Mat = mMaterials["dirt"].get();
-					boxRitem->Geo = mGeometries["boxGeo"].get();
-					boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-					boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-					boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxRitem));
-					index++;
-				}
-			}
-		}
+		mTranslucentFramesDirty--;
 	}
+}
 
+void CrateApp::UpdateBlockInstances()
+{
+	if (instancedBlocks && mBlockInstancesDirty)
+	{
+		mBlockInstances.Build(mWorld);
+		mBlockInstancesDirty = false;
+		mBlockInstanceFramesDirty = gNumFrameResources;
+
+		const BlockInstanceStats& stats = mBlockInstances.GetStats();
+		std::wstring text = L"***BlockInstances: count = " + std::to_wstring(stats.Instances) +
+			L" draws = " + std::to_wstring(mBlockInstances.GetBatches().size()) +
+			L" bytes = " + std::to_wstring(stats.GetBytes()) + L" build ms = " + std::to_wstring(stats.BuildMs) + L"\n";
+		OutputDebugString(text.c_str());
+	}
 
-	//water quadrant generation
-	for (int z = 50; z < 100; z++) {
-		for (int x = 0; x < 50; x++) {
-			for (int y = 0; y < 9; y++) {
-				//cheking to see if y is at the bottom so that it spawns bedrock
-				if (y == 0)
-				{
-					//creating a bedrock block at position x,y,z
-					auto boxR2item = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxR2item->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxR2item->ObjCBIndex = index;
-					boxR2item->Mat = mMaterials["bedrock"].get();
-					boxR2item->Geo = mGeometries["boxGeo"].get();
-					boxR2item->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxR2item->IndexCount = boxR2item->Geo->DrawArgs["box"].IndexCount;
-					boxR2item->StartIndexLocation = boxR2item->Geo->DrawArgs["box"].StartIndexLocation;
-					boxR2item->BaseVertexLocation = boxR2item->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxR2item));
-					index++;
-				}
-				//creating a layer in a low range so only stone, gravel and iron spawn
-				else if (y > 0 && y < 4)
-				{
-					//creating a random number between 1 and 5 and spawning a gravel block when it equals 2 so there is a 1 in 5 chance to spawn gravel
-					if (rand() % 5 + 1 == 2) {
-						//creating a gravel block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["gravel"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-					//creating a random number between 1 and 10 and spawning a iron block when it equals 2 so there is a 1 in 10 chance to spawn iron
-					else if (rand() % 10 + 1 == 2) {
-						//creating a iron block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["iron"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-					//making every other block in this range stone
-					else {
-						//creating a stone block at position x,y,z
-						auto boxRitem = std::make_unique<RenderItem>();
-						XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-						boxRitem->ObjCBIndex = index;
-						boxRitem->Mat = mMaterials["stone"].get();
-						boxRitem->Geo = mGeometries["boxGeo"].get();
-						boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-						boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-						boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-						boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-						mAllRitems.push_back(std::move(boxRitem));
-						index++;
-					}
-				}
-				//making top layer water
-				else if (y == 8) {
-					//creating a water block at position x,y,z
-					auto boxRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxRitem->ObjCBIndex = index;
-					boxRitem->Mat = mMaterials["water"].get();
-					boxRitem->Geo = mGeometries["boxGeo"].get();
-					boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-					boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-					boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxRitem));
-					index++;
-
-				}
-				//making every other block in this range dirt
-				else {
-					//creating a dirt block at position x,y,z
-					auto boxRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation((float)x, (float)y, (float)z));
-					boxRitem->ObjCBIndex = index;
-					boxRitem->Mat = mMaterials["dirt"].get();
-					boxRitem->Geo = mGeometries["boxGeo"].get();
-					boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-					boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-					boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(boxRitem));
-					index++;
-				}
-			}
-		}
+	//each frame resource has its own copy, like the constant buffers; copying goes on
+	//after the key is let go so the frame resources are always filled in turn
+	if (mBlockInstanceFramesDirty > 0)
+	{
+		const std::vector<BlockInstance>& instances = mBlockInstances.GetInstances();
+		auto currBlockInstances = mCurrFrameResource->BlockInstances.get();
+		std::size_t count = std::min(instances.size(), (std::size_t)gMaxBlockInstances);
+		for (std::size_t i = 0; i < count; i++)
+			currBlockInstances->CopyData((int)i, instances[i]);
+
+		mBlockInstanceFramesDirty--;
 	}
+}
 
-	isBuilt = true;
-	// All the render items are opaque.
-	for (auto& e : mAllRitems)
-		mOpaqueRitems.push_back(e.get());
+void CrateApp::SetBlock(int x, int y, int z, BlockId id)
+{
+	//every block edit goes through here so it is journaled and its chunks get remeshed
+	if (mWorld.GetBlock(x, y, z) == id)
+		return;
+
+	mWorld.SetBlock(x, y, z, id);
+	mJournal.Append(x, y, z, id);
+	mRemeshQueue.MarkBlockChanged(x, y, z);
+	mOctree.UpdateChunk(mWorld, World::ToChunkCoord(x, y, z));
+	mBlockInstancesDirty = true;
+}
+
+void CrateApp::PickBlock(bool place)
+{
+	//casting from the eye along the view direction, so the block under the middle of the screen is picked
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	XMFLOAT3 look = mCamera.GetLook3f();
+	const float origin[3] = { eye.x, eye.y, eye.z };
+	const float dir[3] = { look.x, look.y, look.z };
+	VoxelRayHit hit = mOctree.Raycast(origin, dir, gPickDistance);
+	if (!hit.Hit)
+		return;
+
+	if (!place)
+	{
+		SetBlock(hit.X, hit.Y, hit.Z, BlockId::Air);
+	}
+	//a ray that starts inside a block has no face to build against
+	else if (hit.NormalX != 0 || hit.NormalY != 0 || hit.NormalZ != 0)
+	{
+		SetBlock(hit.X + hit.NormalX, hit.Y + hit.NormalY, hit.Z + hit.NormalZ, BlockId::Stone);
+	}
 }
 
 void CrateApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -2111,8 +2151,10 @@ void CrateApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 	{
 		auto ri = ritems[i];
 
+		D3D12_INDEX_BUFFER_VIEW ibv = GetIndexBufferView(ri);
+
 		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+		cmdList->IASetIndexBuffer(&ibv);
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
 		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
@@ -2129,6 +2171,284 @@ void CrateApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 	}
 }
 
+void CrateApp::SetDrawTargets(ID3D12GraphicsCommandList* cmdList)
+{
+	//state a command list needs before drawing; none of it carries over between lists
+	cmdList->RSSetViewports(1, &mScreenViewport);
+	cmdList->RSSetScissorRects(1, &mScissorRect);
+
+	// Specify the buffers we are going to render to.
+	cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+
+	auto passCB = mCurrFrameResource->PassCB->Resource();
+	cmdList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+}
+
+void CrateApp::BuildDrawList(bool debugPso)
+{
+	//keys order the passes, then group by pso and material with near chunks first
+	const RenderLayer layers[] = { RenderLayer::Opaque, RenderLayer::AlphaTested, RenderLayer::Transparent };
+	const char* psos[] = { "opaque", "alphaTested", "transparent" };
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	float farZ = mCamera.GetFarZ();
+	const float halfChunk = ChunkSize * 0.5f;
+
+	mDrawQueue.Clear();
+	mQueuedDraws.clear();
+	for (std::uint32_t l = 0; l < 3; l++)
+	{
+		//the debug psos are set when the command list is reset and stay for every layer
+		DrawListItem item;
+		item.Pso = debugPso ? nullptr : mOpaquePSO[psos[l]].Get();
+		for (RenderItem* ri : mRitemLayer[(int)layers[l]])
+		{
+			item.Ri = ri;
+			std::uint32_t index = (std::uint32_t)mQueuedDraws.size();
+			mQueuedDraws.push_back(item);
+
+			//water is already in back to front order, so its key only keeps that order
+			if (layers[l] == RenderLayer::Transparent)
+			{
+				mDrawQueue.Push(MakeOrderedSortKey(l, index), index);
+				continue;
+			}
+
+			float dx = ri->World._41 + halfChunk - eye.x;
+			float dy = ri->World._42 + halfChunk - eye.y;
+			float dz = ri->World._43 + halfChunk - eye.z;
+			float distance = sqrtf(dx*dx + dy*dy + dz*dz);
+			mDrawQueue.Push(MakeSortKey(l, l, ri->Mat->MatCBIndex, GetDepthBucket(distance, farZ), ri->ObjCBIndex), index);
+		}
+	}
+	mDrawQueue.Sort();
+
+	mDrawList.clear();
+	for (const DrawQueueEntry& entry : mDrawQueue.GetEntries())
+		mDrawList.push_back(mQueuedDraws[entry.Item]);
+}
+
+void CrateApp::DrawList(ID3D12GraphicsCommandList* cmdList, std::size_t begin, std::size_t end, DrawStateCache& cache)
+{
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+
+	D3D12_GPU_VIRTUAL_ADDRESS objectCB = mCurrFrameResource->ObjectCB->Resource()->GetGPUVirtualAddress();
+	D3D12_GPU_VIRTUAL_ADDRESS matCB = mCurrFrameResource->MaterialCB->Resource()->GetGPUVirtualAddress();
+	D3D12_GPU_DESCRIPTOR_HANDLE texStart = mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+
+	for (std::size_t i = begin; i < end; i++)
+	{
+		const DrawListItem& item = mDrawList[i];
+		const RenderItem* ri = item.Ri;
+
+		D3D12_VERTEX_BUFFER_VIEW vbv = ri->Geo->VertexBufferView();
+		D3D12_INDEX_BUFFER_VIEW ibv = GetIndexBufferView(ri);
+		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(texStart, ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB + ri->ObjCBIndex*objCBByteSize;
+		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB + ri->Mat->MatCBIndex*matCBByteSize;
+
+		DrawState state;
+		state.Bindings[(int)DrawBinding::Pso] = (std::uint64_t)(std::uintptr_t)item.Pso;
+		state.Bindings[(int)DrawBinding::VertexBuffer] = vbv.BufferLocation;
+		state.Bindings[(int)DrawBinding::IndexBuffer] = ibv.BufferLocation;
+		state.Bindings[(int)DrawBinding::Topology] = ri->PrimitiveType;
+		state.Bindings[(int)DrawBinding::Texture] = tex.ptr;
+		state.Bindings[(int)DrawBinding::MaterialCB] = matCBAddress;
+		state.Bindings[(int)DrawBinding::ObjectCB] = objCBAddress;
+
+		unsigned int changed = cache.Apply(state);
+		if (DrawStateCache::IsSet(changed, DrawBinding::Pso) && item.Pso != nullptr)
+			cmdList->SetPipelineState(item.Pso);
+		if (DrawStateCache::IsSet(changed, DrawBinding::VertexBuffer))
+			cmdList->IASetVertexBuffers(0, 1, &vbv);
+		if (DrawStateCache::IsSet(changed, DrawBinding::IndexBuffer))
+			cmdList->IASetIndexBuffer(&ibv);
+		if (DrawStateCache::IsSet(changed, DrawBinding::Topology))
+			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+		if (DrawStateCache::IsSet(changed, DrawBinding::Texture))
+			cmdList->SetGraphicsRootDescriptorTable(0, tex);
+		if (DrawStateCache::IsSet(changed, DrawBinding::ObjectCB))
+			cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
+		if (DrawStateCache::IsSet(changed, DrawBinding::MaterialCB))
+			cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+
+		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+	}
+}
+
+std::size_t CrateApp::RecordLayersInParallel()
+{
+	BuildDrawList(false);
+	mDrawStateStats = DrawStateStats();
+
+	//each thread records a contiguous range, so the lists keep the draw order when submitted in turn
+	return mRecorder.Record(mDrawList.size(), gMinDrawsPerCommandList, mCurrFrameResource->ThreadCmdLists,
+		[this](RecordingList& list, const DrawRange& range)
+	{
+		ID3D12GraphicsCommandList* cmdList = static_cast<FrameCommandList&>(list).Get();
+		SetDrawTargets(cmdList);
+
+		//a new list has nothing bound, so each range tracks its own state
+		DrawStateCache cache;
+		DrawList(cmdList, range.Begin, range.End, cache);
+		{
+			std::lock_guard<std::mutex> lock(mDrawStateStatsMutex);
+			mDrawStateStats.Add(cache.GetStats());
+		}
+
+		//the last list hands the back buffer to present
+		if (range.End == mDrawList.size())
+		{
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+				D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+		}
+	});
+}
+
+void CrateApp::DrawBlockInstances(ID3D12GraphicsCommandList* cmdList)
+{
+	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	D3D12_GPU_VIRTUAL_ADDRESS instances = mCurrFrameResource->BlockInstances->Resource()->GetGPUVirtualAddress();
+
+	//every block is the same cube, so the buffers are only set once
+	MeshGeometry* geo = mGeometries["blockGeo"].get();
+	const SubmeshGeometry& cube = geo->DrawArgs["cube"];
+	cmdList->IASetVertexBuffers(0, 1, &geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	//opaque block types first, then the alpha tested ones
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bool cutout = pass == 1;
+		cmdList->SetPipelineState(mOpaquePSO[cutout ? "blockAlphaTested" : "block"].Get());
+
+		for (const BlockInstanceBatch& batch : mBlockInstances.GetBatches())
+		{
+			if ((GetChunkLayer(batch.Block) == ChunkLayer::Cutout) != cutout || batch.StartInstance >= gMaxBlockInstances)
+				continue;
+
+			Material* mat = mBlockMaterials[(int)batch.Block];
+			CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+			tex.Offset(mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+			cmdList->SetGraphicsRootDescriptorTable(0, tex);
+			cmdList->SetGraphicsRootConstantBufferView(3, matCB->GetGPUVirtualAddress() + mat->MatCBIndex*matCBByteSize);
+			//SV_InstanceID starts from 0 in every draw, so the buffer is bound from the batch's first instance
+			cmdList->SetGraphicsRootShaderResourceView(4, instances + batch.StartInstance * sizeof(BlockInstance));
+
+			UINT count = std::min(batch.InstanceCount, gMaxBlockInstances - batch.StartInstance);
+			cmdList->DrawIndexedInstanced(cube.IndexCount, count, cube.StartIndexLocation, cube.BaseVertexLocation, 0);
+		}
+	}
+}
+
+void CrateApp::DrawIndirect(ID3D12GraphicsCommandList* cmdList)
+{
+	//the three chunk layers become three passes, water keeps its back to front order
+	const RenderLayer layers[] = { RenderLayer::Opaque, RenderLayer::AlphaTested, RenderLayer::Transparent };
+	const char* psos[] = { "opaqueIndirect", "alphaTestedIndirect", "transparentIndirect" };
+
+	mIndirectDraws.Clear();
+	for (RenderLayer layer : layers)
+	{
+		mIndirectDraws.BeginPass();
+		for (RenderItem* ri : mRitemLayer[(int)layer])
+		{
+			D3D12_VERTEX_BUFFER_VIEW vbv = ri->Geo->VertexBufferView();
+			D3D12_INDEX_BUFFER_VIEW ibv = GetIndexBufferView(ri);
+
+			IndirectCommand command;
+			command.VertexBufferLocation = vbv.BufferLocation;
+			command.VertexBufferSize = vbv.SizeInBytes;
+			command.VertexStride = vbv.StrideInBytes;
+			command.IndexBufferLocation = ibv.BufferLocation;
+			command.IndexBufferSize = ibv.SizeInBytes;
+			command.IndexFormat = ibv.Format;
+			command.ChunkIndex = ri->ObjCBIndex;
+			command.IndexCountPerInstance = ri->IndexCount;
+			command.StartIndexLocation = ri->StartIndexLocation;
+			command.BaseVertexLocation = ri->BaseVertexLocation;
+			mIndirectDraws.Add(command, ri->Mat->MatCBIndex);
+		}
+		mIndirectDraws.EndPass(layer == RenderLayer::Transparent);
+	}
+
+	//groups and commands past the end of the buffers are dropped
+	const std::vector<IndirectCommand>& commands = mIndirectDraws.GetCommands();
+	const std::vector<IndirectGroup>& groups = mIndirectDraws.GetGroups();
+	if (commands.size() > gMaxIndirectCommands || groups.size() > gMaxIndirectGroups)
+		OutputDebugString(L"***IndirectDraws: out of argument buffer space\n");
+
+	auto currArgs = mCurrFrameResource->IndirectArgs.get();
+	auto currCounts = mCurrFrameResource->IndirectCounts.get();
+	std::size_t commandCount = std::min(commands.size(), (std::size_t)gMaxIndirectCommands);
+	for (std::size_t i = 0; i < commandCount; i++)
+		currArgs->CopyData((int)i, commands[i]);
+
+	const std::vector<std::uint32_t>& counts = mIndirectDraws.GetCounts();
+	std::size_t groupCount = std::min(groups.size(), (std::size_t)gMaxIndirectGroups);
+	for (std::size_t g = 0; g < groupCount; g++)
+	{
+		UINT fits = groups[g].FirstCommand < gMaxIndirectCommands ? gMaxIndirectCommands - groups[g].FirstCommand : 0;
+		currCounts->CopyData((int)g, std::min(counts[g], fits));
+	}
+
+	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	auto argBuffer = currArgs->Resource();
+	auto countBuffer = currCounts->Resource();
+
+	//chunks read their constants from the object buffer through the root constant each command sets
+	cmdList->SetGraphicsRootShaderResourceView(6, mCurrFrameResource->ObjectCB->Resource()->GetGPUVirtualAddress());
+	cmdList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	//the texture table can't be changed by a command, so each material gets its own ExecuteIndirect
+	const std::vector<IndirectPass>& passes = mIndirectDraws.GetPasses();
+	for (std::size_t p = 0; p < passes.size(); p++)
+	{
+		cmdList->SetPipelineState(mOpaquePSO[psos[p]].Get());
+
+		for (UINT g = passes[p].FirstGroup; g < passes[p].FirstGroup + passes[p].GroupCount && g < groupCount; g++)
+		{
+			const IndirectGroup& group = groups[g];
+			if (group.FirstCommand >= gMaxIndirectCommands)
+				continue;
+
+			Material* mat = mMaterialsByCBIndex[group.Material];
+			CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+			tex.Offset(mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+			cmdList->SetGraphicsRootDescriptorTable(0, tex);
+			cmdList->SetGraphicsRootConstantBufferView(3, matCB->GetGPUVirtualAddress() + mat->MatCBIndex*matCBByteSize);
+
+			//the count buffer decides how many of the group's commands run
+			cmdList->ExecuteIndirect(mChunkCommandSignature.Get(), group.CommandCount,
+				argBuffer, group.FirstCommand * sizeof(IndirectCommand),
+				countBuffer, g * sizeof(std::uint32_t));
+		}
+	}
+}
+
+D3D12_INDEX_BUFFER_VIEW CrateApp::GetIndexBufferView(const RenderItem* ri)
+{
+	//translucent chunks draw from this frame's sorted 32-bit indices instead of their own
+	D3D12_INDEX_BUFFER_VIEW ibv = ri->Geo->IndexBufferView();
+	if (ri->SortedIndices)
+	{
+		ibv.BufferLocation = mCurrFrameResource->TranslucentIB->Resource()->GetGPUVirtualAddress();
+		ibv.Format = DXGI_FORMAT_R32_UINT;
+		ibv.SizeInBytes = gMaxTranslucentIndices * sizeof(std::uint32_t);
+	}
+	return ibv;
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> CrateApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
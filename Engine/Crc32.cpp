@@ -0,0 +1,31 @@
+#include "Crc32.h"
+
+namespace
+{
+	struct Crc32Table
+	{
+		std::uint32_t Values[256];
+
+		Crc32Table()
+		{
+			for (std::uint32_t i = 0; i < 256; i++)
+			{
+				std::uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				Values[i] = c;
+			}
+		}
+	};
+}
+
+std::uint32_t Crc32(const void* data, std::size_t size)
+{
+	static const Crc32Table table;
+
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	std::uint32_t crc = 0xFFFFFFFFu;
+	for (std::size_t i = 0; i < size; i++)
+		crc = table.Values[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3) of a byte range, used to detect torn or corrupt data in
+// the region files and the edit journal.
+std::uint32_t Crc32(const void* data, std::size_t size);
@@ -0,0 +1,131 @@
+#include "DrawQueue.h"
+#include <algorithm>
+
+namespace
+{
+	std::uint64_t ClampField(std::uint64_t value, int bits)
+	{
+		return std::min<std::uint64_t>(value, (1ull << bits) - 1);
+	}
+}
+
+std::uint64_t MakeSortKey(std::uint32_t pass, std::uint32_t pso, std::uint32_t material, std::uint32_t depthBucket,
+	std::uint32_t tiebreak)
+{
+	return (ClampField(pass, SortKeyPassBits) << SortKeyPassShift) |
+		(ClampField(pso, SortKeyPsoBits) << SortKeyPsoShift) |
+		(ClampField(material, SortKeyMaterialBits) << SortKeyMaterialShift) |
+		(ClampField(depthBucket, SortKeyDepthBits) << SortKeyDepthShift) |
+		ClampField(tiebreak, SortKeyTiebreakBits);
+}
+
+std::uint64_t MakeOrderedSortKey(std::uint32_t pass, std::uint64_t sequence)
+{
+	return (ClampField(pass, SortKeyPassBits) << SortKeyPassShift) | ClampField(sequence, SortKeyPassShift);
+}
+
+std::uint32_t GetDepthBucket(float distance, float farZ)
+{
+	const float buckets = (float)((1 << SortKeyDepthBits) - 1);
+	if (!(distance > 0.0f) || !(farZ > 0.0f))
+		return 0;
+	return (std::uint32_t)(std::min(distance / farZ, 1.0f) * buckets);
+}
+
+void DrawQueue::Push(std::uint64_t key, std::uint32_t item)
+{
+	DrawQueueEntry entry;
+	entry.Key = key;
+	entry.Item = item;
+	mEntries.push_back(entry);
+}
+
+void DrawQueue::Sort()
+{
+	const std::size_t count = mEntries.size();
+	mSortPasses = 0;
+	if (count < 2)
+		return;
+
+	// Histograms of all eight digits in one pass.
+	std::uint32_t counts[8][256] = {};
+	for (const DrawQueueEntry& entry : mEntries)
+	{
+		for (int d = 0; d < 8; d++)
+			counts[d][(entry.Key >> (d * 8)) & 0xFF]++;
+	}
+
+	mScratch.resize(count);
+	for (int d = 0; d < 8; d++)
+	{
+		// Every key has the same digit here, so this pass wouldn't move anything.
+		if (counts[d][(mEntries[0].Key >> (d * 8)) & 0xFF] == count)
+			continue;
+
+		std::uint32_t offsets[256];
+		std::uint32_t offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			offsets[b] = offset;
+			offset += counts[d][b];
+		}
+
+		for (const DrawQueueEntry& entry : mEntries)
+			mScratch[offsets[(entry.Key >> (d * 8)) & 0xFF]++] = entry;
+		mEntries.swap(mScratch);
+		mSortPasses++;
+	}
+}
+
+std::size_t DrawStateStats::GetSetTotal()const
+{
+	std::size_t total = 0;
+	for (std::size_t n : Set)
+		total += n;
+	return total;
+}
+
+std::size_t DrawStateStats::GetSkippedTotal()const
+{
+	std::size_t total = 0;
+	for (std::size_t n : Skipped)
+		total += n;
+	return total;
+}
+
+void DrawStateStats::Add(const DrawStateStats& rhs)
+{
+	Draws += rhs.Draws;
+	for (int b = 0; b < (int)DrawBinding::Count; b++)
+	{
+		Set[b] += rhs.Set[b];
+		Skipped[b] += rhs.Skipped[b];
+	}
+}
+
+void DrawStateCache::Reset()
+{
+	mValid = 0;
+}
+
+unsigned int DrawStateCache::Apply(const DrawState& state)
+{
+	unsigned int changed = 0;
+	for (int b = 0; b < (int)DrawBinding::Count; b++)
+	{
+		const unsigned int bit = 1u << b;
+		if ((mValid & bit) != 0 && mBound.Bindings[b] == state.Bindings[b])
+		{
+			mStats.Skipped[b]++;
+			continue;
+		}
+
+		mBound.Bindings[b] = state.Bindings[b];
+		changed |= bit;
+		mStats.Set[b]++;
+	}
+
+	mValid = (1u << (int)DrawBinding::Count) - 1;
+	mStats.Draws++;
+	return changed;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A draw's sort key, high bits first:
+//
+//   63..60  pass          4 bits
+//   59..52  PSO           8 bits
+//   51..40  material     12 bits
+//   39..24  depth bucket 16 bits
+//   23..0   tiebreak     24 bits
+//
+// Sorting by the key submits passes in order and groups draws by PSO, then
+// material, so few bindings change between neighbours.  Within a material
+// the depth bucket puts near draws first.  The tiebreak is free for the
+// caller, e.g. to keep the parts of one mesh together.
+const int SortKeyTiebreakBits = 24;
+const int SortKeyDepthBits = 16;
+const int SortKeyMaterialBits = 12;
+const int SortKeyPsoBits = 8;
+const int SortKeyPassBits = 4;
+
+const int SortKeyDepthShift = SortKeyTiebreakBits;
+const int SortKeyMaterialShift = SortKeyDepthShift + SortKeyDepthBits;
+const int SortKeyPsoShift = SortKeyMaterialShift + SortKeyMaterialBits;
+const int SortKeyPassShift = SortKeyPsoShift + SortKeyPsoBits;
+
+static_assert(SortKeyPassShift + SortKeyPassBits == 64, "Sort key fields must fill 64 bits");
+
+// Fields that don't fit their bits are clamped to the largest value.
+std::uint64_t MakeSortKey(std::uint32_t pass, std::uint32_t pso, std::uint32_t material, std::uint32_t depthBucket,
+	std::uint32_t tiebreak = 0);
+
+// Key for a pass that has to keep its own order, like back-to-front
+// translucency: everything below the pass is the position in that order.
+std::uint64_t MakeOrderedSortKey(std::uint32_t pass, std::uint64_t sequence);
+
+// Quantizes a view distance in [0, farZ] to a depth bucket, near first.
+std::uint32_t GetDepthBucket(float distance, float farZ);
+
+inline std::uint32_t GetSortKeyPass(std::uint64_t key) { return (std::uint32_t)(key >> SortKeyPassShift); }
+
+struct DrawQueueEntry
+{
+	std::uint64_t Key = 0;
+	// Whatever the caller uses to find the draw again, e.g. an index.
+	std::uint32_t Item = 0;
+};
+
+// Draws of a frame, sorted by key.
+//
+// Sort() is a stable least-significant-digit radix sort on 8-bit digits.
+// Digits every key shares are skipped, so fields the frame doesn't use
+// cost one pass over the keys for the histograms and nothing after.
+class DrawQueue
+{
+public:
+	void Clear() { mEntries.clear(); }
+	void Push(std::uint64_t key, std::uint32_t item);
+	void Sort();
+
+	const std::vector<DrawQueueEntry>& GetEntries()const { return mEntries; }
+	std::size_t GetSize()const { return mEntries.size(); }
+	// Digits the last Sort() had to scatter on, out of 8.
+	int GetSortPasses()const { return mSortPasses; }
+
+private:
+	std::vector<DrawQueueEntry> mEntries;
+	std::vector<DrawQueueEntry> mScratch;
+	int mSortPasses = 0;
+};
+
+// Bindings a draw needs, compared by value: a GPU address, descriptor
+// handle, pointer or enum, whichever identifies the binding.
+enum class DrawBinding : int
+{
+	Pso = 0,
+	VertexBuffer,
+	IndexBuffer,
+	Topology,
+	Texture,
+	MaterialCB,
+	ObjectCB,
+	Count
+};
+
+struct DrawState
+{
+	std::uint64_t Bindings[(int)DrawBinding::Count] = {};
+};
+
+struct DrawStateStats
+{
+	std::size_t Draws = 0;
+	std::size_t Set[(int)DrawBinding::Count] = {};
+	std::size_t Skipped[(int)DrawBinding::Count] = {};
+
+	std::size_t GetSetTotal()const;
+	std::size_t GetSkippedTotal()const;
+	void Add(const DrawStateStats& rhs);
+};
+
+// Tracks what a command list has bound so a submitter only sets what
+// changes from one draw to the next.
+class DrawStateCache
+{
+public:
+	// Forgets the bound state, as at the start of a command list.  The stats
+	// are kept.
+	void Reset();
+
+	// Returns the bindings of state that differ from what is bound, as a mask
+	// of 1 << DrawBinding, and takes them as bound.
+	unsigned int Apply(const DrawState& state);
+
+	static bool IsSet(unsigned int mask, DrawBinding binding) { return (mask & (1u << (int)binding)) != 0; }
+
+	const DrawStateStats& GetStats()const { return mStats; }
+	void ResetStats() { mStats = DrawStateStats(); }
+
+private:
+	DrawState mBound;
+	unsigned int mValid = 0;
+	DrawStateStats mStats;
+};
@@ -0,0 +1,436 @@
+#include "EditJournal.h"
+#include "Crc32.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+EditJournal::EditJournal(RegionStore& store)
+	: mStore(store)
+{
+}
+
+EditJournal::~EditJournal()
+{
+	Close();
+}
+
+bool EditJournal::Open(World& world)
+{
+	mStore.EnsureDirectory();
+
+	// A crash during compaction leaves the old log behind; it is older than
+	// the current one, so it goes first.
+	std::unordered_set<std::uint64_t> touched;
+	std::size_t torn = 0;
+	std::uint64_t validBytes = 0;
+	std::size_t replayed = Replay(GetOldLogPath(), world, &touched, &torn);
+	std::size_t logRecords = Replay(GetLogPath(), world, &touched, &torn, &validBytes);
+	replayed += logRecords;
+
+	// Fold the replayed edits into the regions so both logs can go.  If that
+	// fails both stay, and the first compaction saves their chunks again.
+	bool folded = SaveSnapshots(SnapshotChunks(world, touched), { GetOldLogPath(), GetLogPath() }, 0);
+	if (!folded)
+		TruncateLog(GetLogPath(), validBytes);
+
+	if (!OpenLog(GetLogPath()))
+	{
+		// Nothing will ever be written, so Sync() mustn't wait for it.
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFailed = true;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mStats.Replayed = replayed;
+	mStats.TornBatches = torn;
+	mStats.LogRecords = folded ? 0 : logRecords;
+	if (!folded)
+		mOldTouched.swap(touched);
+	mStop = false;
+	mFailed = false;
+	mFlusher = std::thread(&EditJournal::FlushLoop, this);
+	return true;
+}
+
+void EditJournal::Close()
+{
+	if (mFlusher.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mQueued.notify_all();
+		mFlusher.join();
+	}
+
+	WaitForCompaction();
+	CloseLog();
+}
+
+std::uint64_t EditJournal::Append(int x, int y, int z, BlockId id)
+{
+	JournalRecord record = {};
+	record.X = x;
+	record.Y = y;
+	record.Z = z;
+	record.Block = (std::uint8_t)id;
+
+	std::uint64_t sequence;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mQueue.empty())
+			mQueueFirstSequence = mNextSequence;
+		mQueue.push_back(record);
+		mTouched.insert(PackChunkCoord(World::ToChunkCoord(x, y, z)));
+		sequence = mNextSequence++;
+		mStats.Appended++;
+		mStats.LogRecords++;
+	}
+
+	mQueued.notify_one();
+	return sequence;
+}
+
+void EditJournal::Sync()
+{
+	WaitDurable(GetLastSequence());
+}
+
+std::uint64_t EditJournal::GetLastSequence()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNextSequence - 1;
+}
+
+bool EditJournal::WaitDurable(std::uint64_t sequence)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDurable.wait(lock, [&] { return mDurableSequence >= sequence || mFailed; });
+	return mDurableSequence >= sequence;
+}
+
+bool EditJournal::BeginCompaction(const World& world)
+{
+	WaitForCompaction();
+
+	std::unordered_set<std::uint64_t> touched;
+	{
+		std::lock_guard<std::mutex> fileLock(mFileMutex);
+
+		std::vector<JournalRecord> batch;
+		std::uint64_t first = 0;
+		bool rotate;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mFailed)
+				return false;
+
+			// A failed compaction left its log behind, and renaming over it
+			// would lose it; retry that one instead.
+			rotate = mOldTouched.empty();
+			if (rotate)
+			{
+				if (mTouched.empty())
+					return false;
+
+				batch.swap(mQueue);
+				first = mQueueFirstSequence;
+				mOldTouched.swap(mTouched);
+				mStats.LogRecords = 0;
+			}
+			touched = mOldTouched;
+			mCompacting = true;
+		}
+
+		if (rotate)
+		{
+			// Everything appended so far belongs to the log being retired.
+			if (!batch.empty())
+				WriteBatch(batch, first);
+
+			CloseLog();
+			if (std::rename(GetLogPath().c_str(), GetOldLogPath().c_str()) != 0 || !OpenLog(GetLogPath()))
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mFailed = true;
+				mCompacting = false;
+				return false;
+			}
+		}
+	}
+
+	// Edits only come from this thread, so the snapshots hold everything in
+	// the retired log (and maybe later edits, which the new log replays over).
+	std::vector<ChunkSnapshot> snapshots = SnapshotChunks(world, touched);
+	std::uint64_t sequence = GetLastSequence();
+	mCompactor = std::thread([this, sequence](std::vector<ChunkSnapshot> chunks)
+	{
+		bool saved = SaveSnapshots(chunks, { GetOldLogPath() }, sequence);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (saved)
+			mOldTouched.clear();
+		mCompacting = false;
+	}, std::move(snapshots));
+	return true;
+}
+
+void EditJournal::WaitForCompaction()
+{
+	if (mCompactor.joinable())
+		mCompactor.join();
+}
+
+bool EditJournal::IsCompacting()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mCompacting;
+}
+
+std::size_t EditJournal::Replay(const std::string& path, World& world, std::unordered_set<std::uint64_t>* touched, std::size_t* tornBatches,
+	std::uint64_t* validBytes)
+{
+	if (validBytes != nullptr)
+		*validBytes = 0;
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return 0;
+
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	std::size_t count = 0;
+	std::size_t offset = 0;
+	while (offset < data.size())
+	{
+		BatchHeader header;
+		bool valid = data.size() - offset >= sizeof(header);
+		if (valid)
+		{
+			std::memcpy(&header, &data[offset], sizeof(header));
+			valid = header.Magic == BatchMagic &&
+				header.Count <= (data.size() - offset - sizeof(header)) / sizeof(JournalRecord);
+		}
+
+		const char* records = valid ? &data[offset + sizeof(header)] : nullptr;
+		if (!valid || Crc32(records, header.Count * sizeof(JournalRecord)) != header.Checksum)
+		{
+			// Nothing after a bad batch can be trusted.
+			if (tornBatches != nullptr)
+				(*tornBatches)++;
+			break;
+		}
+
+		for (std::uint32_t i = 0; i < header.Count; i++)
+		{
+			JournalRecord r;
+			std::memcpy(&r, records + i * sizeof(JournalRecord), sizeof(r));
+			if (r.Block >= gNumBlockTypes)
+				continue;
+
+			world.SetBlock(r.X, r.Y, r.Z, (BlockId)r.Block);
+			if (touched != nullptr)
+				touched->insert(PackChunkCoord(World::ToChunkCoord(r.X, r.Y, r.Z)));
+		}
+
+		count += header.Count;
+		offset += sizeof(header) + header.Count * sizeof(JournalRecord);
+		if (validBytes != nullptr)
+			*validBytes = offset;
+	}
+
+	return count;
+}
+
+JournalStats EditJournal::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	JournalStats stats = mStats;
+	stats.Durable = mDurableSequence;
+	return stats;
+}
+
+void EditJournal::FlushLoop()
+{
+	std::vector<JournalRecord> batch;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mQueued.wait(lock, [this] { return !mQueue.empty() || mStop; });
+			if (mQueue.empty())
+				return;
+		}
+
+		// Take the queue under the file lock so a rotation can't slip in
+		// between taking the records and writing them.
+		std::lock_guard<std::mutex> fileLock(mFileMutex);
+		std::uint64_t first;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			batch.swap(mQueue);
+			first = mQueueFirstSequence;
+		}
+
+		// Whatever queued up during the last sync goes out as one batch.
+		if (!batch.empty())
+			WriteBatch(batch, first);
+		batch.clear();
+	}
+}
+
+void EditJournal::WriteBatch(const std::vector<JournalRecord>& records, std::uint64_t firstSequence)
+{
+	BatchHeader header = {};
+	header.Magic = BatchMagic;
+	header.Count = (std::uint32_t)records.size();
+	header.FirstSequence = firstSequence;
+	header.Checksum = Crc32(records.data(), records.size() * sizeof(JournalRecord));
+
+	bool ok = WriteLog(&header, sizeof(header)) &&
+		WriteLog(records.data(), records.size() * sizeof(JournalRecord)) &&
+		SyncLog();
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (ok)
+		{
+			mDurableSequence = firstSequence + records.size() - 1;
+			mStats.Batches++;
+		}
+		else
+		{
+			mFailed = true;
+		}
+	}
+	mDurable.notify_all();
+}
+
+std::vector<ChunkSnapshot> EditJournal::SnapshotChunks(const World& world, const std::unordered_set<std::uint64_t>& keys)const
+{
+	std::vector<ChunkSnapshot> snapshots;
+	snapshots.reserve(keys.size());
+	for (std::uint64_t key : keys)
+	{
+		// Edits that only cleared blocks in a missing chunk leave it empty.
+		ChunkCoord coord = UnpackChunkCoord(key);
+		const Chunk* chunk = world.GetChunk(coord);
+		snapshots.push_back(chunk != nullptr ? chunk->Snapshot() : ChunkSnapshot(coord));
+	}
+
+	return snapshots;
+}
+
+bool EditJournal::SaveSnapshots(const std::vector<ChunkSnapshot>& snapshots, const std::vector<std::string>& logs, std::uint64_t sequence)
+{
+	// Write-ahead: a region holding an edit the log lost would be rolled
+	// back to an older edit on replay.
+	bool saved = WaitDurable(sequence);
+	for (std::size_t i = 0; saved && i < snapshots.size(); i++)
+		saved = mStore.SaveChunk(snapshots[i]);
+
+	// The logs may only go once the regions holding their edits are on disk.
+	saved = saved && mStore.Flush();
+	if (saved)
+	{
+		for (const std::string& log : logs)
+			std::remove(log.c_str());
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (saved)
+		mStats.Compactions++;
+	else
+		mStats.FailedCompactions++;
+	return saved;
+}
+
+bool EditJournal::OpenLog(const std::string& path)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	mFile = file;
+#else
+	mFile = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (mFile < 0)
+		return false;
+#endif
+
+	return true;
+}
+
+bool EditJournal::TruncateLog(const std::string& path, std::uint64_t size)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER end;
+	end.QuadPart = (LONGLONG)size;
+	bool truncated = SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+	CloseHandle(file);
+	return truncated;
+#else
+	return truncate(path.c_str(), (off_t)size) == 0;
+#endif
+}
+
+bool EditJournal::WriteLog(const void* data, std::size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0)
+	{
+#ifdef _WIN32
+		DWORD written = 0;
+		if (!WriteFile(mFile, bytes, (DWORD)size, &written, nullptr))
+			return false;
+#else
+		ssize_t written = write(mFile, bytes, size);
+		if (written <= 0)
+			return false;
+#endif
+		bytes += written;
+		size -= (std::size_t)written;
+	}
+
+	return true;
+}
+
+bool EditJournal::SyncLog()
+{
+#ifdef _WIN32
+	return FlushFileBuffers(mFile) != 0;
+#else
+	return fdatasync(mFile) == 0;
+#endif
+}
+
+void EditJournal::CloseLog()
+{
+#ifdef _WIN32
+	if (mFile != nullptr)
+		CloseHandle(mFile);
+	mFile = nullptr;
+#else
+	if (mFile >= 0)
+		close(mFile);
+	mFile = -1;
+#endif
+}
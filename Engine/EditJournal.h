@@ -0,0 +1,163 @@
+#pragma once
+
+#include "RegionFile.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// One block change as stored in the journal.
+struct JournalRecord
+{
+	std::int32_t X;
+	std::int32_t Y;
+	std::int32_t Z;
+	std::uint8_t Block;
+	std::uint8_t Pad[3];
+};
+
+static_assert(sizeof(JournalRecord) == 16, "JournalRecord is written to disk as is");
+
+struct JournalStats
+{
+	std::uint64_t Appended = 0;
+	std::uint64_t Durable = 0;
+	// Batches written; each one costs a single sync.
+	std::uint64_t Batches = 0;
+	std::size_t Replayed = 0;
+	// Batches dropped on replay because they were cut short or failed their checksum.
+	std::size_t TornBatches = 0;
+	std::size_t Compactions = 0;
+	// Compactions that couldn't write or flush every chunk; their log was kept.
+	std::size_t FailedCompactions = 0;
+	// Records in the current log, counting replayed ones it still holds.
+	std::uint64_t LogRecords = 0;
+};
+
+// Write-ahead log of block edits, kept next to the region files so edits
+// don't rewrite whole chunks and survive the process dying.
+//
+// Append() queues a record and returns straight away.  A flusher thread writes
+// everything queued so far as one checksummed batch and syncs it, so all the
+// edits that arrive during one sync share the next one (group commit).
+//
+// The region files are the checkpoint.  Open() replays any journal left by a
+// previous run on top of them and folds the result back in.  At runtime
+// BeginCompaction() switches to a fresh log and writes the chunks the old one
+// touched into the region files on a background thread, then deletes it.
+//
+// A log is only deleted once every chunk it touched has been saved and the
+// store flushed.  If that fails the log stays, and the next compaction
+// retries the same chunks before rotating again.
+class EditJournal
+{
+public:
+	explicit EditJournal(RegionStore& store);
+	EditJournal(const EditJournal& rhs) = delete;
+	EditJournal& operator=(const EditJournal& rhs) = delete;
+	~EditJournal();
+
+	// Call after the world has been loaded from the region store.  Returns
+	// false if the log can't be created.
+	bool Open(World& world);
+	// Syncs outstanding edits and stops the background threads.  The log is
+	// left on disk for the next Open() to replay.
+	void Close();
+
+	// Records an edit that has been (or is about to be) applied to the world.
+	// Returns its sequence number.
+	std::uint64_t Append(int x, int y, int z, BlockId id);
+	// Blocks until every edit appended so far is on disk.
+	void Sync();
+	// Sequence number of the last edit appended, or 0.
+	std::uint64_t GetLastSequence()const;
+	// Blocks until every edit up to sequence is on disk.  Returns false if
+	// the log failed before getting there.
+	bool WaitDurable(std::uint64_t sequence);
+
+	// Starts folding the current log into the region files, or retries a
+	// compaction that failed.  Returns false if there is nothing to fold or
+	// the log can't be rotated.  Other writers of the region store have to
+	// wait for the compaction, or an older snapshot could land after it.
+	bool BeginCompaction(const World& world);
+	void WaitForCompaction();
+	bool IsCompacting()const;
+
+	// Applies the records in a journal file to the world.  Stops at the
+	// first torn or corrupt batch, which is where a crash cut the log short.
+	// validBytes receives the length of the batches before it.
+	static std::size_t Replay(const std::string& path, World& world, std::unordered_set<std::uint64_t>* touched, std::size_t* tornBatches,
+		std::uint64_t* validBytes = nullptr);
+
+	JournalStats GetStats()const;
+
+	std::string GetLogPath()const { return mStore.GetDirectory() + "/journal.log"; }
+	std::string GetOldLogPath()const { return mStore.GetDirectory() + "/journal.old.log"; }
+
+private:
+	struct BatchHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Count;
+		std::uint64_t FirstSequence;
+		std::uint32_t Checksum;
+		std::uint32_t Reserved;
+	};
+
+	static const std::uint32_t BatchMagic = 0x4C4A5856; // "VXJL"
+
+	void FlushLoop();
+	// Writes and syncs one batch and publishes it as durable.  The caller
+	// holds mFileMutex.
+	void WriteBatch(const std::vector<JournalRecord>& records, std::uint64_t firstSequence);
+
+	std::vector<ChunkSnapshot> SnapshotChunks(const World& world, const std::unordered_set<std::uint64_t>& keys)const;
+	// Saves the snapshots and deletes the logs if every save and the flush
+	// succeeded.  Returns whether they did.  Snapshots may hold edits up to
+	// sequence, which have to be in the log before any region has them.
+	bool SaveSnapshots(const std::vector<ChunkSnapshot>& snapshots, const std::vector<std::string>& logs, std::uint64_t sequence);
+
+	bool OpenLog(const std::string& path);
+	// Cuts a log back to its valid batches so new ones aren't appended after
+	// a torn one, where replay would never reach them.
+	static bool TruncateLog(const std::string& path, std::uint64_t size);
+	bool WriteLog(const void* data, std::size_t size);
+	bool SyncLog();
+	void CloseLog();
+
+private:
+	RegionStore& mStore;
+
+	// Guards the queue, the sequence counters and the touched chunks.
+	mutable std::mutex mMutex;
+	std::condition_variable mQueued;
+	std::condition_variable mDurable;
+	std::vector<JournalRecord> mQueue;
+	std::uint64_t mNextSequence = 1;
+	std::uint64_t mQueueFirstSequence = 1;
+	std::uint64_t mDurableSequence = 0;
+	// Packed coordinates of chunks edited since the last rotation.
+	std::unordered_set<std::uint64_t> mTouched;
+	// Chunks of a retired log that hasn't been folded in yet.  Not empty
+	// while a compaction runs or after one failed.
+	std::unordered_set<std::uint64_t> mOldTouched;
+	bool mStop = false;
+	// Set when the log can't be written; Sync() stops waiting for it.
+	bool mFailed = false;
+	bool mCompacting = false;
+	JournalStats mStats;
+
+	// Held while the log file is written, synced or rotated.
+	std::mutex mFileMutex;
+	std::thread mFlusher;
+	std::thread mCompactor;
+
+#ifdef _WIN32
+	void* mFile = nullptr;
+#else
+	int mFile = -1;
+#endif
+};
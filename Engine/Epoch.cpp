@@ -0,0 +1,122 @@
+#include "Epoch.h"
+#include <thread>
+
+// Per-thread slot in the singleton manager, claimed on first use and handed
+// back when the thread exits.
+struct EpochThreadState
+{
+	int Slot = -1;
+	int Depth = 0;
+
+	~EpochThreadState()
+	{
+		if (Slot >= 0)
+			EpochManager::Get().ReleaseSlot(Slot);
+	}
+};
+
+namespace
+{
+	thread_local EpochThreadState tEpochState;
+}
+
+EpochManager& EpochManager::Get()
+{
+	static EpochManager manager;
+	return manager;
+}
+
+EpochManager::~EpochManager()
+{
+	// No thread can be reading any more, so everything can go.
+	for (auto& r : mRetired)
+		r.Deleter(r.Pointer);
+}
+
+void EpochManager::Enter()
+{
+	if (tEpochState.Depth++ > 0)
+		return;
+
+	if (tEpochState.Slot < 0)
+		tEpochState.Slot = AcquireSlot();
+
+	// Announce before touching shared data.  seq_cst orders this store before
+	// the reader's loads of any pointer a writer may be unlinking.
+	mSlots[tEpochState.Slot].Epoch.store(mGlobalEpoch.load());
+}
+
+void EpochManager::Leave()
+{
+	if (--tEpochState.Depth > 0)
+		return;
+
+	mSlots[tEpochState.Slot].Epoch.store(0, std::memory_order_release);
+}
+
+void EpochManager::RetireRaw(void* p, void(*deleter)(void*))
+{
+	std::lock_guard<std::mutex> lock(mRetiredMutex);
+	mRetired.push_back({ p, deleter, mGlobalEpoch.load() });
+}
+
+void EpochManager::Collect()
+{
+	// New critical sections announce at least the advanced epoch, so only the
+	// ones already running can still see anything retired before now.
+	mGlobalEpoch.fetch_add(1);
+
+	std::uint64_t oldest = UINT64_MAX;
+	for (auto& slot : mSlots)
+	{
+		std::uint64_t e = slot.Epoch.load();
+		if (e != 0 && e < oldest)
+			oldest = e;
+	}
+
+	std::vector<Retired> ready;
+	{
+		std::lock_guard<std::mutex> lock(mRetiredMutex);
+		auto keep = mRetired.begin();
+		for (auto it = mRetired.begin(); it != mRetired.end(); ++it)
+		{
+			if (it->Epoch < oldest)
+				ready.push_back(*it);
+			else
+				*keep++ = *it;
+		}
+		mRetired.erase(keep, mRetired.end());
+	}
+
+	for (auto& r : ready)
+		r.Deleter(r.Pointer);
+}
+
+std::size_t EpochManager::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mRetiredMutex);
+	return mRetired.size();
+}
+
+int EpochManager::AcquireSlot()
+{
+	for (;;)
+	{
+		for (int i = 0; i < MaxThreads; i++)
+		{
+			bool expected = false;
+			if (!mSlots[i].InUse.load(std::memory_order_relaxed) &&
+				mSlots[i].InUse.compare_exchange_strong(expected, true))
+				return i;
+		}
+
+		// More threads than slots; wait for one to exit.
+		std::this_thread::yield();
+	}
+}
+
+void EpochManager::ReleaseSlot(int slot)
+{
+	mSlots[slot].Epoch.store(0);
+	mSlots[slot].InUse.store(false, std::memory_order_release);
+}
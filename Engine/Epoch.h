@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Epoch-based memory reclamation.  Readers wrap lock-free accesses in an
+// EpochGuard; writers unlink an object and Retire() it instead of deleting it.
+// A retired object is freed once every thread that could have seen it has left
+// its critical section.
+class EpochManager
+{
+public:
+	static EpochManager& Get();
+
+	EpochManager() = default;
+	EpochManager(const EpochManager& rhs) = delete;
+	EpochManager& operator=(const EpochManager& rhs) = delete;
+	~EpochManager();
+
+	// Critical sections nest; only the outermost Enter/Leave pair publishes.
+	void Enter();
+	void Leave();
+
+	template<typename T>
+	void Retire(T* p)
+	{
+		RetireRaw(p, [](void* q) { delete static_cast<T*>(q); });
+	}
+
+	// Frees everything retired before the oldest active critical section.
+	void Collect();
+
+	std::size_t GetPendingCount();
+
+	// Threads that can be inside a critical section at the same time.
+	static const int MaxThreads = 64;
+
+private:
+	struct Retired
+	{
+		void* Pointer;
+		void(*Deleter)(void*);
+		std::uint64_t Epoch;
+	};
+
+	// One cache line per thread so announcing an epoch doesn't false-share.
+	struct alignas(64) ThreadSlot
+	{
+		// 0 while the thread is outside any critical section.
+		std::atomic<std::uint64_t> Epoch{ 0 };
+		std::atomic<bool> InUse{ false };
+	};
+
+	void RetireRaw(void* p, void(*deleter)(void*));
+	int AcquireSlot();
+	void ReleaseSlot(int slot);
+
+	friend struct EpochThreadState;
+
+private:
+	std::atomic<std::uint64_t> mGlobalEpoch{ 1 };
+	ThreadSlot mSlots[MaxThreads];
+
+	std::mutex mRetiredMutex;
+	std::vector<Retired> mRetired;
+};
+
+// Keeps the calling thread inside an epoch critical section for its lifetime.
+class EpochGuard
+{
+public:
+	EpochGuard() { EpochManager::Get().Enter(); }
+	~EpochGuard() { EpochManager::Get().Leave(); }
+	EpochGuard(const EpochGuard& rhs) = delete;
+	EpochGuard& operator=(const EpochGuard& rhs) = delete;
+};
@@ -0,0 +1,297 @@
+#include "FaceCulling.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FACE_CULLING_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+static_assert(gNumBlockTypes <= 16, "block ids must fit in four bit planes");
+static_assert(MeshPadSize <= 64, "a padded row must fit in a 64-bit mask");
+
+namespace
+{
+	const int PaddedRows = MeshPadSize * MeshPadSize;
+	const int IdPlanes = 4;
+
+	// One bit per cell of each padded row, bit x + 1 for chunk-local x.
+	struct RowMasks
+	{
+		std::uint64_t Solid[PaddedRows];
+		std::uint64_t Opaque[PaddedRows];
+		std::uint64_t Id[IdPlanes][PaddedRows];
+	};
+
+	const std::uint64_t RowBits = (1ull << MeshPadSize) - 1;
+
+	// Bit n set for every opaque BlockId n.
+	constexpr std::uint32_t OpaqueIds()
+	{
+		std::uint32_t ids = 0;
+		for (int i = 0; i < gNumBlockTypes; i++)
+		{
+			if (gBlockInfo[i].Flags & BlockFlag_Opaque)
+				ids |= 1u << i;
+		}
+
+		return ids;
+	}
+
+	int RowIndex(int y, int z)
+	{
+		return (y + 1) * MeshPadSize + (z + 1);
+	}
+
+	// Solid blocks are the ones with any id bit set.
+	void FinishRow(RowMasks& rows, int row)
+	{
+		rows.Solid[row] = rows.Id[0][row] | rows.Id[1][row] | rows.Id[2][row] | rows.Id[3][row];
+	}
+
+	void BuildRowMasks(const BlockId* padded, RowMasks& rows)
+	{
+		const std::uint64_t lowBits = 0x0101010101010101ull;
+		// Gathers the low bit of each byte into one byte, byte i to bit i.
+		const std::uint64_t gather = 0x0102040810204080ull;
+
+		for (int row = 0; row < PaddedRows; row++)
+		{
+			// Each cell becomes its id with the opaque flag in bit 4, then eight
+			// cells at a time are split into bit planes.
+			std::uint8_t codes[24] = {};
+			const BlockId* cells = &padded[row * MeshPadSize];
+			for (int x = 0; x < MeshPadSize; x++)
+			{
+				std::uint32_t id = (std::uint32_t)cells[x];
+				codes[x] = (std::uint8_t)(id | (((OpaqueIds() >> id) & 1) << 4));
+			}
+
+			std::uint64_t planes[IdPlanes + 1] = {};
+			for (int word = 0; word < 3; word++)
+			{
+				std::uint64_t w;
+				std::memcpy(&w, &codes[word * 8], sizeof(w));
+				for (int p = 0; p <= IdPlanes; p++)
+					planes[p] |= ((((w >> p) & lowBits) * gather) >> 56) << (word * 8);
+			}
+
+			for (int p = 0; p < IdPlanes; p++)
+				rows.Id[p][row] = planes[p];
+			rows.Opaque[row] = planes[IdPlanes];
+			FinishRow(rows, row);
+		}
+	}
+
+	// Faces of a row's solid blocks that the neighbouring row doesn't hide.
+	std::uint64_t VisibleFaces(const RowMasks& rows, int row, std::uint64_t nbOpaque, const std::uint64_t* nbId)
+	{
+		std::uint64_t differs = 0;
+		for (int p = 0; p < IdPlanes; p++)
+			differs |= rows.Id[p][row] ^ nbId[p];
+
+		return rows.Solid[row] & ~nbOpaque & differs;
+	}
+
+	std::uint16_t InteriorBits(std::uint64_t mask)
+	{
+		return (std::uint16_t)(mask >> 1);
+	}
+}
+
+std::size_t ChunkFaceMasks::GetFaceCount()const
+{
+	std::size_t count = 0;
+	for (int d = 0; d < gNumFaceDirections; d++)
+	{
+		for (std::uint16_t row : Rows[d])
+		{
+			for (; row != 0; row &= row - 1)
+				count++;
+		}
+	}
+
+	return count;
+}
+
+void CullHiddenFacesScalar(const BlockId* padded, ChunkFaceMasks& masks)
+{
+	RowMasks rows;
+	BuildRowMasks(padded, rows);
+
+	for (int y = 0; y < ChunkSize; y++)
+	{
+		for (int z = 0; z < ChunkSize; z++)
+		{
+			const int row = RowIndex(y, z);
+			const int out = (y << ChunkShift) | z;
+
+			// Neighbours along x are the same row shifted by one cell.
+			std::uint64_t nbId[IdPlanes];
+			for (int p = 0; p < IdPlanes; p++)
+				nbId[p] = rows.Id[p][row] >> 1;
+			masks.Rows[(int)FaceDirection::PosX][out] = InteriorBits(VisibleFaces(rows, row, rows.Opaque[row] >> 1, nbId));
+
+			for (int p = 0; p < IdPlanes; p++)
+				nbId[p] = rows.Id[p][row] << 1;
+			masks.Rows[(int)FaceDirection::NegX][out] = InteriorBits(VisibleFaces(rows, row, rows.Opaque[row] << 1, nbId));
+
+			// Along y and z they are whole neighbouring rows.
+			const int neighbours[4] = { row + MeshPadSize, row - MeshPadSize, row + 1, row - 1 };
+			for (int n = 0; n < 4; n++)
+			{
+				for (int p = 0; p < IdPlanes; p++)
+					nbId[p] = rows.Id[p][neighbours[n]];
+				masks.Rows[(int)FaceDirection::PosY + n][out] = InteriorBits(VisibleFaces(rows, row, rows.Opaque[neighbours[n]], nbId));
+			}
+		}
+	}
+}
+
+#ifdef FACE_CULLING_AVX2
+
+namespace
+{
+	AVX2_TARGET __m256i Load(const std::uint64_t* p)
+	{
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+	}
+
+	// Same as VisibleFaces for four consecutive rows; shift is +1 or -1 for a
+	// neighbour along x and 0 for a neighbour row at the given offset.
+	AVX2_TARGET __m256i VisibleFaces4(const RowMasks& rows, int row, int rowOffset, int shift)
+	{
+		const int nb = row + rowOffset;
+		__m256i nbOpaque = Load(&rows.Opaque[nb]);
+		__m256i differs = _mm256_setzero_si256();
+		for (int p = 0; p < IdPlanes; p++)
+		{
+			__m256i nbId = Load(&rows.Id[p][nb]);
+			if (shift > 0)
+				nbId = _mm256_srli_epi64(nbId, 1);
+			else if (shift < 0)
+				nbId = _mm256_slli_epi64(nbId, 1);
+			differs = _mm256_or_si256(differs, _mm256_xor_si256(Load(&rows.Id[p][row]), nbId));
+		}
+
+		if (shift > 0)
+			nbOpaque = _mm256_srli_epi64(nbOpaque, 1);
+		else if (shift < 0)
+			nbOpaque = _mm256_slli_epi64(nbOpaque, 1);
+
+		return _mm256_and_si256(_mm256_andnot_si256(nbOpaque, Load(&rows.Solid[row])), differs);
+	}
+
+	// BuildRowMasks with one 32-byte load per row: a byte shuffle looks up the
+	// opaque flag and movemask picks out one bit of every cell.
+	AVX2_TARGET void BuildRowMasksAvx2(const BlockId* padded, RowMasks& rows)
+	{
+		alignas(32) std::uint8_t opaqueTable[32];
+		for (int i = 0; i < 32; i++)
+			opaqueTable[i] = ((OpaqueIds() >> (i & 15)) & 1) ? 0x80 : 0;
+		const __m256i opaqueLookup = _mm256_load_si256(reinterpret_cast<const __m256i*>(opaqueTable));
+
+		// The last rows are copied out so the load doesn't run off the end.
+		const int safeRows = (MeshPadVolume - 32) / MeshPadSize + 1;
+		alignas(32) BlockId tail[32] = {};
+
+		for (int row = 0; row < PaddedRows; row++)
+		{
+			const BlockId* cells = &padded[row * MeshPadSize];
+			if (row >= safeRows)
+			{
+				std::memcpy(tail, cells, MeshPadSize * sizeof(BlockId));
+				cells = tail;
+			}
+
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells));
+			rows.Opaque[row] = (std::uint32_t)_mm256_movemask_epi8(_mm256_shuffle_epi8(opaqueLookup, v)) & RowBits;
+			rows.Id[0][row] = (std::uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(v, 7)) & RowBits;
+			rows.Id[1][row] = (std::uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(v, 6)) & RowBits;
+			rows.Id[2][row] = (std::uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(v, 5)) & RowBits;
+			rows.Id[3][row] = (std::uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(v, 4)) & RowBits;
+			FinishRow(rows, row);
+		}
+	}
+
+	AVX2_TARGET void StoreInterior(__m256i visible, std::uint16_t* dest)
+	{
+		alignas(32) std::uint64_t lanes[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_srli_epi64(visible, 1));
+		for (int i = 0; i < 4; i++)
+			dest[i] = (std::uint16_t)lanes[i];
+	}
+}
+
+AVX2_TARGET void CullHiddenFacesAvx2(const BlockId* padded, ChunkFaceMasks& masks)
+{
+	RowMasks rows;
+	BuildRowMasksAvx2(padded, rows);
+
+	// The rows for z = 0..ChunkSize-1 at one y are contiguous, so each group of
+	// four is one load.
+	for (int y = 0; y < ChunkSize; y++)
+	{
+		for (int z = 0; z < ChunkSize; z += 4)
+		{
+			const int row = RowIndex(y, z);
+			const int out = (y << ChunkShift) | z;
+
+			StoreInterior(VisibleFaces4(rows, row, 0, 1), &masks.Rows[(int)FaceDirection::PosX][out]);
+			StoreInterior(VisibleFaces4(rows, row, 0, -1), &masks.Rows[(int)FaceDirection::NegX][out]);
+			StoreInterior(VisibleFaces4(rows, row, MeshPadSize, 0), &masks.Rows[(int)FaceDirection::PosY][out]);
+			StoreInterior(VisibleFaces4(rows, row, -MeshPadSize, 0), &masks.Rows[(int)FaceDirection::NegY][out]);
+			StoreInterior(VisibleFaces4(rows, row, 1, 0), &masks.Rows[(int)FaceDirection::PosZ][out]);
+			StoreInterior(VisibleFaces4(rows, row, -1, 0), &masks.Rows[(int)FaceDirection::NegZ][out]);
+		}
+	}
+}
+
+bool IsAvx2Supported()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// The OS has to save the YMM registers as well.
+	__cpuid(info, 1);
+	const int osxsaveAndAvx = (1 << 27) | (1 << 28);
+	if ((info[2] & osxsaveAndAvx) != osxsaveAndAvx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#else
+
+void CullHiddenFacesAvx2(const BlockId* padded, ChunkFaceMasks& masks)
+{
+	CullHiddenFacesScalar(padded, masks);
+}
+
+bool IsAvx2Supported()
+{
+	return false;
+}
+
+#endif
+
+void CullHiddenFaces(const BlockId* padded, ChunkFaceMasks& masks)
+{
+	static const bool useAvx2 = IsAvx2Supported();
+	if (useAvx2)
+		CullHiddenFacesAvx2(padded, masks);
+	else
+		CullHiddenFacesScalar(padded, masks);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ChunkMesher.h"
+#include <cstddef>
+#include <cstdint>
+
+// Exposed faces of one chunk, as decided by ChunkMesher::IsFaceVisible.  Bit x
+// of Rows[direction][y * ChunkSize + z] is set when the face of block (x, y, z)
+// pointing in that direction is visible.
+struct ChunkFaceMasks
+{
+	std::uint16_t Rows[gNumFaceDirections][ChunkSize * ChunkSize];
+
+	bool IsVisible(FaceDirection direction, int x, int y, int z)const
+	{
+		return ((Rows[(int)direction][(y << ChunkShift) | z] >> x) & 1) != 0;
+	}
+
+	std::size_t GetFaceCount()const;
+};
+
+// Finds the exposed faces of a padded chunk (see ChunkMesher::GatherBlocks) a
+// whole row at a time.  Each padded row is packed into 64-bit masks: one for
+// solid blocks, one for opaque blocks and four bit planes of the block id.  A
+// face is visible when the block is solid, the neighbour isn't opaque and the
+// two ids differ in some bit plane, which covers water and leaves hiding their
+// own faces without a per-type pass.  Neighbours along x are a shift away;
+// along y and z they are the adjacent rows.
+//
+// CullHiddenFaces uses the AVX2 kernel, four rows per instruction, when the CPU
+// supports it and the scalar kernel otherwise.  Both give identical masks.
+void CullHiddenFaces(const BlockId* padded, ChunkFaceMasks& masks);
+void CullHiddenFacesScalar(const BlockId* padded, ChunkFaceMasks& masks);
+void CullHiddenFacesAvx2(const BlockId* padded, ChunkFaceMasks& masks);
+
+// True if this build has an AVX2 kernel and the CPU and OS can run it.
+bool IsAvx2Supported();
@@ -1,6 +1,36 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameCommandList::FrameCommandList(ID3D12Device* device)
+{
+    ThrowIfFailed(device->CreateCommandAllocator(
+        D3D12_COMMAND_LIST_TYPE_DIRECT,
+        IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
+
+    ThrowIfFailed(device->CreateCommandList(
+        0,
+        D3D12_COMMAND_LIST_TYPE_DIRECT,
+        CmdListAlloc.Get(),
+        nullptr,
+        IID_PPV_ARGS(List.GetAddressOf())));
+
+    // Command lists are created open; Reset() expects a closed one.
+    ThrowIfFailed(List->Close());
+}
+
+void FrameCommandList::Reset()
+{
+    ThrowIfFailed(CmdListAlloc->Reset());
+    ThrowIfFailed(List->Reset(CmdListAlloc.Get(), nullptr));
+}
+
+void FrameCommandList::Close()
+{
+    ThrowIfFailed(List->Close());
+}
+
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT translucentIndexCount, UINT blockInstanceCount,
+    UINT indirectCommandCount, UINT indirectGroupCount) :
+    ThreadCmdLists([device]() { return std::unique_ptr<RecordingList>(new FrameCommandList(device)); })
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -10,6 +40,10 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
     PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
     MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    TranslucentIB = std::make_unique<UploadBuffer<std::uint32_t>>(device, translucentIndexCount, false);
+    BlockInstances = std::make_unique<UploadBuffer<BlockInstance>>(device, blockInstanceCount, false);
+    IndirectArgs = std::make_unique<UploadBuffer<IndirectCommand>>(device, indirectCommandCount, false);
+    IndirectCounts = std::make_unique<UploadBuffer<std::uint32_t>>(device, indirectGroupCount, false);
 }
 
 FrameResource::~FrameResource()
@@ -3,6 +3,9 @@
 #include "Common/d3dUtil.h"
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
+#include "BlockInstances.h"
+#include "IndirectDraws.h"
+#include "ParallelRecorder.h"
 
 struct ObjectConstants
 {
@@ -48,13 +51,29 @@ struct Vertex
 	DirectX::XMFLOAT2 TexC;
 };
 
+// The command list and allocator one recording thread uses for a frame.
+class FrameCommandList : public RecordingList
+{
+public:
+    explicit FrameCommandList(ID3D12Device* device);
+
+    void Reset() override;
+    void Close() override;
+
+    ID3D12GraphicsCommandList* Get()const { return List.Get(); }
+
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> List;
+};
+
 // Stores the resources needed for the CPU to build the command lists
 // for a frame.  
 struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT translucentIndexCount, UINT blockInstanceCount,
+        UINT indirectCommandCount, UINT indirectGroupCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -63,6 +82,10 @@ public:
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
+    // FrameCommandLists of the threads recording draws in parallel, made as
+    // more threads need one.
+    RecordingListPool ThreadCmdLists;
+
     // We cannot update a cbuffer until the GPU is done processing the commands
     // that reference it.  So each frame needs their own cbuffers.
    // std::unique_ptr<UploadBuffer<FrameConstants>> FrameCB = nullptr;
@@ -70,6 +93,17 @@ public:
     std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
+    // Translucent chunk indices in back-to-front order.  The order changes as
+    // the camera moves, so each frame needs its own copy too.
+    std::unique_ptr<UploadBuffer<std::uint32_t>> TranslucentIB = nullptr;
+
+    // Blocks for the instanced path, read by BlockVS as a structured buffer.
+    std::unique_ptr<UploadBuffer<BlockInstance>> BlockInstances = nullptr;
+
+    // Argument and count buffers of the indirect draws, rebuilt every frame.
+    std::unique_ptr<UploadBuffer<IndirectCommand>> IndirectArgs = nullptr;
+    std::unique_ptr<UploadBuffer<std::uint32_t>> IndirectCounts = nullptr;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
@@ -0,0 +1,89 @@
+#include "IndirectDraws.h"
+#include <algorithm>
+
+void IndirectDrawBuilder::Clear()
+{
+	mCommands.clear();
+	mGroups.clear();
+	mPasses.clear();
+	mCounts.clear();
+	mStats = IndirectDrawStats();
+}
+
+void IndirectDrawBuilder::BeginPass()
+{
+	mPassCommands.clear();
+	mPassMaterials.clear();
+}
+
+void IndirectDrawBuilder::Add(const IndirectCommand& command, std::uint32_t material, bool visible)
+{
+	mStats.Added++;
+	if (!visible || command.IndexCountPerInstance == 0 || command.InstanceCount == 0)
+	{
+		mStats.Culled++;
+		return;
+	}
+
+	mPassCommands.push_back(command);
+	mPassMaterials.push_back(material);
+}
+
+void IndirectDrawBuilder::EndPass(bool ordered)
+{
+	IndirectPass pass;
+	pass.FirstGroup = (std::uint32_t)mGroups.size();
+
+	const std::size_t count = mPassCommands.size();
+	const std::size_t first = mCommands.size();
+	mCommands.resize(first + count);
+
+	if (ordered)
+	{
+		std::copy(mPassCommands.begin(), mPassCommands.end(), mCommands.begin() + first);
+	}
+	else
+	{
+		// Counting sort by material, which keeps the order within each one.
+		std::uint32_t materialCount = 0;
+		for (std::uint32_t m : mPassMaterials)
+			materialCount = std::max(materialCount, m + 1);
+		mMaterialCounts.assign(materialCount + 1, 0);
+		for (std::uint32_t m : mPassMaterials)
+			mMaterialCounts[m + 1]++;
+		for (std::uint32_t m = 0; m < materialCount; m++)
+			mMaterialCounts[m + 1] += mMaterialCounts[m];
+
+		for (std::size_t i = 0; i < count; i++)
+			mCommands[first + mMaterialCounts[mPassMaterials[i]]++] = mPassCommands[i];
+
+		// Each material's count now ends where its commands do.
+		std::size_t i = 0;
+		for (std::uint32_t m = 0; m < materialCount; m++)
+		{
+			while (i < mMaterialCounts[m])
+				mPassMaterials[i++] = m;
+		}
+	}
+
+	// Runs of one material become the groups.
+	for (std::size_t i = 0; i < count; i++)
+	{
+		if (i == 0 || mPassMaterials[i] != mPassMaterials[i - 1])
+		{
+			IndirectGroup group;
+			group.Material = mPassMaterials[i];
+			group.FirstCommand = (std::uint32_t)(first + i);
+			mGroups.push_back(group);
+			mCounts.push_back(0);
+		}
+		mGroups.back().CommandCount++;
+		mCounts.back()++;
+	}
+
+	pass.GroupCount = (std::uint32_t)mGroups.size() - pass.FirstGroup;
+	mPasses.push_back(pass);
+
+	mStats.Commands = mCommands.size();
+	mStats.Groups = mGroups.size();
+}
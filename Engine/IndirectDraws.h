@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One command of the chunk command signature in CrateApp, laid out like its
+// arguments: D3D12_VERTEX_BUFFER_VIEW, D3D12_INDEX_BUFFER_VIEW, a root
+// constant with the chunk's object slot, then D3D12_DRAW_INDEXED_ARGUMENTS.
+// CrateApp checks the sizes against the D3D12 structs.
+struct IndirectCommand
+{
+	std::uint64_t VertexBufferLocation = 0;
+	std::uint32_t VertexBufferSize = 0;
+	std::uint32_t VertexStride = 0;
+
+	std::uint64_t IndexBufferLocation = 0;
+	std::uint32_t IndexBufferSize = 0;
+	// DXGI_FORMAT.
+	std::uint32_t IndexFormat = 0;
+
+	std::uint32_t ChunkIndex = 0;
+
+	std::uint32_t IndexCountPerInstance = 0;
+	std::uint32_t InstanceCount = 1;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
+	std::uint32_t StartInstanceLocation = 0;
+};
+
+static_assert(sizeof(IndirectCommand) == 56, "IndirectCommand must match the command signature's byte stride");
+
+// Commands of one pass that share a material, submitted with one
+// ExecuteIndirect.  The material's texture can't change inside it.
+struct IndirectGroup
+{
+	std::uint32_t Material = 0;
+	std::uint32_t FirstCommand = 0;
+	std::uint32_t CommandCount = 0;
+};
+
+// The groups of one pass, in submission order.
+struct IndirectPass
+{
+	std::uint32_t FirstGroup = 0;
+	std::uint32_t GroupCount = 0;
+};
+
+struct IndirectDrawStats
+{
+	std::size_t Added = 0;
+	std::size_t Culled = 0;
+	std::size_t Commands = 0;
+	std::size_t Groups = 0;
+};
+
+// Packs the draws of a frame into one argument buffer for ExecuteIndirect.
+//
+// Draws are added pass by pass.  Hidden draws and draws with no indices are
+// compacted out as they are added, the way a culling pass on the GPU would
+// write them.  An unordered pass is then sorted by material, so it needs one
+// ExecuteIndirect per material; an ordered pass, like the back-to-front
+// translucent one, keeps its order and starts a new group whenever the
+// material changes.
+//
+// The count buffer has one entry per group, holding its command count.  The
+// CPU fills it with the full count; a GPU culling pass would write fewer.
+class IndirectDrawBuilder
+{
+public:
+	void Clear();
+
+	void BeginPass();
+	void Add(const IndirectCommand& command, std::uint32_t material, bool visible = true);
+	void EndPass(bool ordered);
+
+	const std::vector<IndirectCommand>& GetCommands()const { return mCommands; }
+	const std::vector<IndirectGroup>& GetGroups()const { return mGroups; }
+	const std::vector<IndirectPass>& GetPasses()const { return mPasses; }
+	// One entry per group: the count buffer ExecuteIndirect reads.
+	const std::vector<std::uint32_t>& GetCounts()const { return mCounts; }
+	const IndirectDrawStats& GetStats()const { return mStats; }
+
+private:
+	std::vector<IndirectCommand> mCommands;
+	std::vector<IndirectGroup> mGroups;
+	std::vector<IndirectPass> mPasses;
+	std::vector<std::uint32_t> mCounts;
+	IndirectDrawStats mStats;
+
+	// Commands and materials of the open pass.
+	std::vector<IndirectCommand> mPassCommands;
+	std::vector<std::uint32_t> mPassMaterials;
+	std::vector<std::uint32_t> mMaterialCounts;
+};
@@ -0,0 +1,189 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+namespace
+{
+	// Triangles using each vertex, as offsets into one flat list.
+	template<typename Index>
+	void BuildVertexTriangles(const std::vector<Index>& indices, std::size_t vertexCount,
+		std::vector<std::uint32_t>& offsets, std::vector<std::uint32_t>& triangles)
+	{
+		offsets.assign(vertexCount + 1, 0);
+		for (Index i : indices)
+			offsets[i + 1]++;
+		for (std::size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+
+		std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		triangles.resize(indices.size());
+		for (std::size_t i = 0; i < indices.size(); i++)
+			triangles[fill[indices[i]]++] = (std::uint32_t)(i / 3);
+	}
+}
+
+template<typename Index>
+VertexCacheStats AnalyzeVertexCache(const std::vector<Index>& indices, std::size_t vertexCount, int cacheSize)
+{
+	VertexCacheStats stats;
+	stats.Triangles = indices.size() / 3;
+
+	// A vertex is still cached while fewer than cacheSize misses have come
+	// after the one that loaded it.
+	std::vector<std::size_t> loadedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	for (Index i : indices)
+	{
+		if (!used[i])
+		{
+			used[i] = true;
+			stats.Vertices++;
+		}
+		else if (stats.Transforms - loadedAt[i] < (std::size_t)cacheSize)
+		{
+			continue;
+		}
+
+		loadedAt[i] = stats.Transforms;
+		stats.Transforms++;
+	}
+	return stats;
+}
+
+template<typename Index>
+void OptimizeVertexCache(std::vector<Index>& indices, std::size_t vertexCount, int cacheSize)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<std::uint32_t> offsets, adjacency;
+	BuildVertexTriangles(indices, vertexCount, offsets, adjacency);
+
+	std::vector<std::uint32_t> live(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+
+	// Time stamps start cacheSize + 1 ahead so that no vertex starts cached.
+	std::vector<std::size_t> cachedAt(vertexCount, 0);
+	std::size_t time = (std::size_t)cacheSize + 1;
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<std::uint32_t> deadEnds;
+	std::vector<std::uint32_t> candidates;
+	std::vector<Index> output;
+	output.reserve(indices.size());
+
+	std::size_t cursor = 0;
+	auto skipDeadEnd = [&]() -> std::int64_t
+	{
+		// Go back to a recently used vertex with triangles left, and failing
+		// that to the next one in input order.
+		while (!deadEnds.empty())
+		{
+			std::uint32_t d = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[d] > 0)
+				return d;
+		}
+		while (cursor < vertexCount)
+		{
+			if (live[cursor] > 0)
+				return (std::int64_t)cursor++;
+			cursor++;
+		}
+		return -1;
+	};
+
+	std::int64_t fan = skipDeadEnd();
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (std::uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++)
+		{
+			std::uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+
+			for (int k = 0; k < 3; k++)
+			{
+				Index v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cachedAt[v] > (std::size_t)cacheSize)
+					cachedAt[v] = time++;
+			}
+		}
+
+		// Next, the candidate that will still be cached after its remaining
+		// triangles are emitted and has been there longest.
+		std::int64_t next = -1;
+		std::int64_t best = -1;
+		for (std::uint32_t v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+
+			std::int64_t priority = 0;
+			if (time - cachedAt[v] + 2 * live[v] <= (std::size_t)cacheSize)
+				priority = (std::int64_t)(time - cachedAt[v]);
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		fan = next >= 0 ? next : skipDeadEnd();
+	}
+
+	indices.swap(output);
+}
+
+template<typename Index>
+std::size_t OptimizeVertexFetch(std::vector<Index>& indices, std::size_t vertexCount, std::vector<std::uint32_t>& remap)
+{
+	const std::uint32_t unassigned = 0xFFFFFFFF;
+	remap.assign(vertexCount, unassigned);
+
+	std::uint32_t next = 0;
+	for (Index& i : indices)
+	{
+		if (remap[i] == unassigned)
+			remap[i] = next++;
+		i = (Index)remap[i];
+	}
+
+	const std::size_t used = next;
+	for (std::uint32_t& r : remap)
+	{
+		if (r == unassigned)
+			r = next++;
+	}
+	return used;
+}
+
+template VertexCacheStats AnalyzeVertexCache(const std::vector<std::uint16_t>&, std::size_t, int);
+template VertexCacheStats AnalyzeVertexCache(const std::vector<std::uint32_t>&, std::size_t, int);
+template void OptimizeVertexCache(std::vector<std::uint16_t>&, std::size_t, int);
+template void OptimizeVertexCache(std::vector<std::uint32_t>&, std::size_t, int);
+template std::size_t OptimizeVertexFetch(std::vector<std::uint16_t>&, std::size_t, std::vector<std::uint32_t>&);
+template std::size_t OptimizeVertexFetch(std::vector<std::uint32_t>&, std::size_t, std::vector<std::uint32_t>&);
+
+MeshOptimizeStats OptimizeMesh(GeometryGenerator::MeshData& mesh, int cacheSize)
+{
+	MeshOptimizeStats stats;
+	stats.Before = AnalyzeVertexCache(mesh.Indices32, mesh.Vertices.size(), cacheSize);
+
+	WeldVertices(mesh.Vertices, mesh.Indices32);
+	OptimizeVertexCache(mesh.Indices32, mesh.Vertices.size(), cacheSize);
+
+	std::vector<std::uint32_t> remap;
+	OptimizeVertexFetch(mesh.Indices32, mesh.Vertices.size(), remap);
+	RemapVertices(mesh.Vertices, remap);
+
+	stats.After = AnalyzeVertexCache(mesh.Indices32, mesh.Vertices.size(), cacheSize);
+	return stats;
+}
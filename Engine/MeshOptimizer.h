@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Common/GeometryGenerator.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Entries in the post-transform vertex cache the optimizer plans for and the
+// statistics simulate.  The cache is modelled as FIFO, like the hardware.
+const int VertexCacheSize = 16;
+
+// How well an index list reuses transformed vertices.
+struct VertexCacheStats
+{
+	std::size_t Triangles = 0;
+	// Distinct vertices the indices use.
+	std::size_t Vertices = 0;
+	// Vertices transformed, counting every cache miss.
+	std::size_t Transforms = 0;
+
+	// Average cache miss ratio: transforms per triangle.  0.5 is the ideal for
+	// a large regular mesh, 3 is no reuse at all.
+	double GetAcmr()const { return Triangles != 0 ? (double)Transforms / Triangles : 0.0; }
+	// Average transform to vertex ratio: 1 means every vertex is transformed
+	// only once.
+	double GetAtvr()const { return Vertices != 0 ? (double)Transforms / Vertices : 0.0; }
+};
+
+// Merges vertices with identical contents and points the indices at the
+// first of each.  Subdivide splits every triangle into four with vertices of
+// their own, so a subdivided mesh has nothing for the cache to reuse until
+// it is welded.  Returns how many vertices are left.
+template<typename Vertex, typename Index>
+std::size_t WeldVertices(std::vector<Vertex>& vertices, std::vector<Index>& indices)
+{
+	std::unordered_map<std::string, std::uint32_t> firstOf;
+	std::vector<std::uint32_t> remap(vertices.size());
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < vertices.size(); i++)
+	{
+		std::string key((const char*)&vertices[i], sizeof(Vertex));
+		auto inserted = firstOf.emplace(key, (std::uint32_t)kept);
+		if (inserted.second)
+			vertices[kept++] = vertices[i];
+		remap[i] = inserted.first->second;
+	}
+	vertices.resize(kept);
+
+	for (Index& i : indices)
+		i = (Index)remap[i];
+	return kept;
+}
+
+// Runs the triangle list through a FIFO cache of cacheSize entries.
+template<typename Index>
+VertexCacheStats AnalyzeVertexCache(const std::vector<Index>& indices, std::size_t vertexCount, int cacheSize = VertexCacheSize);
+
+// Reorders the triangles for post-transform cache hits with Tipsify (Sander,
+// Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw").  It fans around one vertex at a time and moves on to a
+// neighbour that is still in the cache.  Runs in linear time, so it is cheap
+// enough to use when meshes are built.  Triangles keep their winding.
+template<typename Index>
+void OptimizeVertexCache(std::vector<Index>& indices, std::size_t vertexCount, int cacheSize = VertexCacheSize);
+
+// Renumbers the vertices in the order the indices first use them, so vertex
+// fetches walk through memory, and rewrites the indices to match.  remap
+// gets each old vertex's new position; vertices no index uses go last.
+// Returns how many vertices the indices use.
+template<typename Index>
+std::size_t OptimizeVertexFetch(std::vector<Index>& indices, std::size_t vertexCount, std::vector<std::uint32_t>& remap);
+
+// Moves the vertices to the positions OptimizeVertexFetch chose.
+template<typename Vertex>
+void RemapVertices(std::vector<Vertex>& vertices, const std::vector<std::uint32_t>& remap)
+{
+	std::vector<Vertex> reordered(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); i++)
+		reordered[remap[i]] = vertices[i];
+	vertices.swap(reordered);
+}
+
+// Cache statistics before and after an optimization pass.
+struct MeshOptimizeStats
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+// Welds the vertices, optimizes the indices for the vertex cache, then the
+// vertices for fetch.  Run it before GetIndices16, which keeps its own copy
+// of the indices.
+MeshOptimizeStats OptimizeMesh(GeometryGenerator::MeshData& mesh, int cacheSize = VertexCacheSize);
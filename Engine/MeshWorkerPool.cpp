@@ -0,0 +1,119 @@
+#include "MeshWorkerPool.h"
+#include "ChunkLod.h"
+#include <algorithm>
+#include <chrono>
+
+MeshWorkerPool::MeshWorkerPool(int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+	for (int i = 0; i < threadCount; i++)
+		mThreads.emplace_back(&MeshWorkerPool::WorkerLoop, this);
+}
+
+MeshWorkerPool::~MeshWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+		mJobs.clear();
+	}
+	mWake.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+
+	ChunkMesh mesh;
+	while (PopCompleted(mesh))
+	{
+	}
+}
+
+void MeshWorkerPool::Submit(const World& world, const ChunkCoord& coord, int lod)
+{
+	std::unique_ptr<ChunkNeighbourhood> job(new ChunkNeighbourhood(ChunkNeighbourhood::Capture(world, coord)));
+	job->Lod = lod;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(std::move(job));
+	}
+	mWake.notify_one();
+
+	mPending++;
+	mSubmitted++;
+}
+
+bool MeshWorkerPool::PopCompleted(ChunkMesh& mesh)
+{
+	if (mReady == nullptr)
+	{
+		// Take everything pushed so far and reverse it into completion order.
+		Completed* list = mCompleted.exchange(nullptr, std::memory_order_acquire);
+		while (list != nullptr)
+		{
+			Completed* next = list->Next;
+			list->Next = mReady;
+			mReady = list;
+			list = next;
+		}
+
+		if (mReady == nullptr)
+			return false;
+	}
+
+	Completed* node = mReady;
+	mReady = node->Next;
+	mesh = std::move(node->Mesh);
+	delete node;
+
+	mPending--;
+	return true;
+}
+
+MeshWorkerStats MeshWorkerPool::GetStats()const
+{
+	MeshWorkerStats stats;
+	stats.Submitted = mSubmitted;
+	stats.Completed = mCompletedCount.load();
+	stats.WorkerMs = mWorkerNanoseconds.load() / 1.0e6;
+	return stats;
+}
+
+void MeshWorkerPool::WorkerLoop()
+{
+	ChunkMesher mesher;
+	std::vector<BlockId> padded(MeshPadVolume);
+	std::vector<BlockId> coarse(MeshPadVolume);
+
+	for (;;)
+	{
+		std::unique_ptr<ChunkNeighbourhood> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this] { return mStop || !mJobs.empty(); });
+			if (mStop)
+				return;
+
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		Completed* node = new Completed();
+		job->GatherBlocks(padded.data());
+		MeshChunkLod(mesher, job->Coord, padded.data(), job->Lod, LodSelection::Surface, coarse.data(), node->Mesh);
+		// Let the chunks stop sharing their storage as soon as possible.
+		job.reset();
+
+		Completed* head = mCompleted.load(std::memory_order_relaxed);
+		do
+		{
+			node->Next = head;
+		} while (!mCompleted.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+
+		mCompletedCount++;
+		mWorkerNanoseconds += (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ChunkMesher.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct MeshWorkerStats
+{
+	std::uint64_t Submitted = 0;
+	std::uint64_t Completed = 0;
+	// Time the workers spent gathering and meshing, summed over all threads.
+	double WorkerMs = 0.0;
+};
+
+// Meshes chunks on a pool of worker threads.
+//
+// Submit() runs on the thread that edits the world.  It captures a
+// ChunkNeighbourhood, which only takes snapshots, so the workers never read
+// live chunks.  Finished meshes go onto a lock-free completion list that the
+// same thread drains with PopCompleted(), e.g. once per frame.
+//
+// Chunks edited while one of their jobs is queued copy their storage first,
+// like they do for a save.
+class MeshWorkerPool
+{
+public:
+	// 0 threads means one per hardware thread, less one for the caller.
+	explicit MeshWorkerPool(int threadCount = 0);
+	MeshWorkerPool(const MeshWorkerPool& rhs) = delete;
+	MeshWorkerPool& operator=(const MeshWorkerPool& rhs) = delete;
+	~MeshWorkerPool();
+
+	// lod is the level of detail to mesh at (see ChunkLod.h).
+	void Submit(const World& world, const ChunkCoord& coord, int lod = 0);
+
+	// Takes the oldest finished mesh.  Returns false if none is ready.
+	bool PopCompleted(ChunkMesh& mesh);
+
+	// Jobs submitted whose meshes haven't been popped yet.
+	std::size_t GetPendingCount()const { return mPending; }
+	int GetThreadCount()const { return (int)mThreads.size(); }
+	MeshWorkerStats GetStats()const;
+
+private:
+	struct Completed
+	{
+		ChunkMesh Mesh;
+		Completed* Next = nullptr;
+	};
+
+	void WorkerLoop();
+
+private:
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::deque<std::unique_ptr<ChunkNeighbourhood>> mJobs;
+	bool mStop = false;
+
+	// Workers push finished meshes here (newest first) with a CAS; the owner
+	// takes the whole list at once and keeps it in mReady, oldest first.
+	std::atomic<Completed*> mCompleted{ nullptr };
+	Completed* mReady = nullptr;
+	std::size_t mPending = 0;
+
+	std::uint64_t mSubmitted = 0;
+	std::atomic<std::uint64_t> mCompletedCount{ 0 };
+	std::atomic<std::uint64_t> mWorkerNanoseconds{ 0 };
+
+	std::vector<std::thread> mThreads;
+};
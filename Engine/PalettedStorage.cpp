@@ -0,0 +1,233 @@
+#include "PalettedStorage.h"
+#include <algorithm>
+
+PalettedStorage::PalettedStorage(int size, BlockId fill)
+	: mSize(size)
+{
+	mPalette.push_back(fill);
+	mRefCounts.push_back((std::uint16_t)size);
+	mUsedEntries = 1;
+}
+
+BlockId PalettedStorage::Set(int index, BlockId id)
+{
+	BlockId old = Get(index);
+	if (old == id)
+		return old;
+
+	int newEntry = FindPaletteEntry(id);
+	if (newEntry < 0)
+		newEntry = AddPaletteEntry(id);
+
+	// Adding an entry can repack the indices, so only read the old one now.
+	int oldEntry = ReadIndex(index);
+	WriteIndex(index, newEntry);
+
+	mRefCounts[newEntry]++;
+	if (--mRefCounts[oldEntry] == 0)
+	{
+		mUsedEntries--;
+		// Down to one type always goes uniform; there's no width to bounce
+		// back to that would be cheaper than dropping the indices.
+		if (mUsedEntries == 1 || BitsForEntries(mUsedEntries) < NarrowerBits(mBits))
+			Compact();
+	}
+
+	return old;
+}
+
+void PalettedStorage::CopyTo(BlockId* dest)const
+{
+	if (mBits == 0)
+	{
+		std::fill(dest, dest + mSize, mPalette[0]);
+		return;
+	}
+
+	const int perWord = 64 >> mShift;
+	int index = 0;
+	for (std::uint64_t word : mData)
+	{
+		for (int i = 0; i < perWord && index < mSize; i++, index++)
+		{
+			dest[index] = mPalette[word & mIndexMask];
+			word >>= mBits;
+		}
+	}
+}
+
+void PalettedStorage::Assign(const BlockId* src)
+{
+	int counts[256] = {};
+	for (int i = 0; i < mSize; i++)
+		counts[(int)src[i]]++;
+
+	mPalette.clear();
+	mRefCounts.clear();
+
+	int lookup[256];
+	for (int id = 0; id < 256; id++)
+	{
+		lookup[id] = -1;
+		if (counts[id] > 0)
+		{
+			lookup[id] = (int)mPalette.size();
+			mPalette.push_back((BlockId)id);
+			mRefCounts.push_back((std::uint16_t)counts[id]);
+		}
+	}
+
+	// An empty volume still needs one entry for the uniform path.
+	if (mPalette.empty())
+	{
+		mPalette.push_back(BlockId::Air);
+		mRefCounts.push_back(0);
+	}
+
+	std::vector<std::uint8_t> indices(mSize);
+	for (int i = 0; i < mSize; i++)
+		indices[i] = (std::uint8_t)lookup[(int)src[i]];
+
+	mUsedEntries = (int)mPalette.size();
+	Rewrite(BitsForEntries(mUsedEntries), indices);
+}
+
+int PalettedStorage::GetCount(BlockId id)const
+{
+	int entry = FindPaletteEntry(id);
+	return entry < 0 ? 0 : mRefCounts[entry];
+}
+
+std::size_t PalettedStorage::GetMemoryUsage()const
+{
+	return sizeof(PalettedStorage) +
+		mPalette.capacity() * sizeof(BlockId) +
+		mRefCounts.capacity() * sizeof(std::uint16_t) +
+		mData.capacity() * sizeof(std::uint64_t);
+}
+
+int PalettedStorage::FindPaletteEntry(BlockId id)const
+{
+	// The palette only ever holds a handful of entries, so a linear search wins.
+	for (size_t i = 0; i < mPalette.size(); i++)
+	{
+		if (mPalette[i] == id && mRefCounts[i] > 0)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+int PalettedStorage::AddPaletteEntry(BlockId id)
+{
+	// Reuse an entry whose blocks have all been overwritten.
+	for (size_t i = 0; i < mPalette.size(); i++)
+	{
+		if (mRefCounts[i] == 0)
+		{
+			mPalette[i] = id;
+			mUsedEntries++;
+			return (int)i;
+		}
+	}
+
+	mPalette.push_back(id);
+	mRefCounts.push_back(0);
+	mUsedEntries++;
+
+	int needed = BitsForEntries((int)mPalette.size());
+	if (needed > mBits)
+		Repack(needed);
+
+	return (int)mPalette.size() - 1;
+}
+
+void PalettedStorage::Repack(int newBits)
+{
+	std::vector<std::uint8_t> indices(mSize);
+	for (int i = 0; i < mSize; i++)
+		indices[i] = (std::uint8_t)ReadIndex(i);
+
+	Rewrite(newBits, indices);
+}
+
+void PalettedStorage::Compact()
+{
+	// Drop the unused palette entries, then shrink the indices to fit.
+	std::vector<std::uint8_t> remap(mPalette.size(), 0);
+	std::vector<BlockId> palette;
+	std::vector<std::uint16_t> refCounts;
+	for (size_t i = 0; i < mPalette.size(); i++)
+	{
+		if (mRefCounts[i] > 0)
+		{
+			remap[i] = (std::uint8_t)palette.size();
+			palette.push_back(mPalette[i]);
+			refCounts.push_back(mRefCounts[i]);
+		}
+	}
+
+	std::vector<std::uint8_t> indices(mSize);
+	for (int i = 0; i < mSize; i++)
+		indices[i] = remap[ReadIndex(i)];
+
+	mPalette.swap(palette);
+	mRefCounts.swap(refCounts);
+	mUsedEntries = (int)mPalette.size();
+
+	Rewrite(BitsForEntries(mUsedEntries), indices);
+}
+
+void PalettedStorage::Rewrite(int newBits, const std::vector<std::uint8_t>& indices)
+{
+	mBits = newBits;
+	mShift = 0;
+	while (mBits > 0 && (1 << mShift) < mBits)
+		mShift++;
+	mIndexMask = (1ull << mBits) - 1;
+	mData.assign(mBits == 0 ? 0 : (mSize * mBits + 63) / 64, 0);
+	mData.shrink_to_fit();
+
+	if (mBits > 0)
+	{
+		for (int i = 0; i < mSize; i++)
+			WriteIndex(i, indices[i]);
+	}
+}
+
+void PalettedStorage::WriteIndex(int index, int paletteIndex)
+{
+	const int perWord = 64 >> mShift;
+	std::uint64_t& word = mData[index >> (6 - mShift)];
+	int slot = (index & (perWord - 1)) << mShift;
+	word = (word & ~(mIndexMask << slot)) | ((std::uint64_t)paletteIndex << slot);
+}
+
+int PalettedStorage::ReadIndex(int index)const
+{
+	if (mBits == 0)
+		return 0;
+
+	const int perWord = 64 >> mShift;
+	std::uint64_t word = mData[index >> (6 - mShift)];
+	int slot = (index & (perWord - 1)) << mShift;
+	return (int)((word >> slot) & mIndexMask);
+}
+
+int PalettedStorage::NarrowerBits(int bits)
+{
+	return bits <= 1 ? 0 : bits / 2;
+}
+
+int PalettedStorage::BitsForEntries(int entries)
+{
+	if (entries <= 1)
+		return 0;
+	if (entries <= 2)
+		return 1;
+	if (entries <= 4)
+		return 2;
+	if (entries <= 16)
+		return 4;
+	return 8;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Block.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stores a fixed number of BlockIds as indices into a small local palette.
+// Indices are bit-packed at 0, 1, 2, 4 or 8 bits each so they never straddle a
+// 64-bit word.  The width grows when a new type is added.  It only shrinks once
+// the types in use fit two widths down, so adding and removing one type at a
+// width boundary doesn't repack every index twice, or once a single type is
+// left; Assign() (e.g. when a frozen chunk thaws) always picks the narrowest
+// width.  Zero bits is the uniform fast
+// path: the whole volume is palette entry 0 and no index array is allocated.
+class PalettedStorage
+{
+public:
+	explicit PalettedStorage(int size, BlockId fill = BlockId::Air);
+
+	BlockId Get(int index)const
+	{
+		if (mBits == 0)
+			return mPalette[0];
+
+		const int perWord = 64 >> mShift;
+		std::uint64_t word = mData[index >> (6 - mShift)];
+		int slot = (index & (perWord - 1)) << mShift;
+		return mPalette[(word >> slot) & mIndexMask];
+	}
+
+	// Returns the block that was replaced.
+	BlockId Set(int index, BlockId id);
+
+	// Decodes every entry into dest, which must hold GetSize() ids.
+	void CopyTo(BlockId* dest)const;
+	// Replaces the whole contents from a dense array of GetSize() ids.
+	void Assign(const BlockId* src);
+
+	int GetSize()const { return mSize; }
+	int GetBitsPerBlock()const { return mBits; }
+	bool IsUniform()const { return mBits == 0; }
+	// Number of blocks of the given type.
+	int GetCount(BlockId id)const;
+	std::size_t GetMemoryUsage()const;
+
+private:
+	int FindPaletteEntry(BlockId id)const;
+	int AddPaletteEntry(BlockId id);
+	void Repack(int newBits);
+	void Compact();
+	// Sets the index width and writes every palette index back in.
+	void Rewrite(int newBits, const std::vector<std::uint8_t>& indices);
+	void WriteIndex(int index, int paletteIndex);
+	int ReadIndex(int index)const;
+
+	static int BitsForEntries(int entries);
+	// The index width one step below bits.
+	static int NarrowerBits(int bits);
+
+private:
+	int mSize = 0;
+	int mBits = 0;
+	int mShift = 0; // log2(mBits), unused when mBits == 0
+	std::uint64_t mIndexMask = 0;
+	int mUsedEntries = 0;
+
+	std::vector<BlockId> mPalette;
+	std::vector<std::uint16_t> mRefCounts;
+	std::vector<std::uint64_t> mData;
+};
@@ -0,0 +1,151 @@
+#include "ParallelRecorder.h"
+#include <algorithm>
+#include <chrono>
+
+RecordingList* const* RecordingListPool::Acquire(std::size_t count)
+{
+	while (mLists.size() < count)
+	{
+		mLists.push_back(mFactory());
+		mPointers.push_back(mLists.back().get());
+	}
+	return mPointers.data();
+}
+
+std::vector<DrawRange> SplitDrawRanges(std::size_t drawCount, int maxRanges, std::size_t minDraws)
+{
+	std::vector<DrawRange> ranges;
+	if (drawCount == 0)
+		return ranges;
+
+	std::size_t count = drawCount / std::max<std::size_t>(minDraws, 1);
+	count = std::max<std::size_t>(1, std::min(count, (std::size_t)std::max(maxRanges, 1)));
+
+	// The first drawCount % count ranges take one draw more.
+	const std::size_t size = drawCount / count;
+	const std::size_t extra = drawCount % count;
+	std::size_t begin = 0;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		DrawRange range;
+		range.Begin = begin;
+		range.End = begin + size + (i < extra ? 1 : 0);
+		ranges.push_back(range);
+		begin = range.End;
+	}
+	return ranges;
+}
+
+ParallelRecorder::ParallelRecorder(int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (int i = 1; i < threadCount; i++)
+		mThreads.emplace_back(&ParallelRecorder::WorkerLoop, this);
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+}
+
+std::size_t ParallelRecorder::Record(std::size_t drawCount, std::size_t minDrawsPerList, RecordingListPool& pool, const RecordFunction& record)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<DrawRange> ranges = SplitDrawRanges(drawCount, GetThreadCount(), minDrawsPerList);
+	RecordingList* const* lists = pool.Acquire(ranges.size());
+	const std::size_t rangeCount = ranges.size();
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRecord = &record;
+		mLists = lists;
+		mRanges.swap(ranges);
+		mNextRange = 0;
+		mRangesDone = 0;
+		mError = nullptr;
+		mGeneration++;
+	}
+	if (rangeCount > 1)
+		mWake.notify_all();
+
+	RecordRanges();
+
+	std::exception_ptr error;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDone.wait(lock, [&]() { return mRangesDone == mRanges.size(); });
+		mRecord = nullptr;
+		mLists = nullptr;
+		error = mError;
+		mError = nullptr;
+	}
+	if (error)
+		std::rethrow_exception(error);
+
+	mStats.Draws = drawCount;
+	mStats.Ranges = rangeCount;
+	mStats.RecordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return rangeCount;
+}
+
+void ParallelRecorder::WorkerLoop()
+{
+	std::uint64_t seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&]() { return mStop || mGeneration != seen; });
+			if (mStop)
+				return;
+			seen = mGeneration;
+		}
+
+		RecordRanges();
+	}
+}
+
+void ParallelRecorder::RecordRanges()
+{
+	for (;;)
+	{
+		const RecordFunction* record;
+		RecordingList* list;
+		DrawRange range;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mRecord == nullptr || mNextRange == mRanges.size())
+				return;
+			record = mRecord;
+			list = mLists[mNextRange];
+			range = mRanges[mNextRange];
+			mNextRange++;
+		}
+
+		try
+		{
+			list->Reset();
+			(*record)(*list, range);
+			list->Close();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mError)
+				mError = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (++mRangesDone == mRanges.size())
+			mDone.notify_all();
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A command list one thread records into, with its allocator.  FrameResource
+// wraps the D3D12 ones; the benchmark records into a mock.
+class RecordingList
+{
+public:
+	virtual ~RecordingList() {}
+
+	// Resets the allocator and list for a new frame.  The GPU must be done
+	// with what was recorded the last time.
+	virtual void Reset() = 0;
+	virtual void Close() = 0;
+};
+
+// Lists of one frame resource, one per recording range.  They are made on
+// first use and kept, so a frame only resets them.
+class RecordingListPool
+{
+public:
+	typedef std::function<std::unique_ptr<RecordingList>()> Factory;
+
+	explicit RecordingListPool(Factory factory) : mFactory(std::move(factory)) {}
+
+	// The first count lists, making any that are missing.
+	RecordingList* const* Acquire(std::size_t count);
+
+	std::size_t GetSize()const { return mLists.size(); }
+
+private:
+	Factory mFactory;
+	std::vector<std::unique_ptr<RecordingList>> mLists;
+	std::vector<RecordingList*> mPointers;
+};
+
+// A contiguous run of the draw list: [Begin, End).
+struct DrawRange
+{
+	std::size_t Begin = 0;
+	std::size_t End = 0;
+};
+
+// Splits drawCount draws into at most maxRanges contiguous ranges whose
+// sizes differ by at most one.  Ranges are never smaller than minDraws, so
+// short lists aren't spread over more lists than they're worth.
+std::vector<DrawRange> SplitDrawRanges(std::size_t drawCount, int maxRanges, std::size_t minDraws);
+
+struct ParallelRecordStats
+{
+	std::size_t Draws = 0;
+	std::size_t Ranges = 0;
+	// Time Record() took, from the split to the last list closing.
+	double RecordMs = 0.0;
+};
+
+// Records a draw list into several command lists at once.
+//
+// Record() splits the draws with SplitDrawRanges and hands range i to list
+// i, so submitting the lists in order with one ExecuteCommandLists keeps
+// the draw order no matter which thread recorded which range.  The calling
+// thread records too and Record() returns once every list is closed.  An
+// exception thrown by the callback is rethrown on the calling thread.
+//
+// The callback runs on several threads at once: it may only touch its own
+// list and state nobody is writing to.
+class ParallelRecorder
+{
+public:
+	typedef std::function<void(RecordingList& list, const DrawRange& range)> RecordFunction;
+
+	// 0 threads means one per hardware thread.  The calling thread counts as
+	// one, so threadCount - 1 workers are started.
+	explicit ParallelRecorder(int threadCount = 0);
+	ParallelRecorder(const ParallelRecorder& rhs) = delete;
+	ParallelRecorder& operator=(const ParallelRecorder& rhs) = delete;
+	~ParallelRecorder();
+
+	// Returns the number of ranges, which is how many lists of pool to submit.
+	std::size_t Record(std::size_t drawCount, std::size_t minDrawsPerList, RecordingListPool& pool, const RecordFunction& record);
+
+	int GetThreadCount()const { return (int)mThreads.size() + 1; }
+	const ParallelRecordStats& GetStats()const { return mStats; }
+
+private:
+	void WorkerLoop();
+	// Records ranges until none are left.
+	void RecordRanges();
+
+private:
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	bool mStop = false;
+	std::uint64_t mGeneration = 0;
+
+	// The job of the current Record(), guarded by mMutex.
+	const RecordFunction* mRecord = nullptr;
+	RecordingList* const* mLists = nullptr;
+	std::vector<DrawRange> mRanges;
+	std::size_t mNextRange = 0;
+	std::size_t mRangesDone = 0;
+	std::exception_ptr mError;
+
+	ParallelRecordStats mStats;
+	std::vector<std::thread> mThreads;
+};
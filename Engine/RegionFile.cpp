@@ -0,0 +1,590 @@
+#include "RegionFile.h"
+#include "Crc32.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+RegionFile::~RegionFile()
+{
+	Close();
+}
+
+bool RegionFile::Open(const std::string& path, bool create)
+{
+	Close();
+	mPath = path;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+		create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	mFile = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		Close();
+		return false;
+	}
+	std::size_t size = (std::size_t)fileSize.QuadPart;
+#else
+	mFile = open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+	if (mFile < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(mFile, &st) != 0)
+	{
+		Close();
+		return false;
+	}
+	std::size_t size = (std::size_t)st.st_size;
+#endif
+
+	const std::size_t headerBytes = (std::size_t)HeaderSectors * RegionSectorSize;
+	bool mapped = false;
+	bool fresh = create && size == 0;
+	if (create && size == headerBytes)
+	{
+		// A crash before a new region's header reached the disk leaves it all
+		// zeros.  It can't hold any chunks, so it is set up again like a new one.
+		if (!Map(size))
+		{
+			Close();
+			return false;
+		}
+		mapped = true;
+		fresh = std::all_of(mView, mView + headerBytes, [](std::uint8_t b) { return b == 0; });
+	}
+
+	if (fresh)
+	{
+		if (!mapped && !Resize(headerBytes))
+		{
+			Close();
+			return false;
+		}
+
+		std::memset(mView, 0, headerBytes);
+		GetHeader()->Magic = Magic;
+		GetHeader()->Version = Version;
+		mUsedSectors.assign(HeaderSectors, true);
+
+		// The header goes to disk straight away so the file never exists
+		// without one.
+		if (!FlushView())
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	if (size < headerBytes || (!mapped && !Map(size)) || GetHeader()->Magic != Magic || GetHeader()->Version != Version)
+	{
+		Close();
+		return false;
+	}
+
+	// Rebuild the free map.  Entries that point outside the file or overlap
+	// another chunk are dropped rather than trusted.
+	std::uint32_t sectorCount = (std::uint32_t)(size / RegionSectorSize);
+	mUsedSectors.assign(sectorCount, false);
+	MarkSectors(0, HeaderSectors, true);
+	for (RegionEntry& entry : GetHeader()->Entries)
+	{
+		if (entry.Sector == 0)
+			continue;
+
+		std::uint32_t count = SectorsFor(entry.Length);
+		bool valid = entry.Length > 0 && entry.Sector >= HeaderSectors &&
+			entry.Sector <= sectorCount && count <= sectorCount - entry.Sector;
+		for (std::uint32_t i = 0; valid && i < count; i++)
+			valid = !mUsedSectors[entry.Sector + i];
+
+		if (valid)
+			MarkSectors(entry.Sector, count, true);
+		else
+			entry = RegionEntry{};
+	}
+
+	return true;
+}
+
+void RegionFile::Close()
+{
+	// Unflushed writes would otherwise be lost with the table.
+	if (!mPendingEntries.empty())
+		Flush();
+	Unmap();
+
+#ifdef _WIN32
+	if (mFile != nullptr)
+		CloseHandle(mFile);
+	mFile = nullptr;
+#else
+	if (mFile >= 0)
+		close(mFile);
+	mFile = -1;
+#endif
+
+	mSize = 0;
+	mUsedSectors.clear();
+	mPendingEntries.clear();
+	mPendingFrees.clear();
+}
+
+bool RegionFile::HasChunk(int slot)const
+{
+	return GetEntry(slot).Sector != 0;
+}
+
+bool RegionFile::ReadChunk(int slot, BlockId* dest)const
+{
+	const RegionEntry entry = GetEntry(slot);
+	if (entry.Sector == 0)
+		return false;
+
+	const std::uint8_t* data = mView + (std::size_t)entry.Sector * RegionSectorSize;
+	if (Crc32(data, entry.Length) != entry.Checksum || !RleColumns::Validate(data, entry.Length))
+		return false;
+
+	RleColumns::Decode(data, dest);
+	return true;
+}
+
+bool RegionFile::WriteChunk(int slot, const RleColumns& blocks)
+{
+	const std::vector<std::uint8_t>& data = blocks.GetData();
+
+	// May grow and remap the file, so nothing above holds a pointer into it.
+	std::uint32_t sector = AllocateSectors(SectorsFor(data.size()));
+	if (sector == 0)
+		return false;
+
+	std::memcpy(mView + (std::size_t)sector * RegionSectorSize, data.data(), data.size());
+
+	RegionEntry entry;
+	entry.Sector = sector;
+	entry.Length = (std::uint32_t)data.size();
+	entry.Checksum = Crc32(data.data(), data.size());
+	SetEntry(slot, entry);
+	return true;
+}
+
+void RegionFile::EraseChunk(int slot)
+{
+	if (GetEntry(slot).Sector == 0)
+		return;
+
+	SetEntry(slot, RegionEntry{});
+}
+
+RegionFile::RegionEntry RegionFile::GetEntry(int slot)const
+{
+	if (!mPendingEntries.empty())
+	{
+		auto it = mPendingEntries.find(slot);
+		if (it != mPendingEntries.end())
+			return it->second;
+	}
+
+	return GetHeader()->Entries[slot];
+}
+
+void RegionFile::SetEntry(int slot, const RegionEntry& entry)
+{
+	auto it = mPendingEntries.find(slot);
+	if (it != mPendingEntries.end())
+	{
+		if (it->second.Sector != 0)
+			MarkSectors(it->second.Sector, SectorsFor(it->second.Length), false);
+		it->second = entry;
+		return;
+	}
+
+	const RegionEntry& stored = GetHeader()->Entries[slot];
+	if (stored.Sector != 0)
+		mPendingFrees.emplace_back(stored.Sector, SectorsFor(stored.Length));
+	mPendingEntries[slot] = entry;
+}
+
+bool RegionFile::Flush()
+{
+	if (mView == nullptr)
+		return false;
+
+	if (mPendingEntries.empty())
+		return FlushView();
+
+	// The payloads have to be on disk before any entry points at them.
+	if (!FlushView())
+		return false;
+
+	for (auto& e : mPendingEntries)
+		GetHeader()->Entries[e.first] = e.second;
+	mPendingEntries.clear();
+
+	// If the header didn't make it the file may still point at the old
+	// sectors, so they stay reserved until the file is reopened.
+	if (!FlushView())
+	{
+		mPendingFrees.clear();
+		return false;
+	}
+
+	for (auto& f : mPendingFrees)
+		MarkSectors(f.first, f.second, false);
+	mPendingFrees.clear();
+	return true;
+}
+
+bool RegionFile::FlushView()
+{
+#ifdef _WIN32
+	return FlushViewOfFile(mView, 0) && FlushFileBuffers(mFile);
+#else
+	return msync(mView, mSize, MS_SYNC) == 0;
+#endif
+}
+
+std::size_t RegionFile::GetChunkCount()const
+{
+	std::size_t count = 0;
+	for (int slot = 0; slot < RegionChunkCount; slot++)
+	{
+		if (GetEntry(slot).Sector != 0)
+			count++;
+	}
+
+	return count;
+}
+
+void RegionFile::EvictFromCache(const std::string& path)
+{
+#ifdef _WIN32
+	// Opening a file unbuffered purges its cached pages.
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+		OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file >= 0)
+	{
+		posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+		close(file);
+	}
+#endif
+}
+
+std::uint32_t RegionFile::AllocateSectors(std::uint32_t count)
+{
+	std::uint32_t sectorCount = (std::uint32_t)mUsedSectors.size();
+	std::uint32_t runStart = HeaderSectors;
+	for (std::uint32_t i = HeaderSectors; i < sectorCount; i++)
+	{
+		if (mUsedSectors[i])
+		{
+			runStart = i + 1;
+		}
+		else if (i + 1 - runStart == count)
+		{
+			MarkSectors(runStart, count, true);
+			return runStart;
+		}
+	}
+
+	// runStart is now the start of the free tail.  Grow by at least half so a
+	// full save doesn't remap once per chunk.
+	std::uint32_t newCount = runStart + count;
+	if (newCount < sectorCount + sectorCount / 2)
+		newCount = sectorCount + sectorCount / 2;
+
+	if (!Resize((std::size_t)newCount * RegionSectorSize))
+		return 0;
+
+	MarkSectors(runStart, count, true);
+	return runStart;
+}
+
+void RegionFile::MarkSectors(std::uint32_t first, std::uint32_t count, bool used)
+{
+	for (std::uint32_t i = 0; i < count; i++)
+		mUsedSectors[first + i] = used;
+}
+
+bool RegionFile::Map(std::size_t size)
+{
+#ifdef _WIN32
+	LARGE_INTEGER mapSize;
+	mapSize.QuadPart = (LONGLONG)size;
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READWRITE, mapSize.HighPart, mapSize.LowPart, nullptr);
+	if (mMapping == nullptr)
+		return false;
+
+	void* view = MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (view == nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+		return false;
+	}
+#else
+	void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+	if (view == MAP_FAILED)
+		return false;
+#endif
+
+	mView = static_cast<std::uint8_t*>(view);
+	mSize = size;
+	return true;
+}
+
+void RegionFile::Unmap()
+{
+	if (mView == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mView);
+	CloseHandle(mMapping);
+	mMapping = nullptr;
+#else
+	munmap(mView, mSize);
+#endif
+
+	mView = nullptr;
+}
+
+bool RegionFile::Resize(std::size_t size)
+{
+	std::size_t oldSize = mSize;
+	Unmap();
+
+#ifdef _WIN32
+	LARGE_INTEGER newSize;
+	newSize.QuadPart = (LONGLONG)size;
+	bool resized = SetFilePointerEx(mFile, newSize, nullptr, FILE_BEGIN) && SetEndOfFile(mFile);
+#else
+	bool resized = ftruncate(mFile, (off_t)size) == 0;
+#endif
+
+	// Keep the old mapping usable if the file couldn't grow.
+	if (!resized)
+	{
+		if (oldSize > 0)
+			Map(oldSize);
+		return false;
+	}
+
+	if (!Map(size))
+		return false;
+
+	mUsedSectors.resize(size / RegionSectorSize, false);
+	return true;
+}
+
+RegionStore::RegionStore(const std::string& directory)
+	: mDirectory(directory)
+{
+}
+
+bool RegionStore::SaveChunk(const Chunk& chunk)
+{
+	BlockId blocks[ChunkVolume];
+	chunk.CopyBlocks(blocks);
+	if (!SaveChunk(chunk.GetCoord(), blocks))
+		return false;
+
+	chunk.ClearDirty();
+	return true;
+}
+
+bool RegionStore::SaveChunk(const ChunkSnapshot& snapshot)
+{
+	BlockId blocks[ChunkVolume];
+	snapshot.CopyBlocks(blocks);
+	return SaveChunk(snapshot.GetCoord(), blocks);
+}
+
+bool RegionStore::SaveChunk(const ChunkCoord& coord, const BlockId* blocks)
+{
+	bool empty = std::all_of(blocks, blocks + ChunkVolume, [](BlockId id) { return id == BlockId::Air; });
+	RleColumns encoded;
+	if (!empty)
+		encoded.Encode(blocks);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	RegionFile* region = GetRegion(ToRegionCoord(coord), !empty);
+	if (region == nullptr)
+		return empty;
+
+	if (empty)
+	{
+		region->EraseChunk(RegionSlot(coord));
+		return true;
+	}
+
+	if (!region->WriteChunk(RegionSlot(coord), encoded))
+		return false;
+
+	mChunksSaved++;
+	return true;
+}
+
+std::size_t RegionStore::SaveWorld(const World& world)
+{
+	std::size_t count = 0;
+	world.ForEachChunk([&](const Chunk& chunk)
+	{
+		if (!chunk.IsEmpty() && SaveChunk(chunk))
+			count++;
+	});
+
+	return count;
+}
+
+bool RegionStore::LoadChunk(World& world, const ChunkCoord& coord)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	RegionFile* region = GetRegion(ToRegionCoord(coord), false);
+	if (region == nullptr || !region->HasChunk(RegionSlot(coord)))
+		return false;
+
+	BlockId blocks[ChunkVolume];
+	if (!region->ReadChunk(RegionSlot(coord), blocks))
+	{
+		mCorruptChunks++;
+		return false;
+	}
+
+	// Freshly loaded blocks match what's on disk.
+	world.AssignChunk(coord, blocks);
+	world.GetChunk(coord)->ClearDirty();
+	mChunksLoaded++;
+	return true;
+}
+
+std::size_t RegionStore::LoadArea(World& world, const ChunkCoord& minChunk, const ChunkCoord& maxChunk)
+{
+	RegionCoord minRegion = ToRegionCoord(minChunk);
+	RegionCoord maxRegion = ToRegionCoord(maxChunk);
+
+	std::size_t count = 0;
+	for (int ry = minRegion.Y; ry <= maxRegion.Y; ry++)
+	{
+		for (int rz = minRegion.Z; rz <= maxRegion.Z; rz++)
+		{
+			for (int rx = minRegion.X; rx <= maxRegion.X; rx++)
+			{
+				RegionCoord r;
+				r.X = rx;
+				r.Y = ry;
+				r.Z = rz;
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					if (GetRegion(r, false) == nullptr)
+						continue;
+				}
+
+				// Only the part of the region inside the requested box.
+				ChunkCoord lo{ rx << RegionShift, ry << RegionHeightShift, rz << RegionShift };
+				ChunkCoord hi{ lo.X + RegionSize - 1, lo.Y + RegionHeight - 1, lo.Z + RegionSize - 1 };
+				for (int y = std::max(lo.Y, minChunk.Y); y <= std::min(hi.Y, maxChunk.Y); y++)
+					for (int z = std::max(lo.Z, minChunk.Z); z <= std::min(hi.Z, maxChunk.Z); z++)
+						for (int x = std::max(lo.X, minChunk.X); x <= std::min(hi.X, maxChunk.X); x++)
+							if (LoadChunk(world, ChunkCoord{ x, y, z }))
+								count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+bool RegionStore::Flush()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	bool flushed = true;
+	for (auto& e : mRegions)
+		flushed = e.second->Flush() && flushed;
+
+	return flushed;
+}
+
+void RegionStore::Close(bool evict)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto& e : mRegions)
+	{
+		std::string path = e.second->GetPath();
+		e.second->Flush();
+		e.second->Close();
+		if (evict)
+			RegionFile::EvictFromCache(path);
+	}
+
+	mRegions.clear();
+}
+
+void RegionStore::EnsureDirectory()const
+{
+	// Fails harmlessly if the directory already exists.
+#ifdef _WIN32
+	CreateDirectoryA(mDirectory.c_str(), nullptr);
+#else
+	mkdir(mDirectory.c_str(), 0755);
+#endif
+}
+
+RegionStoreStats RegionStore::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	RegionStoreStats stats;
+	stats.OpenRegions = mRegions.size();
+	stats.ChunksSaved = mChunksSaved;
+	stats.ChunksLoaded = mChunksLoaded;
+	stats.CorruptChunks = mCorruptChunks;
+	for (auto& e : mRegions)
+		stats.FileBytes += e.second->GetFileSize();
+
+	return stats;
+}
+
+RegionFile* RegionStore::GetRegion(const RegionCoord& coord, bool create)
+{
+	std::uint64_t key = PackChunkCoord(ChunkCoord{ coord.X, coord.Y, coord.Z });
+	auto it = mRegions.find(key);
+	if (it != mRegions.end())
+		return it->second.get();
+
+	if (create)
+		EnsureDirectory();
+
+	auto region = std::make_unique<RegionFile>();
+	if (!region->Open(GetRegionPath(coord), create))
+		return nullptr;
+
+	RegionFile* result = region.get();
+	mRegions[key] = std::move(region);
+	return result;
+}
+
+std::string RegionStore::GetRegionPath(const RegionCoord& coord)const
+{
+	return mDirectory + "/r." + std::to_string(coord.X) + "." + std::to_string(coord.Y) + "." +
+		std::to_string(coord.Z) + ".vxr";
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "World.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Chunks are saved in region files that each cover RegionSize x RegionHeight x
+// RegionSize chunks.  The generated maps are one chunk tall, so a region is a
+// 512x128x512 block slab.
+const int RegionShift = 5;
+const int RegionSize = 1 << RegionShift;
+const int RegionHeightShift = 3;
+const int RegionHeight = 1 << RegionHeightShift;
+const int RegionChunkCount = RegionSize * RegionHeight * RegionSize;
+
+// Payloads are allocated in whole sectors.  A frozen chunk from the default map
+// is around 1.5KB, so small sectors waste less than 4KB pages would.
+const int RegionSectorSize = 512;
+
+// Region position in region units.
+struct RegionCoord
+{
+	int X = 0;
+	int Y = 0;
+	int Z = 0;
+};
+
+inline RegionCoord ToRegionCoord(const ChunkCoord& c)
+{
+	RegionCoord r;
+	r.X = c.X >> RegionShift;
+	r.Y = c.Y >> RegionHeightShift;
+	r.Z = c.Z >> RegionShift;
+	return r;
+}
+
+// Index of a chunk within its region's table.
+inline int RegionSlot(const ChunkCoord& c)
+{
+	int x = c.X & (RegionSize - 1);
+	int y = c.Y & (RegionHeight - 1);
+	int z = c.Z & (RegionSize - 1);
+	return (y << (2 * RegionShift)) | (z << RegionShift) | x;
+}
+
+// One memory-mapped region file.
+//
+// On-disk layout (native little-endian):
+//   header      magic, version and a RegionEntry per slot, padded to whole sectors
+//   payloads    RleColumns bytes for each stored chunk, starting on a sector
+//
+// Reading a chunk is a table lookup, a checksum over the mapped bytes and a
+// decode straight out of the mapping.  Writes go through the mapping too; the
+// file grows (and is remapped) when it runs out of free sectors.  Not thread-safe.
+//
+// Stored payloads are never overwritten.  A write goes to newly allocated
+// sectors and its table entry is held back until Flush() has written the
+// payloads; only then is the header changed and flushed, and only after that
+// are the old sectors reused.  A crash at any point leaves either the old or
+// the new copy of each chunk readable.
+class RegionFile
+{
+public:
+	RegionFile() = default;
+	RegionFile(const RegionFile& rhs) = delete;
+	RegionFile& operator=(const RegionFile& rhs) = delete;
+	~RegionFile();
+
+	// Opens and maps the file, creating an empty region if create is set and
+	// the file doesn't exist or is only a zeroed header.  A new header is
+	// flushed before this returns.  Returns false on I/O errors or a bad header.
+	bool Open(const std::string& path, bool create);
+	void Close();
+	bool IsOpen()const { return mView != nullptr; }
+
+	bool HasChunk(int slot)const;
+	// Decodes ChunkVolume blocks into dest.  Returns false if the slot is empty
+	// or the payload fails its checksum.
+	bool ReadChunk(int slot, BlockId* dest)const;
+	// Stores encoded blocks in new sectors.  Reads see the new copy at once;
+	// the file keeps the old one until the next Flush().
+	bool WriteChunk(int slot, const RleColumns& blocks);
+	void EraseChunk(int slot);
+
+	// Writes the payloads back to disk, then the table entries of the writes
+	// since the last flush, then frees the sectors those writes replaced.
+	// Returns false if either step fails; the old sectors stay reserved.
+	bool Flush();
+
+	std::size_t GetChunkCount()const;
+	std::size_t GetFileSize()const { return mSize; }
+	const std::string& GetPath()const { return mPath; }
+
+	// Asks the OS to drop a closed, flushed file's pages from its cache so the
+	// next reads come from disk.  Used to measure cold loads.
+	static void EvictFromCache(const std::string& path);
+
+	static const std::uint32_t Magic = 0x47525856; // "VXRG"
+	static const std::uint32_t Version = 1;
+
+private:
+	struct RegionEntry
+	{
+		// First sector of the payload; 0 means the slot is empty.
+		std::uint32_t Sector;
+		std::uint32_t Length;
+		std::uint32_t Checksum;
+	};
+
+	struct RegionHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint32_t Reserved[2];
+		RegionEntry Entries[RegionChunkCount];
+	};
+
+	static const std::uint32_t HeaderSectors = (sizeof(RegionHeader) + RegionSectorSize - 1) / RegionSectorSize;
+
+	RegionHeader* GetHeader()const { return reinterpret_cast<RegionHeader*>(mView); }
+	// The slot's entry including writes not flushed yet.
+	RegionEntry GetEntry(int slot)const;
+	// Stages a new entry for the slot.  Sectors of an earlier unflushed write
+	// were never in the header, so they are freed at once.
+	void SetEntry(int slot, const RegionEntry& entry);
+	bool FlushView();
+	static std::uint32_t SectorsFor(std::size_t bytes) { return (std::uint32_t)((bytes + RegionSectorSize - 1) / RegionSectorSize); }
+
+	// First-fit search of the free map; grows the file if nothing fits.
+	std::uint32_t AllocateSectors(std::uint32_t count);
+	void MarkSectors(std::uint32_t first, std::uint32_t count, bool used);
+
+	bool Map(std::size_t size);
+	void Unmap();
+	bool Resize(std::size_t size);
+
+private:
+	std::string mPath;
+	std::uint8_t* mView = nullptr;
+	std::size_t mSize = 0;
+	// One flag per sector, rebuilt from the table on open.
+	std::vector<bool> mUsedSectors;
+	// Entries written since the last flush, by slot, and the sectors of the
+	// flushed entries they replace.
+	std::unordered_map<int, RegionEntry> mPendingEntries;
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> mPendingFrees;
+
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+};
+
+struct RegionStoreStats
+{
+	std::size_t OpenRegions = 0;
+	std::size_t ChunksSaved = 0;
+	std::size_t ChunksLoaded = 0;
+	// Payloads rejected by checksum or format checks.
+	std::size_t CorruptChunks = 0;
+	std::size_t FileBytes = 0;
+};
+
+// Directory of region files, opened on demand.
+//
+// Every public call holds the store's mutex, so the autosave thread and the
+// journal's compaction thread can share one store.  Each SaveChunk is atomic
+// on its own; writers that must not interleave their chunks (two saves of
+// different snapshots of the same chunk) still have to be ordered by the
+// caller.
+class RegionStore
+{
+public:
+	explicit RegionStore(const std::string& directory);
+
+	// Saves a chunk, or erases it from its region if it is empty.
+	bool SaveChunk(const Chunk& chunk);
+	bool SaveChunk(const ChunkSnapshot& snapshot);
+	bool SaveChunk(const ChunkCoord& coord, const BlockId* blocks);
+	// Saves every loaded chunk.  Returns the number of chunks written.
+	std::size_t SaveWorld(const World& world);
+
+	// Replaces the chunk's blocks in the world if it is stored.
+	bool LoadChunk(World& world, const ChunkCoord& coord);
+	// Loads every stored chunk between minChunk and maxChunk inclusive.
+	// Returns the number of chunks loaded.
+	std::size_t LoadArea(World& world, const ChunkCoord& minChunk, const ChunkCoord& maxChunk);
+
+	// Flushes every open region.  Returns false if any of them failed.
+	bool Flush();
+	// Closes every region, dropping them from the page cache if evict is set.
+	void Close(bool evict = false);
+
+	RegionStoreStats GetStats()const;
+
+	const std::string& GetDirectory()const { return mDirectory; }
+	void EnsureDirectory()const;
+
+	// Path of the file holding a region, whether or not it exists.
+	std::string GetRegionPath(const RegionCoord& coord)const;
+
+private:
+	RegionFile* GetRegion(const RegionCoord& coord, bool create);
+
+private:
+	std::string mDirectory;
+	mutable std::mutex mMutex;
+	std::unordered_map<std::uint64_t, std::unique_ptr<RegionFile>> mRegions;
+	std::size_t mChunksSaved = 0;
+	std::size_t mChunksLoaded = 0;
+	std::size_t mCorruptChunks = 0;
+};
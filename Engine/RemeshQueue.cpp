@@ -0,0 +1,91 @@
+#include "RemeshQueue.h"
+
+void RemeshQueue::MarkBlockChanged(int x, int y, int z)
+{
+	mStats.BlocksChanged++;
+
+	// Along each axis the block's own chunk always sees it, and the chunk on
+	// the other side does too when the block is in the first or last layer.
+	ChunkCoord c = World::ToChunkCoord(x, y, z);
+	int local[3] = { x & ChunkMask, y & ChunkMask, z & ChunkMask };
+	int from[3], to[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		from[axis] = local[axis] == 0 ? -1 : 0;
+		to[axis] = local[axis] == ChunkMask ? 1 : 0;
+	}
+
+	for (int dy = from[1]; dy <= to[1]; dy++)
+	{
+		for (int dz = from[2]; dz <= to[2]; dz++)
+		{
+			for (int dx = from[0]; dx <= to[0]; dx++)
+				MarkChunkDirty(ChunkCoord{ c.X + dx, c.Y + dy, c.Z + dz });
+		}
+	}
+}
+
+void RemeshQueue::MarkChunkDirty(const ChunkCoord& coord)
+{
+	mStats.ChunksMarked++;
+
+	std::uint64_t key = PackChunkCoord(coord);
+	if (mDirty.insert(key).second)
+		mOrder.push_back(key);
+}
+
+void RemeshQueue::SetChunkLod(const ChunkCoord& coord, int lod)
+{
+	if (GetChunkLod(coord) == lod)
+		return;
+
+	std::uint64_t key = PackChunkCoord(coord);
+	if (lod == 0)
+		mLods.erase(key);
+	else
+		mLods[key] = lod;
+
+	mStats.LodChanges++;
+	MarkChunkDirty(coord);
+}
+
+int RemeshQueue::GetChunkLod(const ChunkCoord& coord)const
+{
+	auto it = mLods.find(PackChunkCoord(coord));
+	return it != mLods.end() ? it->second : 0;
+}
+
+std::size_t RemeshQueue::Submit(const World& world, MeshWorkerPool& pool)
+{
+	std::size_t submitted = 0;
+	std::size_t kept = 0;
+	for (std::uint64_t key : mOrder)
+	{
+		ChunkCoord coord = UnpackChunkCoord(key);
+		if (mInFlight.count(key) != 0)
+		{
+			mOrder[kept++] = key;
+			mStats.Deferred++;
+			continue;
+		}
+
+		mDirty.erase(key);
+
+		// Marks spill over into neighbours that were never loaded.
+		if (world.GetChunk(coord) == nullptr)
+			continue;
+
+		pool.Submit(world, coord, GetChunkLod(coord));
+		mInFlight.insert(key);
+		submitted++;
+	}
+
+	mOrder.resize(kept);
+	mStats.Submitted += submitted;
+	return submitted;
+}
+
+void RemeshQueue::Completed(const ChunkCoord& coord)
+{
+	mInFlight.erase(PackChunkCoord(coord));
+}
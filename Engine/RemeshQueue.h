@@ -0,0 +1,61 @@
+#pragma once
+
+#include "MeshWorkerPool.h"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct RemeshStats
+{
+	std::uint64_t BlocksChanged = 0;
+	// Chunk marks, counting a chunk again for every edit that marks it.
+	std::uint64_t ChunksMarked = 0;
+	// Chunks marked because their level of detail changed.
+	std::uint64_t LodChanges = 0;
+	std::uint64_t Submitted = 0;
+	// Dirty chunks held back because their previous mesh was still being built.
+	std::uint64_t Deferred = 0;
+};
+
+// Collects the chunks whose meshes are out of date and sends each one to the
+// mesh workers once, however many edits touched it.
+//
+// A chunk's mesh reads the one-block border around it (see ChunkMesher), so a
+// block on a chunk boundary also dirties the neighbours that can see it: up to
+// seven chunks for a block in a corner.
+//
+// A chunk is never meshed twice at once.  If it changes again while its mesh
+// is being built it stays dirty until that mesh is back, so meshes can't come
+// back out of order.
+class RemeshQueue
+{
+public:
+	// Call after the world block at (x, y, z) has changed.
+	void MarkBlockChanged(int x, int y, int z);
+	void MarkChunkDirty(const ChunkCoord& coord);
+
+	// Chunks are meshed at level 0 until given another level; changing it
+	// marks the chunk dirty.
+	void SetChunkLod(const ChunkCoord& coord, int lod);
+	int GetChunkLod(const ChunkCoord& coord)const;
+
+	// Submits every dirty chunk that exists and isn't already being meshed.
+	// Returns the number of chunks submitted.
+	std::size_t Submit(const World& world, MeshWorkerPool& pool);
+	// Call for each mesh popped from the pool.
+	void Completed(const ChunkCoord& coord);
+
+	std::size_t GetDirtyCount()const { return mDirty.size(); }
+	std::size_t GetInFlightCount()const { return mInFlight.size(); }
+	const RemeshStats& GetStats()const { return mStats; }
+
+private:
+	// Packed coordinates; mOrder keeps the dirty chunks in marking order.
+	std::unordered_set<std::uint64_t> mDirty;
+	std::vector<std::uint64_t> mOrder;
+	std::unordered_set<std::uint64_t> mInFlight;
+	// Levels of detail other than 0.
+	std::unordered_map<std::uint64_t, int> mLods;
+	RemeshStats mStats;
+};
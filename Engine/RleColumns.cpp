@@ -0,0 +1,217 @@
+#include "RleColumns.h"
+#include "Chunk.h"
+
+// Small runs store length - 1 in the low nibble, so a column can't be taller
+// than 16 blocks.
+static_assert(ChunkSize <= 16, "RleColumns run lengths must fit in 4 bits");
+// Row offsets are 16 bits; the largest encoding (255 entries, two-byte runs of
+// length one) must fit.
+static_assert(1 + 255 + 2 * ChunkVolume <= 0xFFFF, "RleColumns row offsets must fit in 16 bits");
+
+void RleColumns::Encode(const BlockId* blocks)
+{
+	int lookup[256];
+	for (int i = 0; i < 256; i++)
+		lookup[i] = -1;
+
+	std::vector<BlockId> palette;
+	for (int i = 0; i < ChunkVolume; i++)
+	{
+		if (lookup[(int)blocks[i]] < 0)
+		{
+			lookup[(int)blocks[i]] = (int)palette.size();
+			palette.push_back(blocks[i]);
+		}
+	}
+
+	const bool smallRuns = palette.size() <= 16;
+
+	mData.clear();
+	mData.push_back((std::uint8_t)palette.size());
+	for (BlockId id : palette)
+		mData.push_back((std::uint8_t)id);
+
+	for (int z = 0; z < ChunkSize; z++)
+	{
+		for (int x = 0; x < ChunkSize; x++)
+		{
+			int y = 0;
+			while (y < ChunkSize)
+			{
+				BlockId id = blocks[Chunk::Index(x, y, z)];
+				int length = 1;
+				while (y + length < ChunkSize && blocks[Chunk::Index(x, y + length, z)] == id)
+					length++;
+
+				int entry = lookup[(int)id];
+				if (smallRuns)
+				{
+					mData.push_back((std::uint8_t)((entry << 4) | (length - 1)));
+				}
+				else
+				{
+					mData.push_back((std::uint8_t)entry);
+					mData.push_back((std::uint8_t)(length - 1));
+				}
+
+				y += length;
+			}
+		}
+	}
+
+	mData.shrink_to_fit();
+	IndexRows();
+}
+
+void RleColumns::Decode(BlockId* dest)const
+{
+	Decode(mData.data(), dest);
+}
+
+void RleColumns::Decode(const std::uint8_t* data, BlockId* dest)
+{
+	const std::uint8_t* p = data;
+	int paletteSize = *p++;
+	const BlockId* palette = reinterpret_cast<const BlockId*>(p);
+	p += paletteSize;
+
+	const bool smallRuns = paletteSize <= 16;
+
+	for (int z = 0; z < ChunkSize; z++)
+	{
+		for (int x = 0; x < ChunkSize; x++)
+		{
+			int y = 0;
+			while (y < ChunkSize)
+			{
+				int entry, length;
+				if (smallRuns)
+				{
+					entry = *p >> 4;
+					length = (*p & 0xF) + 1;
+					p++;
+				}
+				else
+				{
+					entry = p[0];
+					length = p[1] + 1;
+					p += 2;
+				}
+
+				BlockId id = palette[entry];
+				for (int end = y + length; y < end; y++)
+					dest[Chunk::Index(x, y, z)] = id;
+			}
+		}
+	}
+}
+
+bool RleColumns::SetData(const std::uint8_t* data, std::size_t size)
+{
+	if (!Validate(data, size))
+		return false;
+
+	mData.assign(data, data + size);
+	IndexRows();
+	return true;
+}
+
+BlockId RleColumns::GetBlock(int x, int y, int z)const
+{
+	const std::uint8_t* palette = mData.data() + 1;
+	const bool smallRuns = mData[0] <= 16;
+	const std::uint8_t* p = mData.data() + mRowOffsets[z];
+
+	int column = 0;
+	int top = 0;
+	for (;;)
+	{
+		int entry, length;
+		if (smallRuns)
+		{
+			entry = *p >> 4;
+			length = (*p & 0xF) + 1;
+			p++;
+		}
+		else
+		{
+			entry = p[0];
+			length = p[1] + 1;
+			p += 2;
+		}
+
+		top += length;
+		if (column == x && top > y)
+			return (BlockId)palette[entry];
+		if (top == ChunkSize)
+		{
+			column++;
+			top = 0;
+		}
+	}
+}
+
+void RleColumns::IndexRows()
+{
+	const bool smallRuns = mData[0] <= 16;
+	const std::size_t runBytes = smallRuns ? 1 : 2;
+
+	std::size_t offset = 1 + mData[0];
+	for (int z = 0; z < ChunkSize; z++)
+	{
+		mRowOffsets[z] = (std::uint16_t)offset;
+		for (int x = 0; x < ChunkSize; x++)
+		{
+			int y = 0;
+			while (y < ChunkSize)
+			{
+				y += (smallRuns ? (mData[offset] & 0xF) : mData[offset + 1]) + 1;
+				offset += runBytes;
+			}
+		}
+	}
+}
+
+bool RleColumns::Validate(const std::uint8_t* data, std::size_t size)
+{
+	// Walk the runs once so Decode never reads out of bounds.
+	if (size < 1)
+		return false;
+
+	std::size_t paletteSize = data[0];
+	if (paletteSize == 0 || size < 1 + paletteSize)
+		return false;
+
+	for (std::size_t i = 1; i <= paletteSize; i++)
+	{
+		if (data[i] >= gNumBlockTypes)
+			return false;
+	}
+
+	const bool smallRuns = paletteSize <= 16;
+	const std::size_t runBytes = smallRuns ? 1 : 2;
+
+	std::size_t offset = 1 + paletteSize;
+	for (int column = 0; column < ChunkSize * ChunkSize; column++)
+	{
+		int y = 0;
+		while (y < ChunkSize)
+		{
+			if (offset + runBytes > size)
+				return false;
+
+			std::size_t entry = smallRuns ? (data[offset] >> 4) : data[offset];
+			int length = (smallRuns ? (data[offset] & 0xF) : data[offset + 1]) + 1;
+			if (entry >= paletteSize)
+				return false;
+
+			y += length;
+			offset += runBytes;
+		}
+
+		if (y != ChunkSize)
+			return false;
+	}
+
+	return offset == size;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Block.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Run-length encoding of a chunk's blocks along Y, one column at a time.  The
+// generator fills columns bottom-up in long runs (bedrock, ore band, dirt,
+// surface, air), so this is the densest format we have for chunks that are
+// not being read or edited.
+//
+// Encoded layout:
+//   byte 0           palette size P
+//   bytes 1..P       palette BlockIds
+//   runs             for each column (z outer, x inner), runs bottom to top
+//                    whose lengths sum to ChunkSize.  If P <= 16 a run is one
+//                    byte (palette index << 4 | length - 1), otherwise two bytes
+//                    (palette index, length - 1).
+class RleColumns
+{
+public:
+	// blocks holds ChunkVolume ids in Chunk::Index order.
+	void Encode(const BlockId* blocks);
+	void Decode(BlockId* dest)const;
+	// Reads one block without decoding the rest; walks at most one row of
+	// columns.  Local coordinates as for Chunk::GetBlock.
+	BlockId GetBlock(int x, int y, int z)const;
+
+	// Raw encoded bytes, for writing to disk.
+	const std::vector<std::uint8_t>& GetData()const { return mData; }
+	// Adopts previously encoded bytes.  Returns false if they are malformed.
+	bool SetData(const std::uint8_t* data, std::size_t size);
+
+	// Work on encoded bytes in place (e.g. a memory-mapped region file) without
+	// copying them into an RleColumns first.  Decode expects validated data.
+	static bool Validate(const std::uint8_t* data, std::size_t size);
+	static void Decode(const std::uint8_t* data, BlockId* dest);
+
+	std::size_t GetMemoryUsage()const { return sizeof(RleColumns) + mData.capacity(); }
+
+private:
+	// Finds where each row of columns starts in mData.
+	void IndexRows();
+
+private:
+	std::vector<std::uint8_t> mData;
+	// Offset of the first run of column (0, z) for each z.  Not part of the
+	// encoded bytes.
+	std::uint16_t mRowOffsets[16] = {};
+};
@@ -91,6 +91,8 @@ struct VertexOut
     float3 PosW    : POSITION;
     float3 NormalW : NORMAL;
 	float2 TexC    : TEXCOORD;
+	// Baked ambient occlusion; 1 for unshaded geometry.
+	float  Ao      : OCCLUSION;
 };
 
 VertexOut VS(VertexIn vin)
@@ -110,10 +112,125 @@ VertexOut VS(VertexIn vin)
 	// Output vertex attributes for interpolation across triangle.
 	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
 	vout.TexC = mul(texC, gMatTransform).xy;
+	vout.Ao = 1.0f;
 
     return vout;
 }
 
+// Packed chunk vertex; the layout is documented on ChunkVertex in ChunkVertex.h.
+struct ChunkVertexIn
+{
+	uint2 Packed : PACKED;
+};
+
+static const float3 gFaceNormals[6] =
+{
+	float3(1.0f, 0.0f, 0.0f), float3(-1.0f, 0.0f, 0.0f),
+	float3(0.0f, 1.0f, 0.0f), float3(0.0f, -1.0f, 0.0f),
+	float3(0.0f, 0.0f, 1.0f), float3(0.0f, 0.0f, -1.0f)
+};
+
+// Light left at a vertex for each ChunkVertex occlusion level, darkest first.
+static const float gAoLevels[4] = { 0.45f, 0.6f, 0.8f, 1.0f };
+
+VertexOut UnpackChunkVertex(ChunkVertexIn vin, float4x4 world, float4x4 texTransform)
+{
+	VertexOut vout = (VertexOut)0.0f;
+
+	uint packed = vin.Packed.x;
+	float3 posL = float3(packed & 63, (packed >> 6) & 63, (packed >> 12) & 63);
+	// Coarse meshes count in units of 2^lod blocks.
+	posL *= (float)(1u << ((packed >> 23) & 3));
+	uint face = (packed >> 18) & 7;
+	float3 normalL = gFaceNormals[face];
+
+	float4 posW = mul(float4(posL, 1.0f), world);
+	vout.PosW = posW.xyz;
+	vout.NormalW = mul(normalL, (float3x3)world);
+	vout.PosH = mul(posW, gViewProj);
+
+	// Tile the texture once per block across merged faces, upright on the
+	// sides and not mirrored when seen from outside.
+	float side = (face & 1) ? -1.0f : 1.0f;
+	float2 texC;
+	if (face < 2)
+		texC = float2(side * posL.z, -posL.y);
+	else if (face < 4)
+		texC = float2(posL.x, -side * posL.z);
+	else
+		texC = float2(-side * posL.x, -posL.y);
+
+	float4 texT = mul(float4(texC, 0.0f, 1.0f), texTransform);
+	vout.TexC = mul(texT, gMatTransform).xy;
+
+	vout.Ao = gAoLevels[(vin.Packed.y >> 8) & 3];
+
+	return vout;
+}
+
+VertexOut ChunkVS(ChunkVertexIn vin)
+{
+	return UnpackChunkVertex(vin, gWorld, gTexTransform);
+}
+
+// ObjectConstants as laid out in the object constant buffer, one 256-byte
+// slot each, so the indirect draws can read the buffer as structured data.
+struct ChunkObject
+{
+	float4x4 World;
+	float4x4 TexTransform;
+	float4   Pad[8];
+};
+
+StructuredBuffer<ChunkObject> gChunkObjects : register(t2);
+
+// Set by each indirect command: the chunk's object constant slot.
+cbuffer cbChunkIndex : register(b3)
+{
+	uint gChunkIndex;
+};
+
+VertexOut ChunkIndirectVS(ChunkVertexIn vin)
+{
+	ChunkObject chunk = gChunkObjects[gChunkIndex];
+	return UnpackChunkVertex(vin, chunk.World, chunk.TexTransform);
+}
+
+// Block of the instanced path; the layout is documented on BlockInstance in
+// BlockInstances.h.  Each draw covers one block type and binds its material,
+// so only the position is read here.
+struct BlockInstance
+{
+	int3 Position;
+	uint Block;
+};
+
+// Bound from the first instance of the draw, as SV_InstanceID starts from 0.
+StructuredBuffer<BlockInstance> gBlockInstances : register(t1);
+
+// GeometryGenerator::VoxelVertex: a corner of the unit cube, its face and uv.
+struct VoxelVertexIn
+{
+	uint4 CornerFace : CORNER;
+	uint2 TexC       : TEXCOORD;
+};
+
+VertexOut BlockVS(VoxelVertexIn vin, uint instanceID : SV_InstanceID)
+{
+	VertexOut vout = (VertexOut)0.0f;
+
+	BlockInstance instance = gBlockInstances[instanceID];
+	float3 posW = (float3)instance.Position + (float3)vin.CornerFace.xyz;
+	vout.PosW = posW;
+	vout.NormalW = gFaceNormals[vin.CornerFace.w];
+	vout.PosH = mul(float4(posW, 1.0f), gViewProj);
+
+	vout.TexC = mul(float4((float2)vin.TexC, 0.0f, 1.0f), gMatTransform).xy;
+	vout.Ao = 1.0f;
+
+	return vout;
+}
+
 float4 PS(VertexOut pin) : SV_Target
 {
     float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
@@ -143,6 +260,7 @@ float4 PS(VertexOut pin) : SV_Target
         pin.NormalW, toEyeW, shadowFactor);
 
     float4 litColor = ambient + directLight;
+	litColor.rgb *= pin.Ao;
 	
 #ifdef FOG
 	float fogAmount = saturate((distToEye - gFogStart) / gFogRange);
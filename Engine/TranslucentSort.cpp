@@ -0,0 +1,128 @@
+#include "TranslucentSort.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Sort keys put the largest distance first and break ties on the second value.
+	std::uint64_t FarthestFirst(std::int64_t distanceSq)
+	{
+		return std::numeric_limits<std::uint64_t>::max() - (std::uint64_t)distanceSq;
+	}
+}
+
+void TranslucentSorter::SetChunk(const ChunkMesh& mesh)
+{
+	std::vector<ChunkMeshPart> parts;
+	for (const ChunkMeshPart& part : mesh.Parts)
+	{
+		if (part.Layer == ChunkLayer::Translucent)
+			parts.push_back(part);
+	}
+
+	std::uint64_t key = PackChunkCoord(mesh.Coord);
+	if (parts.empty())
+	{
+		RemoveChunk(mesh.Coord);
+		return;
+	}
+
+	mChunks[key] = std::move(parts);
+	mChanged = true;
+}
+
+void TranslucentSorter::RemoveChunk(const ChunkCoord& coord)
+{
+	if (mChunks.erase(PackChunkCoord(coord)) != 0)
+		mChanged = true;
+}
+
+bool TranslucentSorter::Update(float x, float y, float z)
+{
+	int cell[3] = { (int)std::floor(x), (int)std::floor(y), (int)std::floor(z) };
+	if (!mChanged && mHasCell && std::equal(cell, cell + 3, mCell))
+		return false;
+
+	std::copy(cell, cell + 3, mCell);
+	mHasCell = true;
+	mChanged = false;
+	Sort();
+	return true;
+}
+
+void TranslucentSorter::SortQuads(const ChunkMeshPart& part, const ChunkCoord& coord, const std::int64_t* eye2,
+	std::vector<std::pair<std::uint64_t, std::uint32_t>>& scratch, std::vector<std::uint32_t>& out)
+{
+	// Opposite corners sum to twice the centre, which keeps everything in integers.
+	const std::int64_t origin2[3] = { (std::int64_t)coord.X * ChunkSize * 2, (std::int64_t)coord.Y * ChunkSize * 2, (std::int64_t)coord.Z * ChunkSize * 2 };
+	const std::uint32_t quadCount = (std::uint32_t)part.GetQuadCount();
+	scratch.clear();
+	for (std::uint32_t q = 0; q < quadCount; q++)
+	{
+		const ChunkVertex& a = part.Vertices[q * 4];
+		const ChunkVertex& c = part.Vertices[q * 4 + 2];
+		const int scale = 1 << a.GetLod();
+		std::int64_t d[3] =
+		{
+			origin2[0] + (a.GetX() + c.GetX()) * scale - eye2[0],
+			origin2[1] + (a.GetY() + c.GetY()) * scale - eye2[1],
+			origin2[2] + (a.GetZ() + c.GetZ()) * scale - eye2[2]
+		};
+		scratch.emplace_back(FarthestFirst(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]), q);
+	}
+
+	std::sort(scratch.begin(), scratch.end());
+
+	for (const auto& entry : scratch)
+	{
+		for (std::uint32_t i : QuadIndexPattern)
+			out.push_back(entry.second * 4 + i);
+	}
+}
+
+void TranslucentSorter::Sort()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const std::int64_t eye2[3] = { mCell[0] * 2 + 1, mCell[1] * 2 + 1, mCell[2] * 2 + 1 };
+
+	mChunkOrder.clear();
+	for (const auto& e : mChunks)
+	{
+		ChunkCoord c = UnpackChunkCoord(e.first);
+		std::int64_t d[3] =
+		{
+			((std::int64_t)c.X * 2 + 1) * ChunkSize - eye2[0],
+			((std::int64_t)c.Y * 2 + 1) * ChunkSize - eye2[1],
+			((std::int64_t)c.Z * 2 + 1) * ChunkSize - eye2[2]
+		};
+		mChunkOrder.emplace_back(FarthestFirst(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]), e.first);
+	}
+	std::sort(mChunkOrder.begin(), mChunkOrder.end());
+
+	mIndices.clear();
+	mRanges.clear();
+	std::uint64_t quads = 0;
+	for (const auto& entry : mChunkOrder)
+	{
+		ChunkCoord coord = UnpackChunkCoord(entry.second);
+		for (const ChunkMeshPart& part : mChunks[entry.second])
+		{
+			TranslucentRange range;
+			range.Coord = coord;
+			range.Block = part.Block;
+			range.StartIndex = (std::uint32_t)mIndices.size();
+			SortQuads(part, coord, eye2, mScratch, mIndices);
+			range.IndexCount = (std::uint32_t)mIndices.size() - range.StartIndex;
+			mRanges.push_back(range);
+			quads += part.GetQuadCount();
+		}
+	}
+
+	mStats.Sorts++;
+	mStats.QuadsSorted += quads;
+	mStats.LastSortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	mStats.TotalSortMs += mStats.LastSortMs;
+}
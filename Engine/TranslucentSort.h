@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ChunkMesher.h"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Where one translucent part of a chunk sits in TranslucentSorter::GetIndices.
+// The indices are the part's own, so draw them with the part's base vertex.
+struct TranslucentRange
+{
+	ChunkCoord Coord;
+	BlockId Block = BlockId::Air;
+	std::uint32_t StartIndex = 0;
+	std::uint32_t IndexCount = 0;
+};
+
+struct TranslucentSortStats
+{
+	std::uint64_t Sorts = 0;
+	std::uint64_t QuadsSorted = 0;
+	double LastSortMs = 0.0;
+	double TotalSortMs = 0.0;
+};
+
+// Keeps the translucent parts of the chunk meshes and an index list that draws
+// their quads back to front: chunks farthest first, and the quads of each part
+// farthest first.
+//
+// Distances are taken from the centre of the block the camera is in, not the
+// camera itself, so the order only changes when the camera moves into another
+// block.  Quads at the same distance keep their mesh order, and chunks at the
+// same distance are ordered by coordinate, so the same camera block always
+// gives the same indices.
+class TranslucentSorter
+{
+public:
+	// Takes the chunk's translucent parts, replacing any it had.
+	void SetChunk(const ChunkMesh& mesh);
+	void RemoveChunk(const ChunkCoord& coord);
+
+	// Sorts again if the camera is in another block than last time or chunks
+	// have changed.  Returns true if the indices were rebuilt.
+	bool Update(float x, float y, float z);
+
+	const std::vector<std::uint32_t>& GetIndices()const { return mIndices; }
+	const std::vector<TranslucentRange>& GetRanges()const { return mRanges; }
+	std::size_t GetChunkCount()const { return mChunks.size(); }
+	const TranslucentSortStats& GetStats()const { return mStats; }
+
+	// Appends the part's indices to out with its quads ordered back to front
+	// from the given point, in doubled world block units.  scratch is reused
+	// between calls.
+	static void SortQuads(const ChunkMeshPart& part, const ChunkCoord& coord, const std::int64_t* eye2,
+		std::vector<std::pair<std::uint64_t, std::uint32_t>>& scratch, std::vector<std::uint32_t>& out);
+
+private:
+	void Sort();
+
+private:
+	std::unordered_map<std::uint64_t, std::vector<ChunkMeshPart>> mChunks;
+	bool mChanged = false;
+	bool mHasCell = false;
+	int mCell[3] = {};
+
+	std::vector<std::uint32_t> mIndices;
+	std::vector<TranslucentRange> mRanges;
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> mScratch;
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> mChunkOrder;
+	TranslucentSortStats mStats;
+};
@@ -0,0 +1,418 @@
+#include "VoxelOctree.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	int CountBits(std::uint32_t v)
+	{
+		int count = 0;
+		for (; v != 0; v &= v - 1)
+			count++;
+		return count;
+	}
+
+	ChunkCoord ToRegionCoord(const ChunkCoord& c)
+	{
+		return ChunkCoord{ c.X >> OctreeRegionShift, c.Y >> OctreeRegionShift, c.Z >> OctreeRegionShift };
+	}
+
+	// The solid type with the most weight, or air if less than half of volume
+	// is solid.  Mostly-empty cells stay air so distant terrain doesn't grow.
+	BlockId PickRepresentative(const int* weights, int solidCount, int volume)
+	{
+		BlockId representative = BlockId::Air;
+		if (solidCount * 2 < volume)
+			return representative;
+
+		int bestWeight = 0;
+		for (int t = 1; t < gNumBlockTypes; t++)
+		{
+			if (weights[t] > bestWeight)
+			{
+				bestWeight = weights[t];
+				representative = (BlockId)t;
+			}
+		}
+		return representative;
+	}
+}
+
+std::uint32_t OctreeGroup::GetChildGroup(int child)const
+{
+	return GetFirstGroup() + CountBits(GetInteriorMask() & ((1u << child) - 1));
+}
+
+void ChunkOctree::Build(const Chunk& chunk, int minLod)
+{
+	BlockId blocks[ChunkVolume];
+	chunk.CopyBlocks(blocks);
+
+	mGroups.clear();
+	mMinLod = (std::uint8_t)std::max(0, std::min(minLod, OctreeChunkLod));
+
+	BuildResult root = BuildNode(blocks, 0, 0, 0, ChunkSize, 1 << mMinLod);
+	mRootType = root.Type;
+	mRootInterior = root.Interior;
+	mSolidCount = (std::uint16_t)root.SolidCount;
+	mRootGroup = (std::uint32_t)mGroups.size();
+	if (root.Interior)
+		mGroups.push_back(root.Group);
+	mGroups.shrink_to_fit();
+}
+
+ChunkOctree::BuildResult ChunkOctree::BuildNode(const BlockId* blocks, int x, int y, int z, int size, int minSize)
+{
+	BuildResult result;
+	result.Interior = false;
+
+	if (size == 1)
+	{
+		result.Type = blocks[Chunk::Index(x, y, z)];
+		result.SolidCount = result.Type != BlockId::Air ? 1 : 0;
+		return result;
+	}
+
+	// Children are built first so that their own groups are appended before
+	// this node's; a collapsed node then never leaves orphans behind.
+	int half = size / 2;
+	BuildResult children[8];
+	for (int i = 0; i < 8; i++)
+		children[i] = BuildNode(blocks, x + (i & 1) * half, y + ((i >> 1) & 1) * half, z + ((i >> 2) & 1) * half, half, minSize);
+
+	result.SolidCount = 0;
+	bool uniform = true;
+	for (int i = 0; i < 8; i++)
+	{
+		result.SolidCount += children[i].SolidCount;
+		uniform = uniform && !children[i].Interior && children[i].Type == children[0].Type;
+	}
+
+	if (uniform)
+	{
+		result.Type = children[0].Type;
+		return result;
+	}
+
+	int weights[gNumBlockTypes] = {};
+	for (int i = 0; i < 8; i++)
+		weights[(int)children[i].Type] += children[i].SolidCount;
+	result.Type = PickRepresentative(weights, result.SolidCount, size * size * size);
+
+	// Cells at the minimum size become leaves of their representative type,
+	// the same type a full tree samples at that lod.  Their children are
+	// leaves too, so nothing was appended for them.
+	if (size <= minSize)
+		return result;
+
+	// Interior children's groups go next to each other, in child order.
+	std::uint32_t mask = 0;
+	std::uint32_t firstGroup = (std::uint32_t)mGroups.size();
+	for (int i = 0; i < 8; i++)
+	{
+		result.Group.Types[i] = children[i].Type;
+		if (children[i].Interior)
+		{
+			mask |= 1u << i;
+			mGroups.push_back(children[i].Group);
+		}
+	}
+
+	result.Group.Packed = (firstGroup << 8) | mask;
+	result.Interior = true;
+	return result;
+}
+
+BlockId ChunkOctree::GetBlock(int x, int y, int z, int lod)const
+{
+	int size, minX, minY, minZ;
+	return FindLeaf(x, y, z, lod, size, minX, minY, minZ);
+}
+
+BlockId ChunkOctree::FindLeaf(int x, int y, int z, int lod, int& size, int& minX, int& minY, int& minZ)const
+{
+	size = ChunkSize;
+	minX = minY = minZ = 0;
+
+	const int stopSize = 1 << std::max(lod, 0);
+	BlockId type = mRootType;
+	bool interior = mRootInterior;
+	std::uint32_t group = mRootGroup;
+	while (interior && size > stopSize)
+	{
+		size /= 2;
+		int child = 0;
+		if (x >= minX + size) { child |= 1; minX += size; }
+		if (y >= minY + size) { child |= 2; minY += size; }
+		if (z >= minZ + size) { child |= 4; minZ += size; }
+
+		const OctreeGroup& g = mGroups[group];
+		type = g.Types[child];
+		interior = g.IsInterior(child);
+		if (interior)
+			group = g.GetChildGroup(child);
+	}
+
+	return type;
+}
+
+void ChunkOctree::ExtractBlocks(BlockId* dest)const
+{
+	ExtractNode(mRootType, mRootInterior, mRootGroup, 0, 0, 0, ChunkSize, dest);
+}
+
+void ChunkOctree::ExtractNode(BlockId type, bool interior, std::uint32_t group, int x, int y, int z, int size, BlockId* dest)const
+{
+	if (!interior)
+	{
+		for (int j = y; j < y + size; j++)
+			for (int k = z; k < z + size; k++)
+				for (int i = x; i < x + size; i++)
+					dest[Chunk::Index(i, j, k)] = type;
+		return;
+	}
+
+	const OctreeGroup& g = mGroups[group];
+	int half = size / 2;
+	for (int i = 0; i < 8; i++)
+	{
+		ExtractNode(g.Types[i], g.IsInterior(i), g.IsInterior(i) ? g.GetChildGroup(i) : 0,
+			x + (i & 1) * half, y + ((i >> 1) & 1) * half, z + ((i >> 2) & 1) * half, half, dest);
+	}
+}
+
+void WorldOctree::SetFarField(float x, float z, float distance, int farLod)
+{
+	mFarX = x;
+	mFarZ = z;
+	mFarDistance = distance;
+	mFarLod = farLod;
+}
+
+void WorldOctree::Build(const World& world)
+{
+	mTrees.clear();
+	mRegions.clear();
+	world.ForEachChunk([this](const Chunk& chunk)
+	{
+		if (chunk.IsEmpty())
+			return;
+
+		ChunkOctree& tree = mTrees[PackChunkCoord(chunk.GetCoord())];
+		tree.Build(chunk, GetMinLod(chunk.GetCoord()));
+		SetRegionChunk(chunk.GetCoord(), &tree);
+	});
+}
+
+void WorldOctree::UpdateChunk(const World& world, const ChunkCoord& coord)
+{
+	const Chunk* chunk = world.GetChunk(coord);
+	if (chunk == nullptr || chunk->IsEmpty())
+	{
+		mTrees.erase(PackChunkCoord(coord));
+		SetRegionChunk(coord, nullptr);
+		return;
+	}
+
+	ChunkOctree& tree = mTrees[PackChunkCoord(coord)];
+	tree.Build(*chunk, GetMinLod(coord));
+	SetRegionChunk(coord, &tree);
+}
+
+int WorldOctree::GetMinLod(const ChunkCoord& coord)const
+{
+	if (mFarDistance < 0.0f)
+		return 0;
+
+	float dx = coord.X * ChunkSize + ChunkSize * 0.5f - mFarX;
+	float dz = coord.Z * ChunkSize + ChunkSize * 0.5f - mFarZ;
+	return dx * dx + dz * dz > mFarDistance * mFarDistance ? mFarLod : 0;
+}
+
+void WorldOctree::SetRegionChunk(const ChunkCoord& coord, const ChunkOctree* tree)
+{
+	const std::uint64_t key = PackChunkCoord(ToRegionCoord(coord));
+	auto it = mRegions.find(key);
+	if (it == mRegions.end())
+	{
+		if (tree == nullptr)
+			return;
+		it = mRegions.emplace(key, Region()).first;
+	}
+
+	const int mask = OctreeRegionChunks - 1;
+	const int slot = (coord.X & mask) + (coord.Y & mask) * OctreeRegionChunks + (coord.Z & mask) * OctreeRegionChunks * OctreeRegionChunks;
+	Region& region = it->second;
+	region.ChunkTypes[slot] = tree != nullptr ? tree->GetRootType() : BlockId::Air;
+	region.SolidCounts[slot] = (std::uint16_t)(tree != nullptr ? tree->GetSolidCount() : 0);
+
+	UpdateRegionTypes(region);
+	if (region.ChunkCount == 0)
+		mRegions.erase(it);
+}
+
+void WorldOctree::UpdateRegionTypes(Region& region)
+{
+	// Chunks only keep their root type, so each one's solid blocks count
+	// towards that type.
+	const int n = OctreeRegionChunks;
+	int weights[gNumBlockTypes] = {};
+	int solidCount = 0;
+	region.ChunkCount = 0;
+	for (int h = 0; h < 8; h++)
+	{
+		int halfWeights[gNumBlockTypes] = {};
+		int halfSolid = 0;
+		for (int c = 0; c < 8; c++)
+		{
+			int x = (h & 1) * 2 + (c & 1), y = ((h >> 1) & 1) * 2 + ((c >> 1) & 1), z = ((h >> 2) & 1) * 2 + ((c >> 2) & 1);
+			int slot = x + y * n + z * n * n;
+			halfWeights[(int)region.ChunkTypes[slot]] += region.SolidCounts[slot];
+			halfSolid += region.SolidCounts[slot];
+			region.ChunkCount += region.SolidCounts[slot] > 0 ? 1 : 0;
+		}
+
+		region.HalfTypes[h] = PickRepresentative(halfWeights, halfSolid, 8 * ChunkVolume);
+		for (int t = 0; t < gNumBlockTypes; t++)
+			weights[t] += halfWeights[t];
+		solidCount += halfSolid;
+	}
+
+	region.Type = PickRepresentative(weights, solidCount, n * n * n * ChunkVolume);
+}
+
+BlockId WorldOctree::FindCell(const int b[3], int lod, int& size, int min[3])const
+{
+	ChunkCoord coord = World::ToChunkCoord(b[0], b[1], b[2]);
+
+	// Above the chunk trees the cells come from the region.
+	if (lod > OctreeChunkLod)
+	{
+		lod = std::min(lod, OctreeMaxLod);
+		size = 1 << lod;
+		for (int a = 0; a < 3; a++)
+			min[a] = b[a] & ~(size - 1);
+
+		auto it = mRegions.find(PackChunkCoord(ToRegionCoord(coord)));
+		if (it == mRegions.end())
+			return BlockId::Air;
+		if (lod == OctreeMaxLod)
+			return it->second.Type;
+
+		int half = ((coord.X >> 1) & 1) | (((coord.Y >> 1) & 1) << 1) | (((coord.Z >> 1) & 1) << 2);
+		return it->second.HalfTypes[half];
+	}
+
+	size = ChunkSize;
+	min[0] = min[1] = min[2] = 0;
+	BlockId type = BlockId::Air;
+
+	auto it = mTrees.find(PackChunkCoord(coord));
+	if (it != mTrees.end())
+		type = it->second.FindLeaf(b[0] & ChunkMask, b[1] & ChunkMask, b[2] & ChunkMask, lod, size, min[0], min[1], min[2]);
+
+	min[0] += coord.X * ChunkSize;
+	min[1] += coord.Y * ChunkSize;
+	min[2] += coord.Z * ChunkSize;
+	return type;
+}
+
+BlockId WorldOctree::GetBlock(int x, int y, int z, int lod)const
+{
+	const int b[3] = { x, y, z };
+	int size;
+	int min[3];
+	return FindCell(b, lod, size, min);
+}
+
+VoxelRayHit WorldOctree::Raycast(const float origin[3], const float dir[3], float maxDistance, int lod)const
+{
+	VoxelRayHit result;
+
+	float length = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+	if (length == 0.0f)
+		return result;
+
+	const float d[3] = { dir[0] / length, dir[1] / length, dir[2] / length };
+
+	// Nudge sample points just past the face we stepped through so the
+	// floor() below lands in the next cell.
+	const float epsilon = 1e-4f;
+	const int maxSteps = 1 << 16;
+
+	float t = 0.0f;
+	int lastAxis = -1;
+	while (t <= maxDistance && result.Steps < maxSteps)
+	{
+		int b[3];
+		for (int a = 0; a < 3; a++)
+			b[a] = (int)std::floor(origin[a] + d[a] * (t + epsilon));
+
+		int size;
+		int min[3];
+		BlockId type = FindCell(b, lod, size, min);
+		result.Steps++;
+
+		if (type != BlockId::Air)
+		{
+			result.Hit = true;
+			result.X = b[0];
+			result.Y = b[1];
+			result.Z = b[2];
+			result.Type = type;
+			result.Distance = t;
+			if (lastAxis >= 0)
+			{
+				int normal[3] = { 0, 0, 0 };
+				normal[lastAxis] = d[lastAxis] > 0.0f ? -1 : 1;
+				result.NormalX = normal[0];
+				result.NormalY = normal[1];
+				result.NormalZ = normal[2];
+			}
+			return result;
+		}
+
+		// Skip the whole empty leaf (or missing chunk or region) in one step.
+		float tExit = maxDistance + 1.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			float tAxis;
+			if (d[a] > 0.0f)
+				tAxis = (min[a] + size - origin[a]) / d[a];
+			else if (d[a] < 0.0f)
+				tAxis = (min[a] - origin[a]) / d[a];
+			else
+				continue;
+
+			if (tAxis < tExit)
+			{
+				tExit = tAxis;
+				lastAxis = a;
+			}
+		}
+
+		t = tExit > t ? tExit : t + epsilon;
+	}
+
+	return result;
+}
+
+std::size_t WorldOctree::GetNodeCount()const
+{
+	// Each region adds its eight half cells and its root.
+	std::size_t count = mRegions.size() * 9;
+	for (auto& e : mTrees)
+		count += e.second.GetNodeCount();
+
+	return count;
+}
+
+std::size_t WorldOctree::GetMemoryUsage()const
+{
+	std::size_t bytes = sizeof(WorldOctree) + (mTrees.bucket_count() + mRegions.bucket_count()) * sizeof(void*);
+	for (auto& e : mTrees)
+		bytes += e.second.GetMemoryUsage() + sizeof(std::uint64_t) + 2 * sizeof(void*);
+	bytes += mRegions.size() * (sizeof(Region) + sizeof(std::uint64_t) + 2 * sizeof(void*));
+
+	return bytes;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "World.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Levels of detail: lod n samples cells of 2^n blocks.  A chunk tree covers
+// lods 0 to OctreeChunkLod (its root); the region level above the trees covers
+// OctreeRegionShift more, up to cells of a whole region.
+const int OctreeChunkLod = ChunkShift;
+const int OctreeRegionShift = 2;
+const int OctreeMaxLod = OctreeChunkLod + OctreeRegionShift;
+
+// Chunks per region along each axis.
+const int OctreeRegionChunks = 1 << OctreeRegionShift;
+
+// The eight children of an interior node, in x, then y, then z order.  Types
+// holds each child's type: a leaf's block type, or an interior child's
+// representative type.  Interior children have their bit set in the mask and
+// their own groups stored contiguously from the first group index, in child
+// order, so a group is 12 bytes for eight nodes.
+struct OctreeGroup
+{
+	// First child group in the high 24 bits, interior mask in the low 8.
+	std::uint32_t Packed = 0;
+	BlockId Types[8] = {};
+
+	std::uint32_t GetFirstGroup()const { return Packed >> 8; }
+	std::uint32_t GetInteriorMask()const { return Packed & 0xFF; }
+	bool IsInterior(int child)const { return ((Packed >> child) & 1) != 0; }
+	// Group index of an interior child.
+	std::uint32_t GetChildGroup(int child)const;
+};
+
+static_assert(sizeof(OctreeGroup) == 12, "OctreeGroup should stay 12 bytes");
+
+// Sparse voxel octree over a single chunk.  Subtrees of a single block type are
+// collapsed into one leaf, so a full-resolution tree is a lossless compressed
+// copy of the chunk.  Interior nodes carry a representative type (the most
+// common solid type, or air if less than half the volume is solid) used when
+// sampling at a coarser LOD.
+//
+// A tree built with a minimum lod stops splitting at cells of that size and
+// keeps their representative types instead, which drops the full-resolution
+// leaves of far terrain.
+class ChunkOctree
+{
+public:
+	void Build(const Chunk& chunk, int minLod = 0);
+
+	// lod 0 is full resolution; lod n samples cells of 2^n blocks.  Lods below
+	// the tree's minimum lod sample at the minimum.
+	BlockId GetBlock(int x, int y, int z, int lod = 0)const;
+
+	// Finds the leaf holding a block at full resolution or at the given lod.
+	// Returns the type and writes the leaf's edge length and minimum corner
+	// in chunk-local block units.
+	BlockId FindLeaf(int x, int y, int z, int lod, int& size, int& minX, int& minY, int& minZ)const;
+
+	// Expands the tree back into ChunkVolume blocks in Chunk::Index order.
+	void ExtractBlocks(BlockId* dest)const;
+
+	// Type of the whole chunk at OctreeChunkLod, and its solid block count.
+	BlockId GetRootType()const { return mRootType; }
+	int GetSolidCount()const { return mSolidCount; }
+	int GetMinLod()const { return mMinLod; }
+
+	std::size_t GetNodeCount()const { return 1 + mGroups.size() * 8; }
+	std::size_t GetMemoryUsage()const { return sizeof(ChunkOctree) + mGroups.capacity() * sizeof(OctreeGroup); }
+
+private:
+	struct BuildResult
+	{
+		BlockId Type;
+		int SolidCount;
+		bool Interior;
+		// The node's children, stored by its parent if the node is interior.
+		OctreeGroup Group;
+	};
+
+	BuildResult BuildNode(const BlockId* blocks, int x, int y, int z, int size, int minSize);
+	void ExtractNode(BlockId type, bool interior, std::uint32_t group, int x, int y, int z, int size, BlockId* dest)const;
+
+private:
+	std::vector<OctreeGroup> mGroups;
+	// The root's children, when it is interior.
+	std::uint32_t mRootGroup = 0;
+	std::uint16_t mSolidCount = 0;
+	BlockId mRootType = BlockId::Air;
+	bool mRootInterior = false;
+	std::uint8_t mMinLod = 0;
+};
+
+// Result of a ray cast through the octree.
+struct VoxelRayHit
+{
+	bool Hit = false;
+	int X = 0;
+	int Y = 0;
+	int Z = 0;
+	BlockId Type = BlockId::Air;
+	// Outward normal of the face the ray entered through, one of the six axes.
+	int NormalX = 0;
+	int NormalY = 0;
+	int NormalZ = 0;
+	float Distance = 0.0f;
+	// Number of octree leaves visited; shows how much empty space was skipped.
+	int Steps = 0;
+};
+
+// Octree forest covering a whole world: one tree per chunk, and above them one
+// region per OctreeRegionChunks^3 chunks holding the representative types of
+// the coarser levels.  Trees are rebuilt individually when their chunk changes,
+// and only their region's summary is recomputed.
+//
+// Chunks whose centre is further than the far distance from the far-field
+// centre (horizontally) are built at the far lod, so distant terrain keeps
+// only coarse cells.
+//
+// The game uses it for block picking.  Chunk LOD meshes are downsampled from
+// the blocks instead (see DownsampleBlocks).
+class WorldOctree
+{
+public:
+	// Chunks past distance blocks from (x, z) are built with minimum lod
+	// farLod.  Takes effect for trees built after the call.
+	void SetFarField(float x, float z, float distance, int farLod);
+
+	void Build(const World& world);
+	// Rebuilds the tree of one chunk, or removes it if the chunk is gone or empty.
+	void UpdateChunk(const World& world, const ChunkCoord& coord);
+
+	// lod may go up to OctreeMaxLod.
+	BlockId GetBlock(int x, int y, int z, int lod = 0)const;
+
+	// Casts a ray from origin along dir (need not be normalized) and returns the
+	// first non-air block within maxDistance, sampling the tree at the given lod.
+	VoxelRayHit Raycast(const float origin[3], const float dir[3], float maxDistance, int lod = 0)const;
+
+	std::size_t GetChunkCount()const { return mTrees.size(); }
+	std::size_t GetRegionCount()const { return mRegions.size(); }
+	std::size_t GetNodeCount()const;
+	std::size_t GetMemoryUsage()const;
+
+private:
+	struct Region
+	{
+		// Per chunk, indexed x + y * N + z * N * N with N = OctreeRegionChunks.
+		BlockId ChunkTypes[OctreeRegionChunks * OctreeRegionChunks * OctreeRegionChunks] = {};
+		std::uint16_t SolidCounts[OctreeRegionChunks * OctreeRegionChunks * OctreeRegionChunks] = {};
+		// Cells of 2x2x2 chunks, then the whole region.
+		BlockId HalfTypes[8] = {};
+		BlockId Type = BlockId::Air;
+		int ChunkCount = 0;
+	};
+
+	static_assert(OctreeRegionShift == 2, "Region keeps exactly two levels above the chunk trees");
+
+	int GetMinLod(const ChunkCoord& coord)const;
+	void SetRegionChunk(const ChunkCoord& coord, const ChunkOctree* tree);
+	static void UpdateRegionTypes(Region& region);
+	// Finds the cell holding block b at the given lod, like ChunkOctree::FindLeaf
+	// but in world units and across chunks and regions.
+	BlockId FindCell(const int b[3], int lod, int& size, int min[3])const;
+
+private:
+	std::unordered_map<std::uint64_t, ChunkOctree> mTrees;
+	std::unordered_map<std::uint64_t, Region> mRegions;
+
+	float mFarX = 0.0f;
+	float mFarZ = 0.0f;
+	// Negative means every chunk is built at full resolution.
+	float mFarDistance = -1.0f;
+	int mFarLod = 0;
+};
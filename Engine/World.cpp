@@ -0,0 +1,239 @@
+#include "World.h"
+#include <algorithm>
+
+BlockId World::GetBlock(int x, int y, int z)const
+{
+	const Chunk* chunk = GetChunk(ToChunkCoord(x, y, z));
+	if (chunk == nullptr)
+		return BlockId::Air;
+
+	chunk->Touch(mTime);
+	return chunk->GetBlock(x & ChunkMask, y & ChunkMask, z & ChunkMask);
+}
+
+void World::SetBlock(int x, int y, int z, BlockId id)
+{
+	ChunkCoord coord = ToChunkCoord(x, y, z);
+
+	// Don't allocate a chunk just to store air in it.
+	Chunk* chunk = (id == BlockId::Air) ? GetChunk(coord) : GetOrCreateChunk(coord);
+	if (chunk == nullptr)
+		return;
+
+	int lx = x & ChunkMask;
+	int lz = z & ChunkMask;
+	int before[gNumHeightmapTypes];
+	for (int t = 0; t < gNumHeightmapTypes; t++)
+		before[t] = chunk->GetColumnHeight((HeightmapType)t, lx, lz);
+
+	chunk->Touch(mTime);
+	chunk->SetBlock(lx, y & ChunkMask, lz, id);
+
+	// Most edits leave the chunk's heightmaps alone, so only then touch the
+	// world columns.
+	for (int t = 0; t < gNumHeightmapTypes; t++)
+	{
+		if (chunk->GetColumnHeight((HeightmapType)t, lx, lz) != before[t])
+		{
+			UpdateColumn(*chunk, lx, lz);
+			break;
+		}
+	}
+}
+
+int World::GetSurfaceHeight(int x, int z, HeightmapType type)const
+{
+	auto it = mColumns.find(ColumnKey(x >> ChunkShift, z >> ChunkShift));
+	if (it == mColumns.end())
+		return NoSurface;
+
+	return it->second.Heights[(int)type][((z & ChunkMask) << ChunkShift) | (x & ChunkMask)];
+}
+
+Chunk* World::GetChunk(const ChunkCoord& coord)
+{
+	return mChunks.Find(PackChunkCoord(coord));
+}
+
+const Chunk* World::GetChunk(const ChunkCoord& coord)const
+{
+	return mChunks.Find(PackChunkCoord(coord));
+}
+
+Chunk* World::GetOrCreateChunk(const ChunkCoord& coord)
+{
+	std::uint64_t key = PackChunkCoord(coord);
+	Chunk* chunk = mChunks.Find(key);
+	if (chunk == nullptr)
+	{
+		auto newChunk = std::make_unique<Chunk>(coord);
+		newChunk->Touch(mTime);
+		chunk = mChunks.Insert(key, std::move(newChunk));
+
+		auto inserted = mColumns.emplace(ColumnKey(coord.X, coord.Z), ColumnHeights());
+		ColumnHeights& column = inserted.first->second;
+		if (inserted.second)
+		{
+			for (auto& heights : column.Heights)
+				std::fill(heights, heights + ChunkSize * ChunkSize, NoSurface);
+		}
+		column.MinChunkY = std::min(column.MinChunkY, coord.Y);
+	}
+
+	return chunk;
+}
+
+void World::AssignChunk(const ChunkCoord& coord, const BlockId* blocks)
+{
+	Chunk* chunk = GetOrCreateChunk(coord);
+	chunk->AssignBlocks(blocks);
+
+	for (int z = 0; z < ChunkSize; z++)
+		for (int x = 0; x < ChunkSize; x++)
+			UpdateColumn(*chunk, x, z);
+}
+
+void World::UnloadChunk(const ChunkCoord& coord)
+{
+	if (!mChunks.Erase(PackChunkCoord(coord)))
+		return;
+
+	// Surfaces that were inside the chunk drop to whatever is below it.
+	auto it = mColumns.find(ColumnKey(coord.X, coord.Z));
+	if (it == mColumns.end())
+		return;
+
+	ColumnHeights& column = it->second;
+	for (int t = 0; t < gNumHeightmapTypes; t++)
+	{
+		for (int i = 0; i < ChunkSize * ChunkSize; i++)
+		{
+			int& height = column.Heights[t][i];
+			if (height != NoSurface && (height >> ChunkShift) == coord.Y)
+				height = FindSurfaceBelow(column, coord.X, coord.Z, coord.Y - 1, (HeightmapType)t, i & ChunkMask, i >> ChunkShift);
+		}
+	}
+}
+
+void World::ForEachChunk(const std::function<void(const Chunk&)>& fn)const
+{
+	mChunks.ForEach(fn);
+}
+
+void World::Clear()
+{
+	mChunks.Clear();
+	mColumns.clear();
+}
+
+void World::Update(double nowSeconds)
+{
+	mTime = nowSeconds;
+
+	mChunks.ForEach([this](Chunk& chunk)
+	{
+		// Reads of a frozen chunk decode from the cold tier without thawing it,
+		// so a chunk that is being read again is thawed here instead.
+		bool idle = mTime - chunk.GetLastAccess() > mColdTierDelay;
+		if (chunk.IsCold() && !idle)
+			chunk.Thaw();
+		else if (!chunk.IsCold() && idle)
+			chunk.Freeze();
+	});
+}
+
+ColdTierStats World::GetColdTierStats()const
+{
+	ColdTierStats stats;
+	mChunks.ForEach([&stats](const Chunk& chunk)
+	{
+		if (chunk.IsCold())
+		{
+			stats.ColdChunks++;
+			stats.ColdBytes += chunk.GetMemoryUsage();
+		}
+		else
+		{
+			stats.HotChunks++;
+			stats.HotBytes += chunk.GetMemoryUsage();
+		}
+	});
+
+	const ColdTierCounters& counters = Chunk::GetColdTierCounters();
+	stats.Freezes = counters.Freezes;
+	stats.Thaws = counters.Thaws;
+
+	// Bytes per nanosecond is gigabytes per second; scale to megabytes.
+	if (counters.FreezeNanoseconds > 0)
+		stats.FreezeMBPerSec = 1000.0 * stats.Freezes * ChunkVolume / counters.FreezeNanoseconds;
+	if (counters.ThawNanoseconds > 0)
+		stats.ThawMBPerSec = 1000.0 * stats.Thaws * ChunkVolume / counters.ThawNanoseconds;
+	stats.MaxThawMicroseconds = counters.MaxThawNanoseconds / 1000.0;
+
+	return stats;
+}
+
+std::size_t World::GetSolidBlockCount()const
+{
+	std::size_t count = 0;
+	mChunks.ForEach([&count](const Chunk& chunk) { count += chunk.GetSolidCount(); });
+
+	return count;
+}
+
+std::size_t World::GetMemoryUsage()const
+{
+	// Account for the hash tables as well as the chunks themselves.
+	std::size_t bytes = sizeof(World) - sizeof(mChunks) + mChunks.GetMemoryUsage();
+	bytes += mColumns.bucket_count() * sizeof(void*) +
+		mColumns.size() * (sizeof(ColumnHeights) + sizeof(std::uint64_t) + 2 * sizeof(void*));
+	mChunks.ForEach([&bytes](const Chunk& chunk) { bytes += chunk.GetMemoryUsage(); });
+
+	return bytes;
+}
+
+void World::UpdateColumn(const Chunk& chunk, int x, int z)
+{
+	const ChunkCoord& coord = chunk.GetCoord();
+	auto it = mColumns.find(ColumnKey(coord.X, coord.Z));
+	if (it == mColumns.end())
+		return;
+
+	ColumnHeights& column = it->second;
+	const int index = (z << ChunkShift) | x;
+
+	for (int t = 0; t < gNumHeightmapTypes; t++)
+	{
+		int& height = column.Heights[t][index];
+		bool surfaceInChunk = height != NoSurface && (height >> ChunkShift) == coord.Y;
+
+		int local = chunk.GetColumnHeight((HeightmapType)t, x, z);
+		if (local > 0)
+		{
+			// A chunk above still wins unless the surface was in this chunk.
+			int top = coord.Y * ChunkSize + local - 1;
+			if (top > height || surfaceInChunk)
+				height = top;
+		}
+		else if (surfaceInChunk)
+		{
+			height = FindSurfaceBelow(column, coord.X, coord.Z, coord.Y - 1, (HeightmapType)t, x, z);
+		}
+	}
+}
+
+int World::FindSurfaceBelow(const ColumnHeights& column, int chunkX, int chunkZ, int fromChunkY, HeightmapType type, int x, int z)const
+{
+	for (int cy = fromChunkY; cy >= column.MinChunkY; cy--)
+	{
+		const Chunk* chunk = GetChunk(ChunkCoord{ chunkX, cy, chunkZ });
+		if (chunk == nullptr)
+			continue;
+
+		int local = chunk->GetColumnHeight(type, x, z);
+		if (local > 0)
+			return cy * ChunkSize + local - 1;
+	}
+
+	return NoSurface;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Chunk.h"
+#include "ConcurrentMap.h"
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+// Memory and traffic of the hot and cold chunk tiers.
+struct ColdTierStats
+{
+	std::size_t HotChunks = 0;
+	std::size_t ColdChunks = 0;
+	std::size_t HotBytes = 0;
+	std::size_t ColdBytes = 0;
+
+	std::uint64_t Freezes = 0;
+	std::uint64_t Thaws = 0;
+	// Throughput in uncompressed (one byte per block) megabytes per second.
+	double FreezeMBPerSec = 0.0;
+	double ThawMBPerSec = 0.0;
+	double MaxThawMicroseconds = 0.0;
+};
+
+// Voxel world made of fixed-size chunks.  Chunks are created on demand when a
+// block is set inside them; reading outside any chunk returns air.
+// Chunks that go untouched for the cold tier delay are frozen by Update().
+//
+// Chunk lookup is lock-free, so any thread may find chunks while another adds
+// them.  Reads never modify chunk contents (frozen chunks are decoded in place
+// and thawed later by Update), so any number of threads may read at once.
+// Chunk contents and surface heights are not synchronized against edits; only
+// one thread at a time may add, edit, remove or Update chunks, and not while
+// others read them.
+// A Chunk* stays valid until the chunk is unloaded; threads other than the one
+// unloading should hold an EpochGuard while they use it.
+class World
+{
+public:
+	World() = default;
+	World(const World& rhs) = delete;
+	World& operator=(const World& rhs) = delete;
+
+	// World block coordinates are integers; block (x, y, z) covers [x, x+1) etc.
+	BlockId GetBlock(int x, int y, int z)const;
+	void SetBlock(int x, int y, int z, BlockId id);
+
+	// World y of the highest block in the column that matches the heightmap,
+	// or NoSurface if the loaded chunks have none.  Constant time.
+	int GetSurfaceHeight(int x, int z, HeightmapType type = HeightmapType::Solid)const;
+	static const int NoSurface = INT_MIN;
+
+	// Edit blocks through SetBlock or AssignChunk rather than through the
+	// returned chunk, or the surface heights go stale.
+	Chunk* GetChunk(const ChunkCoord& coord);
+	const Chunk* GetChunk(const ChunkCoord& coord)const;
+	Chunk* GetOrCreateChunk(const ChunkCoord& coord);
+
+	// Replaces all of a chunk's blocks, creating it if needed.
+	void AssignChunk(const ChunkCoord& coord, const BlockId* blocks);
+
+	// Removes a chunk; its memory is reclaimed once no reader can see it.
+	void UnloadChunk(const ChunkCoord& coord);
+
+	// Visits every loaded chunk in unspecified order.
+	void ForEachChunk(const std::function<void(const Chunk&)>& fn)const;
+
+	void Clear();
+
+	// Advances the world clock, freezes chunks that have been idle for longer
+	// than the cold tier delay and thaws frozen chunks that were read since.
+	void Update(double nowSeconds);
+	void SetColdTierDelay(double seconds) { mColdTierDelay = seconds; }
+	ColdTierStats GetColdTierStats()const;
+
+	std::size_t GetChunkCount()const { return mChunks.Size(); }
+	// Number of non-air blocks over all chunks.
+	std::size_t GetSolidBlockCount()const;
+	// Bytes of CPU memory owned by the chunk storage.
+	std::size_t GetMemoryUsage()const;
+
+	static ChunkCoord ToChunkCoord(int x, int y, int z)
+	{
+		ChunkCoord c;
+		c.X = x >> ChunkShift;
+		c.Y = y >> ChunkShift;
+		c.Z = z >> ChunkShift;
+		return c;
+	}
+
+private:
+	// Surface heights for the ChunkSize x ChunkSize block columns above one
+	// chunk column, indexed like the chunk heightmaps.
+	struct ColumnHeights
+	{
+		// Lowest chunk y ever loaded here, so a lowered surface knows where to
+		// stop searching.
+		int MinChunkY = INT_MAX;
+		int Heights[gNumHeightmapTypes][ChunkSize * ChunkSize];
+	};
+
+	static std::uint64_t ColumnKey(int chunkX, int chunkZ) { return PackChunkCoord(ChunkCoord{ chunkX, 0, chunkZ }); }
+
+	// Brings the world surface of one block column up to date after the
+	// chunk's heightmap for it changed.
+	void UpdateColumn(const Chunk& chunk, int x, int z);
+	// Highest matching block in chunks at or below fromChunkY.
+	int FindSurfaceBelow(const ColumnHeights& column, int chunkX, int chunkZ, int fromChunkY, HeightmapType type, int x, int z)const;
+
+private:
+	double mTime = 0.0;
+	double mColdTierDelay = 30.0;
+
+	ConcurrentMap<Chunk> mChunks;
+	std::unordered_map<std::uint64_t, ColumnHeights> mColumns;
+};
@@ -0,0 +1,135 @@
+#include "WorldGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+	// y == 0 is bedrock and y in [1, 4) is an ore band of stone with
+	// a 1 in 5 chance of gravel and a 1 in 10 chance of iron.
+	const int OreBandTop = 4;
+
+	BlockId RandomOreBlock()
+	{
+		if (rand() % 5 + 1 == 2)
+			return BlockId::Gravel;
+		if (rand() % 10 + 1 == 2)
+			return BlockId::Iron;
+		return BlockId::Stone;
+	}
+
+	// Fills a column from y = 0 up to height-1.  The top topCount blocks
+	// are surface, anything between the ore band and the surface is dirt.
+	void FillColumn(World& world, int x, int z, int height, BlockId surface, int topCount)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			BlockId id;
+			if (y == 0)
+				id = BlockId::Bedrock;
+			else if (y < OreBandTop)
+				id = RandomOreBlock();
+			else if (y >= height - topCount)
+				id = surface;
+			else
+				id = BlockId::Dirt;
+
+			world.SetBlock(x, y, z, id);
+		}
+	}
+
+	// Three wood blocks with a ring of leaves around the top one and a
+	// single leaf block above it.
+	void PlaceTree(World& world, int x, int baseY, int z)
+	{
+		for (int y = baseY; y < baseY + 3; y++)
+			world.SetBlock(x, y, z, BlockId::Wood);
+
+		for (int dz = -1; dz <= 1; dz++)
+			for (int dx = -1; dx <= 1; dx++)
+				if (dx != 0 || dz != 0)
+					world.SetBlock(x + dx, baseY + 2, z + dz, BlockId::Leaves);
+
+		world.SetBlock(x, baseY + 3, z, BlockId::Leaves);
+	}
+}
+
+WorldGenStats GenerateDefaultMap(World& world, unsigned int seed, int mapSize)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	srand(seed);
+
+	const int half = mapSize / 2;
+
+	// The original map allowed 80 trees on a 50x50 grass quadrant; keep that density.
+	const int maxTrees = 80 * half * half / (50 * 50);
+	int treeCount = 0;
+
+	// Marks xz cells that are too close to an existing tree for another to spawn,
+	// so the leaves of neighbouring trees don't overlap.
+	const int treeGridSize = half + 3;
+	std::vector<bool> nearTree(treeGridSize * treeGridSize, false);
+
+	//grass quadrant generation, 1 or 2 blocks of height variation with trees on top
+	for (int z = 0; z < half; z++)
+	{
+		for (int x = 0; x < half; x++)
+		{
+			int random = rand() % 2 + 1;
+			FillColumn(world, x, z, random + 8, BlockId::Grass, 1);
+
+			if (treeCount < maxTrees && rand() % 20 == 4 && x > 0 && z > 0)
+			{
+				if (!nearTree[z * treeGridSize + x])
+				{
+					PlaceTree(world, x, world.GetSurfaceHeight(x, z) + 1, z);
+					treeCount++;
+
+					for (int i = z; i < z + 3; i++)
+						for (int j = std::max(x - 2, 0); j < x + 3; j++)
+							nearTree[i * treeGridSize + j] = true;
+				}
+			}
+		}
+	}
+
+	//sand quadrant generation, 1 in 10 columns are a block higher
+	for (int z = half; z < mapSize; z++)
+	{
+		for (int x = half; x < mapSize; x++)
+		{
+			int random = rand() % 10 + 1;
+			FillColumn(world, x, z, random == 2 ? 10 : 9, BlockId::Sand, 1);
+		}
+	}
+
+	//gravel quadrant generation, the top 1-3 rows are gravel
+	for (int z = 0; z < half; z++)
+	{
+		for (int x = half; x < mapSize; x++)
+		{
+			int random = rand() % 3 + 1;
+			FillColumn(world, x, z, random + 8, BlockId::Gravel, random);
+		}
+	}
+
+	//water quadrant generation, flat with a layer of water on top
+	for (int z = half; z < mapSize; z++)
+	{
+		for (int x = 0; x < half; x++)
+		{
+			FillColumn(world, x, z, 9, BlockId::Water, 1);
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	WorldGenStats stats;
+	stats.BlockCount = world.GetSolidBlockCount();
+	stats.ChunkCount = world.GetChunkCount();
+	stats.MemoryBytes = world.GetMemoryUsage();
+	stats.GenerationMs = std::chrono::duration<double, std::milli>(end - start).count();
+	return stats;
+}
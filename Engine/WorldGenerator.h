@@ -0,0 +1,18 @@
+#pragma once
+
+#include "World.h"
+
+// Results of a generation run, used to compare the chunked world against the
+// old one-RenderItem-per-block layout.
+struct WorldGenStats
+{
+	std::size_t BlockCount = 0;
+	std::size_t ChunkCount = 0;
+	std::size_t MemoryBytes = 0;
+	double GenerationMs = 0.0;
+};
+
+// Fills the world with the four-quadrant map (grass with trees, sand, gravel
+// and water), mapSize blocks along x and z with the origin in the grass corner.
+// The default size is the original 100x100 map.
+WorldGenStats GenerateDefaultMap(World& world, unsigned int seed, int mapSize = 100);